@@ -16,6 +16,18 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#endif
+#ifdef HAVE_IO_URING
+#include <linux/io_uring.h>
+#endif
 #include "kopen.h"
 #include "sassert.h"
 #include "zf.h"
@@ -24,22 +36,98 @@
 #include "zlib.h"
 #endif
 
+#ifdef HAVE_LIBDEFLATE
+#include "libdeflate.h"
+#endif
+
+#ifdef HAVE_ISAL
+#include "isa-l.h"
+#endif
+
+#ifdef HAVE_ZLIBNG
+#include "zlib-ng.h"
+#endif
+
 #ifdef HAVE_BZ2
 #include "bzlib.h"
 #endif
 
+#ifdef HAVE_ZSTD
+#include "zstd.h"
+#endif
+
+#ifdef HAVE_LZMA
+#include "lzma.h"
+#endif
+
+#ifdef HAVE_LZ4
+#include "lz4.h"
+#include "lz4hc.h"
+#include "lz4frame.h"
+#endif
+
 
 /* constants */
 #define ZF_BUF_SIZE					( 512 * 1024 )		/* 512KB */
-#define ZF_UNGETC_MARGIN_SIZE		( 32 )
+#define ZF_UNGETC_MARGIN_SIZE		( 32 )				/* bytes always left for zfungetc */
+#define ZF_BUF_PADDING				( 64 )				/* zeroed bytes readable after the end of the data, for SIMD loads */
+#define ZF_BUF_SLACK				( ZF_UNGETC_MARGIN_SIZE + ZF_BUF_PADDING )	/* bytes kept free in the ring */
+#define ZF_BUF_SIZE_MIN				( 64 * 1024 )		/* range of "buf=<size>" */
+#define ZF_BUF_SIZE_MAX				( 64 * 1024 * 1024 )
+#define ZF_BUF_ALIGN				( 64 )				/* minimum alignment of the buffer, "align=<size>" up to the page size */
+#define ZF_HUGEPAGE_SIZE			( 2 * 1024 * 1024 )	/* for "huge" */
+#define ZF_MFD_HUGETLB				( 0x0004U )			/* MFD_HUGETLB in <linux/memfd.h> */
+#define ZF_GZIDX_SPAN				( 4 * 1024 * 1024 )	/* 4MB */
+#define ZF_ZST_LONG_WLOG			( 27 )				/* 128MB window, same as `zstd --long' */
+#define ZF_RA_DEPTH					( 4 )				/* number of buffers decoded ahead by "ra" */
+#define ZF_WB_SIZE					( 8 * 1024 * 1024 )	/* max bytes queued by "wb" */
+#define ZF_URING_DEPTH				( 8 )				/* number of reads / writes kept in flight by "uring" */
+
+/* deflate engines, selected by "eng=<name>" or $ZF_GZ_ENGINE */
+#define ZF_GZENG_AUTO				( 0 )				/* the fastest one available */
+#define ZF_GZENG_ZLIB				( 1 )
+#define ZF_GZENG_LIBDEFLATE			( 2 )
+#define ZF_GZENG_ISAL				( 3 )
+#define ZF_GZENG_ZLIBNG				( 4 )
+#define ZF_GZENG_CNT				( 5 )
+
+/* flags of the function table entries */
+#define ZF_FN_RD					( 0x01 )			/* available in read mode */
+#define ZF_FN_WR					( 0x02 )			/* available in write mode */
+#define ZF_FN_MT					( 0x04 )			/* multithreaded, selected only if `@' is in the mode */
+#define ZF_SNIFF_SIZE				( 16 )				/* max bytes examined to determine the input format */
+
+/**
+ * @struct zf_params_s
+ * @brief options given after `@' in the mode string, e.g. "w.gz@8"
+ */
+struct zf_params_s {
+	int nth;			/* number of worker threads, 0 if `@' is not specified */
+	int gzi;			/* "gzi": dump BGZF index */
+	int wlog;			/* "long" or "long=<window log>": zstd long distance matching, 0 if disabled */
+	int eng;			/* "eng=<name>": deflate engine (ZF_GZENG_*, -1 if unknown), $ZF_GZ_ENGINE if not specified */
+	int ra;				/* "ra" or "ra=<depth>": number of buffers decoded ahead on a background thread, 0 if disabled */
+	int mmap;			/* "mmap": map uncompressed regular files instead of reading them (read mode) */
+	int huge;			/* "huge": allocate the buffer on hugepages if available */
+	int uring;			/* "uring" or "uring=<depth>": reads / writes of plain regular files kept in flight on io_uring, 0 if disabled */
+	uint64_t bufsize;	/* "buf=<size>": size of the buffer, ZF_BUF_SIZE if not specified */
+	uint64_t align;		/* "align=<size>": alignment of the buffer, power of two in [ZF_BUF_ALIGN, page size] */
+	uint64_t wb;		/* "wb" or "wb=<size>": max bytes queued to the write-behind thread, 0 if disabled */
+	uint64_t span;		/* "idx" or "idx=<span>": build / load gzip random access index, 0 if disabled */
+	char const *path;	/* path passed to zfopen, NULL for stdin / stdout */
+	uint8_t const *head;	/* bytes already read from a non-seekable input to examine the format */
+	size_t head_len;
+};
 
 /* function pointer type aliases */
 typedef void *(*zf_dopen_t)(
 	int fd,
-	char const *mode);
+	char const *mode,
+	struct zf_params_s const *params);
 typedef void *(*zf_open_t)(
 	char const *path,
-	char const *mode);
+	char const *mode,
+	struct zf_params_s const *params);
 typedef int (*zf_init_t)(
 	void *);
 typedef void *(*zf_close_t)(
@@ -52,611 +140,9193 @@ typedef size_t (*zf_write_t)(
 	void *fp,
 	void *ptr,
 	size_t len);
+typedef int (*zf_seek_t)(
+	void *fp,
+	int64_t offset);
+typedef uint8_t *(*zf_map_t)(
+	void *fp,
+	size_t *len);
 
-/* wrapped functions */
+/* utilities */
 
 /**
- * @fn zf_init_stdio
- * @brief wrapped setvbuf
+ * @fn zf_write_all
+ * @brief write(2) wrapper, retries until all the bytes are written
  */
-int zf_init_stdio(
-	void *fp)
+static
+int zf_write_all(
+	int fd,
+	void const *ptr,
+	size_t len)
 {
-	return(setvbuf((FILE *)fp, NULL, _IOFBF, ZF_BUF_SIZE));
+	uint8_t const *p = (uint8_t const *)ptr;
+	while(len > 0) {
+		ssize_t written = write(fd, p, len);
+		if(written < 0) {
+			if(errno == EINTR) { continue; }
+			return(-1);
+		}
+		p += written;
+		len -= written;
+	}
+	return(0);
 }
 
 /**
- * @fn fread_wrap
- * @brief wrap fread to zlib compatible
+ * @fn zf_open_fd
+ * @brief open(2) with stdio-style mode string
  */
-size_t fread_wrap(
-	void *fp,
-	void *ptr,
-	size_t len)
+static
+int zf_open_fd(
+	char const *path,
+	char const *mode)
 {
-	return(fread(ptr, 1, len, (FILE *)fp));
+	int flags = (mode[0] == 'a')
+		? (O_WRONLY | O_CREAT | O_APPEND)
+		: (O_WRONLY | O_CREAT | O_TRUNC);
+	return(open(path, flags, 0666));
 }
 
+#if defined(HAVE_Z) || defined(HAVE_BZ2) || defined(HAVE_ZSTD) || defined(HAVE_LZMA) || defined(HAVE_LZ4)
 /**
- * @fn fwrite_wrap
- * @brief wrap fwrite to zlib compatible
+ * @fn zf_parse_level
+ * @brief extract compression level (digits in the mode string, e.g. "w19") clamped to [min, max] of the codec,
+ * returns def if not found
  */
-size_t fwrite_wrap(
-	void *fp,
-	void *ptr,
-	size_t len)
+static
+int zf_parse_level(
+	char const *mode,
+	int def,
+	int min,
+	int max)
 {
-	return(fwrite(ptr, 1, len, (FILE *)fp));
+	for(char const *p = mode; *p != '\0'; p++) {
+		if(*p < '0' || *p > '9') { continue; }
+		int level = atoi(p);
+		return((level < min) ? min : (level > max) ? max : level);
+	}
+	return(def);
 }
 
-/* zlib-dependent functions */
-#ifdef HAVE_Z
 /**
- * @fn zf_init_gzip
- * @brief setup function, set buffer size to 512k
+ * @struct zf_src_s
+ * @brief buffered reader on raw fd, for the internal decoders that need lookahead
  */
-int zf_init_gzip(
-	void *fp)
+#define ZF_SRC_BUF_SIZE				( 1024 * 1024 )		/* 1MB */
+struct zf_src_s {
+	int fd;
+	int eof;
+	int64_t base;					/* file offset of buf[0] */
+	size_t curr, end;
+	uint8_t buf[ZF_SRC_BUF_SIZE];
+};
+
+/**
+ * @fn zf_src_peek
+ * @brief make at least len (<= ZF_SRC_BUF_SIZE) bytes available at the head of the buffer,
+ * returns NULL if input ended before len bytes
+ */
+static
+uint8_t const *zf_src_peek(
+	struct zf_src_s *src,
+	size_t len)
 {
-	#if ZLIB_VERNUM >= 0x1240
-		return(gzbuffer((gzFile)fp, ZF_BUF_SIZE));
-	#else
-		return(0);
-	#endif
+	while(src->end - src->curr < len) {
+		if(src->eof != 0) {
+			return(NULL);
+		}
+
+		/* move the remaining bytes to the head */
+		if(src->curr != 0) {
+			memmove(src->buf, &src->buf[src->curr], src->end - src->curr);
+			src->base += src->curr;
+			src->end -= src->curr;
+			src->curr = 0;
+		}
+
+		ssize_t read_size = read(src->fd, &src->buf[src->end], ZF_SRC_BUF_SIZE - src->end);
+		if(read_size < 0 && errno == EINTR) { continue; }
+		if(read_size <= 0) {
+			src->eof = 1;
+			continue;
+		}
+		src->end += read_size;
+	}
+	return(&src->buf[src->curr]);
 }
-#endif
 
 /**
- * @struct zf_functions_s
- * @brief function container
+ * @fn zf_src_init
+ * @brief bind fd; the bytes read by zfopen to examine the format are put back at the head of the buffer
  */
-struct zf_functions_s {
-	char const *ext;
-	zf_dopen_t dopen;
-	zf_open_t open;
-	zf_init_t init;
-	zf_close_t close;
-	zf_read_t read;
-	zf_write_t write;	
-};
+static
+void zf_src_init(
+	struct zf_src_s *src,
+	int fd,
+	struct zf_params_s const *params)
+{
+	src->fd = fd;
+	if(params->head_len != 0) {
+		memcpy(src->buf, params->head, params->head_len);
+		src->end = params->head_len;
+	}
+	return;
+}
+#endif /* codecs */
+
+/* parallel block processing */
 
 /**
- * @struct zf_intl_s
- * @brief context container
+ * @struct zf_mt_blk_s
+ * @brief block slot in the ordered ring of zf_mt_s
  */
-struct zf_intl_s {
-	char *path;
-	char *mode;
-	int fd;
-	int eof;		/* == 1 if fp reached EOF, == 2 if curr reached the end of buf */
-	void *ko;
-	void *fp;		/* one of {FILE * / gzFile / BZFILE *} */
-	struct zf_functions_s fn;
-	uint8_t *buf;
-	int64_t size;
-	int64_t curr, end;
-	char ungetc_margin[ZF_UNGETC_MARGIN_SIZE];
+struct zf_mt_blk_s {
+	uint8_t *in, *out;
+	size_t in_size, out_size;		/* capacities */
+	size_t in_len, out_len;			/* lengths of the contents */
+	uint64_t aux[6];				/* format-dependent values (dictionary length, crc, ...) */
+	int state;						/* ZF_MT_FREE -> ZF_MT_QUEUED -> ZF_MT_DONE */
+	int err;
 };
-_static_assert(offsetof(struct zf_intl_s, ungetc_margin) == sizeof(struct zf_s));
-_static_assert_offset(struct zf_intl_s, path, struct zf_s, path, 0);
-_static_assert_offset(struct zf_intl_s, mode, struct zf_s, mode, 0);
+#define ZF_MT_FREE					( 0 )
+#define ZF_MT_QUEUED				( 1 )
+#define ZF_MT_DONE					( 2 )
+
+/* callback type aliases */
+typedef void *(*zf_mt_winit_t)(
+	void *arg);
+typedef void (*zf_mt_wclean_t)(
+	void *wctx);
+typedef int (*zf_mt_work_t)(
+	void *arg,
+	void *wctx,
+	struct zf_mt_blk_s *blk);
+typedef int (*zf_mt_feed_t)(
+	void *arg,
+	struct zf_mt_blk_s *blk);
+typedef int (*zf_mt_emit_t)(
+	void *arg,
+	struct zf_mt_blk_s *blk);
 
 /**
- * @val fn_table
- * @brief extension and function table
+ * @struct zf_mt_s
+ * @brief worker pool with an ordered ring of blocks; blocks are pushed in by
+ * the producer (the caller or feeder), processed in any order by workers, and
+ * drained in the pushed order by the consumer (the caller or emitter thread).
  */
-static
-struct zf_functions_s const fn_table[] = {
-	/* default */
-	{
-		.ext = "",
-		.dopen = (zf_dopen_t)fdopen,
-		.open = (zf_open_t)fopen,
-		.init = (zf_init_t)zf_init_stdio,
-		.close = (zf_close_t)fclose,
-		.read = (zf_read_t)fread_wrap,
-		.write = (zf_write_t)fwrite_wrap
-	},
-	/* gzip */
-	{
-		.ext = ".gz",
-		#ifdef HAVE_Z
-		.dopen = (zf_dopen_t)gzdopen,
-		.open = (zf_open_t)gzopen,
-		.init = (zf_init_t)zf_init_gzip,
-		.close = (zf_close_t)gzclose,
-		.read = (zf_read_t)gzread,
-		.write = (zf_write_t)gzwrite
-		#endif
-	},
-	/* bzip2 */
-	{
-		.ext = ".bz2",
-		#ifdef HAVE_BZ2
-		.dopen = (zf_dopen_t)BZ2_bzdopen,
-		.open = (zf_open_t)BZ2_bzopen,
-		.init = (zf_init_t)NULL,
-		.close = (zf_close_t)BZ2_bzclose,
-		.read = (zf_read_t)BZ2_bzread,
-		.write = (zf_write_t)BZ2_bzwrite
-		#endif
-	},
-	/* other unsupported formats */
-	{ .ext = ".lz" },
-	{ .ext = ".lzma" },
-	{ .ext = ".xz" },
-	{ .ext = ".z" }
+struct zf_mt_s {
+	pthread_mutex_t lock;
+	pthread_cond_t cv;
+	uint64_t head, disp, tail;		/* pushed, dispatched to workers, and drained counts */
+	uint64_t nslots;
+	struct zf_mt_blk_s *slots;
+	int fin, stop;
+	int nth;
+	pthread_t *th;
+	pthread_t io;					/* feeder or emitter */
+	void *arg;
+	zf_mt_winit_t winit;
+	zf_mt_wclean_t wclean;
+	zf_mt_work_t work;
+	zf_mt_feed_t feed;				/* pushed by a dedicated thread if not NULL */
+	zf_mt_emit_t emit;				/* drained by a dedicated thread if not NULL, exclusive to feed */
 };
 
 /**
- * @fn zfopen
- * @brief open file, similar to fopen / gzopen,
- * compression format can be explicitly specified adding an extension to `mode', e.g. "w+.bz2".
+ * @fn zf_mt_worker
  */
-zf_t *zfopen(
-	char const *path,
-	char const *mode)
+static
+void *zf_mt_worker(
+	void *_mt)
 {
-	if(path == NULL || mode == NULL) {
-		return(NULL);
-	}
-
-	/* check length */
-	uint64_t path_len = strlen(path);
-	uint64_t mode_len = strlen(mode);
-	if(path_len == 0 || mode_len == 0) {
-		return(NULL);
-	}
+	struct zf_mt_s *mt = (struct zf_mt_s *)_mt;
+	void *wctx = (mt->winit != NULL) ? mt->winit(mt->arg) : NULL;
 
-	char *path_dup = (char *)path;
-	char *mode_dup = (char *)mode;
-
-	char const *path_tail = path + path_len;
-	char const *mode_tail = mode + mode_len;
+	pthread_mutex_lock(&mt->lock);
+	while(1) {
+		while(mt->disp == mt->head && mt->stop == 0) {
+			pthread_cond_wait(&mt->cv, &mt->lock);
+		}
+		if(mt->stop != 0) { break; }
 
-	/* determine format */
-	struct zf_functions_s const *fn = &fn_table[0];
-	for(uint64_t i = 1; i < sizeof(fn_table) / sizeof(struct zf_functions_s); i++) {
-		/* skip if ext string is longer than path string */
-		if(path_len < strlen(fn_table[i].ext)) { continue; }
+		struct zf_mt_blk_s *blk = &mt->slots[mt->disp++ % mt->nslots];
+		pthread_mutex_unlock(&mt->lock);
 
-		/* check path */
-		if(strncmp(path_tail - strlen(fn_table[i].ext),
-			fn_table[i].ext,
-			strlen(fn_table[i].ext)) == 0) {
+		blk->err = mt->work(mt->arg, wctx, blk);
 
-			/* hit */
-			fn = &fn_table[i];
-			path_dup = strdup(path);
-			path_dup[strlen(path) - strlen(fn_table[i].ext)] = '\0';
-			break;
-		}
+		pthread_mutex_lock(&mt->lock);
+		blk->state = ZF_MT_DONE;
+		pthread_cond_broadcast(&mt->cv);
+	}
+	pthread_mutex_unlock(&mt->lock);
 
-		/* skip if ext string is longer than mode string */
-		if(mode_len < strlen(fn_table[i].ext)) { continue; }
+	if(mt->wclean != NULL) { mt->wclean(wctx); }
+	return(NULL);
+}
 
-		/* check mode */
-		if(strncmp(mode_tail - strlen(fn_table[i].ext),
-			fn_table[i].ext,
-			strlen(fn_table[i].ext)) == 0) {
-			
-			/* hit */
-			fn = &fn_table[i];
-			mode_dup = strdup(mode);
-			mode_dup[strlen(mode) - strlen(fn_table[i].ext)] = '\0';
-			break;
-		}
+/**
+ * @fn zf_mt_acquire
+ * @brief get the next free slot for the producer, blocks while the ring is full.
+ * returns NULL if the pool is being stopped.
+ */
+static
+struct zf_mt_blk_s *zf_mt_acquire(
+	struct zf_mt_s *mt)
+{
+	pthread_mutex_lock(&mt->lock);
+	while(mt->head - mt->tail == mt->nslots && mt->stop == 0) {
+		pthread_cond_wait(&mt->cv, &mt->lock);
 	}
+	struct zf_mt_blk_s *blk = (mt->stop == 0) ? &mt->slots[mt->head % mt->nslots] : NULL;
+	pthread_mutex_unlock(&mt->lock);
 
-	/* check if functions are available */
-	if(fn->open == NULL) {
-		return(NULL);
+	if(blk != NULL) {
+		blk->in_len = blk->out_len = 0;
+		blk->err = 0;
 	}
+	return(blk);
+}
 
-	/* malloc context */
-	struct zf_intl_s *fio = (struct zf_intl_s *)malloc(
-		sizeof(struct zf_intl_s) + ZF_BUF_SIZE);
-	if(fio == NULL) {
-		return(NULL);
-	}
-	memset(fio, 0, sizeof(struct zf_intl_s));
-	fio->buf = (uint8_t *)(fio + 1);
-	fio->size = ZF_BUF_SIZE;
-	fio->fn = *fn;
+/**
+ * @fn zf_mt_push
+ * @brief queue the slot returned by the last zf_mt_acquire
+ */
+static
+void zf_mt_push(
+	struct zf_mt_s *mt)
+{
+	pthread_mutex_lock(&mt->lock);
+	mt->slots[mt->head++ % mt->nslots].state = ZF_MT_QUEUED;
+	pthread_cond_broadcast(&mt->cv);
+	pthread_mutex_unlock(&mt->lock);
+}
 
-	/* open file */
-	if(mode[0] == 'r') {
-		/* read mode, open file with kopen */
-		fio->ko = kopen(path, &fio->fd);
-		if(fio->ko == NULL) {
-			goto _zfopen_finish;
-		}
-		fio->fp = fio->fn.dopen(fio->fd, mode);
-	} else {
-		/* write mode, check if stdout is specified */
-		if(strncmp(path, "-", strlen("-")) == 0) {
-			fio->path = "-";
-			fio->fd = STDOUT_FILENO;
-			fio->ko = NULL;
-			fio->fp = stdout;
-			goto _zfopen_finish;
-		}
+/**
+ * @fn zf_mt_finish
+ * @brief tell the consumer that no more blocks will be pushed
+ */
+static
+void zf_mt_finish(
+	struct zf_mt_s *mt)
+{
+	pthread_mutex_lock(&mt->lock);
+	mt->fin = 1;
+	pthread_cond_broadcast(&mt->cv);
+	pthread_mutex_unlock(&mt->lock);
+}
 
-		/* open file */
-		fio->fp = fio->fn.open(path, mode);
-		fio->fd = -1;		/* fd is invalid in write mode */
-		fio->ko = NULL;		/* ko is also invalid */
-		goto _zfopen_finish;
+/**
+ * @fn zf_mt_drain
+ * @brief wait for the oldest block to be processed, returns NULL if all the blocks are drained.
+ * the block must be returned with zf_mt_release after use.
+ */
+static
+struct zf_mt_blk_s *zf_mt_drain(
+	struct zf_mt_s *mt)
+{
+	pthread_mutex_lock(&mt->lock);
+	while(mt->stop == 0
+		&& !(mt->tail < mt->head && mt->slots[mt->tail % mt->nslots].state == ZF_MT_DONE)
+		&& !(mt->tail == mt->head && mt->fin != 0)) {
+		pthread_cond_wait(&mt->cv, &mt->lock);
 	}
+	struct zf_mt_blk_s *blk = (mt->stop == 0 && mt->tail < mt->head)
+		? &mt->slots[mt->tail % mt->nslots]
+		: NULL;
+	pthread_mutex_unlock(&mt->lock);
+	return(blk);
+}
 
-_zfopen_finish:;
-	if(fio->fp == NULL) {
-		/* something wrong occurred */
-		if(fio->ko != NULL) {
-			kclose(fio->ko); fio->ko = NULL;
-		}
-		free(fio); fio = NULL;
-		return(NULL);
-	}
+/**
+ * @fn zf_mt_release
+ */
+static
+void zf_mt_release(
+	struct zf_mt_s *mt)
+{
+	pthread_mutex_lock(&mt->lock);
+	mt->slots[mt->tail++ % mt->nslots].state = ZF_MT_FREE;
+	pthread_cond_broadcast(&mt->cv);
+	pthread_mutex_unlock(&mt->lock);
+}
 
-	/* everything is going right */
-	fio->path = (path_dup == path) ? strdup(path) : path_dup;
-	fio->mode = (mode_dup == mode) ? strdup(mode) : mode_dup;
-	fio->curr = fio->end = 0;
-	if(fio->fn.init != NULL) {
-		if(fio->fn.init(fio->fp) != 0) {
-			zfclose((zf_t *)fio);
-			return(NULL);
-		}
+#if defined(HAVE_Z) || defined(HAVE_BZ2) || defined(HAVE_LZ4)
+/**
+ * @fn zf_mt_flag
+ * @brief set (if set != 0) and return the error flag shared between the caller and the emitter thread, under the pool lock
+ */
+static
+int zf_mt_flag(
+	struct zf_mt_s *mt,
+	int *flag,
+	int set)
+{
+	if(mt == NULL) { return(*flag |= set); }
+	pthread_mutex_lock(&mt->lock);
+	int ret = (*flag |= set);
+	pthread_mutex_unlock(&mt->lock);
+	return(ret);
+}
+#endif
+
+/**
+ * @fn zf_mt_emitter
+ */
+static
+void *zf_mt_emitter(
+	void *_mt)
+{
+	struct zf_mt_s *mt = (struct zf_mt_s *)_mt;
+	struct zf_mt_blk_s *blk;
+	while((blk = zf_mt_drain(mt)) != NULL) {
+		mt->emit(mt->arg, blk);
+		zf_mt_release(mt);
 	}
+	return(NULL);
+}
 
-	return((zf_t *)fio);
+/**
+ * @fn zf_mt_feeder
+ * @brief the feed callback returns positive if the block is filled, zero on end of input, negative on error
+ */
+static
+void *zf_mt_feeder(
+	void *_mt)
+{
+	struct zf_mt_s *mt = (struct zf_mt_s *)_mt;
+	struct zf_mt_blk_s *blk;
+	while((blk = zf_mt_acquire(mt)) != NULL) {
+		if(mt->feed(mt->arg, blk) <= 0) { break; }
+		zf_mt_push(mt);
+	}
+	zf_mt_finish(mt);
+	return(NULL);
 }
 
 /**
- * @fn zfclose
- * @brief close file, similar to fclose / gzclose
+ * @fn zf_mt_destroy
+ * @brief drain the remaining blocks (if the emitter is running) then stop all the threads
  */
-int zfclose(
-	zf_t *fp)
+static
+void zf_mt_destroy(
+	struct zf_mt_s *mt)
 {
-	struct zf_intl_s *fio = (struct zf_intl_s *)fp;
+	if(mt == NULL) { return; }
 
-	if(fio == NULL) {
-		return(1);
+	if(mt->emit != NULL) {
+		zf_mt_finish(mt);
+		pthread_join(mt->io, NULL);
 	}
 
-	/* flush if write mode */
-	if(fio->mode[0] != 'r') {
-		fio->fn.write(fio->fp, (void *)fio->buf, fio->curr);
+	pthread_mutex_lock(&mt->lock);
+	mt->stop = 1;
+	pthread_cond_broadcast(&mt->cv);
+	pthread_mutex_unlock(&mt->lock);
+	for(int i = 0; i < mt->nth; i++) {
+		pthread_join(mt->th[i], NULL);
+	}
+	if(mt->feed != NULL) {
+		pthread_join(mt->io, NULL);
 	}
 
-	/* close file */
-	if(fio->fp != NULL) {
-		fio->fn.close(fio->fp); fio->fp = NULL;
-		if(fio->ko != NULL) {
-			kclose(fio->ko); fio->ko = NULL;
-		}
+	for(uint64_t i = 0; i < mt->nslots; i++) {
+		free(mt->slots[i].in);
+		free(mt->slots[i].out);
 	}
-	free(fio->path); fio->path = NULL;
-	free(fio->mode); fio->mode = NULL;
-	free(fio); fio = NULL;
+	pthread_cond_destroy(&mt->cv);
+	pthread_mutex_destroy(&mt->lock);
+	free(mt->slots);
+	free(mt->th);
+	free(mt);
+	return;
+}
+
+#if defined(HAVE_Z) || defined(HAVE_BZ2) || defined(HAVE_ZSTD) || defined(HAVE_LZ4)
+/**
+ * @fn zf_mt_reserve
+ * @brief extend buffer to hold at least size bytes
+ */
+static
+int zf_mt_reserve(
+	uint8_t **buf,
+	size_t *cap,
+	size_t size)
+{
+	if(size <= *cap) { return(0); }
+	size_t new_cap = (*cap < 4096) ? 4096 : *cap;
+	while(new_cap < size) { new_cap *= 2; }
+
+	uint8_t *p = (uint8_t *)realloc(*buf, new_cap);
+	if(p == NULL) { return(-1); }
+	*buf = p;
+	*cap = new_cap;
 	return(0);
 }
+#endif /* HAVE_Z || HAVE_BZ2 || HAVE_ZSTD || HAVE_LZ4 */
 
+#if defined(HAVE_BZ2) || defined(HAVE_ZSTD) || defined(HAVE_LZ4)
 /**
- * @fn zfread
- * @brief read from file, similar to gzread
+ * @fn zf_mt_append
+ * @brief append bytes to the input of the slot
  */
-size_t zfread(
-	zf_t *fp,
-	void *_ptr,
+static
+int zf_mt_append(
+	struct zf_mt_blk_s *blk,
+	uint8_t const *p,
 	size_t len)
 {
-	struct zf_intl_s *fio = (struct zf_intl_s *)fp;
-	uint8_t *ptr = (uint8_t *)_ptr;
-	size_t copied_size = 0;
-
-	/* check eof */
-	if(fio->eof == 2) {
-		return(0);
+	if(zf_mt_reserve(&blk->in, &blk->in_size, blk->in_len + len) != 0) {
+		return(-1);
 	}
+	memcpy(&blk->in[blk->in_len], p, len);
+	blk->in_len += len;
+	return(0);
+}
+#endif /* HAVE_BZ2 || HAVE_ZSTD || HAVE_LZ4 */
 
-	/* if buffer is not empty, copy from buffer */
-	if(fio->curr < fio->end) {
-		uint64_t rem_size = fio->end - fio->curr;
-		uint64_t buf_copy_size = (rem_size < len) ? rem_size : len;
-		memcpy(ptr, (void *)&fio->buf[fio->curr], buf_copy_size);
-
-		/* update */
-		len -= buf_copy_size;
-		ptr += buf_copy_size;
-		fio->curr += buf_copy_size;
-		copied_size += buf_copy_size;
+/**
+ * @fn zf_mt_init
+ * @brief create pool with nth workers and (2 * nth + 2) slots of in_size / out_size bytes each
+ */
+static
+struct zf_mt_s *zf_mt_init(
+	int nth,
+	size_t in_size,
+	size_t out_size,
+	void *arg,
+	zf_mt_winit_t winit,
+	zf_mt_wclean_t wclean,
+	zf_mt_work_t work,
+	zf_mt_feed_t feed,
+	zf_mt_emit_t emit)
+{
+	nth = (nth < 1) ? 1 : nth;
+
+	struct zf_mt_s *mt = (struct zf_mt_s *)calloc(1, sizeof(struct zf_mt_s));
+	if(mt == NULL) { return(NULL); }
+	mt->nslots = 2 * nth + 2;
+	mt->slots = (struct zf_mt_blk_s *)calloc(mt->nslots, sizeof(struct zf_mt_blk_s));
+	mt->th = (pthread_t *)calloc(nth, sizeof(pthread_t));
+	if(mt->slots == NULL || mt->th == NULL) { goto _zf_mt_init_error; }
+
+	for(uint64_t i = 0; i < mt->nslots; i++) {
+		mt->slots[i].in = (uint8_t *)malloc(in_size);
+		mt->slots[i].out = (uint8_t *)malloc(out_size);
+		mt->slots[i].in_size = in_size;
+		mt->slots[i].out_size = out_size;
+		if(mt->slots[i].in == NULL || mt->slots[i].out == NULL) { goto _zf_mt_init_error; }
 	}
 
-	/* if fp already reached EOF */
-	if(fio->eof == 1) {
-		fio->eof += (fio->curr == fio->end);
-		return(copied_size);
+	mt->arg = arg;
+	mt->winit = winit;
+	mt->wclean = wclean;
+	mt->work = work;
+	mt->feed = feed;
+	mt->emit = emit;
+	pthread_mutex_init(&mt->lock, NULL);
+	pthread_cond_init(&mt->cv, NULL);
+
+	for(mt->nth = 0; mt->nth < nth; mt->nth++) {
+		if(pthread_create(&mt->th[mt->nth], NULL, zf_mt_worker, (void *)mt) != 0) {
+			break;
+		}
+	}
+	if(mt->nth == 0
+	|| (feed != NULL && pthread_create(&mt->io, NULL, zf_mt_feeder, (void *)mt) != 0)
+	|| (emit != NULL && pthread_create(&mt->io, NULL, zf_mt_emitter, (void *)mt) != 0)) {
+		mt->feed = NULL;
+		mt->emit = NULL;
+		zf_mt_destroy(mt);
+		return(NULL);
 	}
+	return(mt);
 
-	/* issue fread */
-	if(len > 0) {
-		uint64_t read_size = fio->fn.read(fio->fp, ptr, len);
-		fio->eof = 2 * (read_size < len);
-		copied_size += read_size;
+_zf_mt_init_error:;
+	if(mt->slots != NULL) {
+		for(uint64_t i = 0; i < mt->nslots; i++) {
+			free(mt->slots[i].in);
+			free(mt->slots[i].out);
+		}
 	}
-	return(copied_size);
+	free(mt->slots);
+	free(mt->th);
+	free(mt);
+	return(NULL);
 }
 
+/* io_uring, set up with the raw syscalls */
+#ifdef HAVE_IO_URING
 /**
- * @fn zfpeek
- * @brief read len (< 512k) without advancing pointer
+ * @struct zf_uring_s
+ * @brief submission and completion rings mapped as described in io_uring_setup(2); used on a single thread,
+ * which keeps the requests in flight within the depth given to zf_uring_init
  */
-size_t zfpeek(
-	zf_t *fp,
-	void *_ptr,
-	size_t len)
+struct zf_uring_s {
+	int fd;
+	uint32_t *sq_tail, *sq_mask, *sq_array;
+	uint32_t *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	void *sq_map, *cq_map;
+	size_t sq_map_size, cq_map_size, sqes_size;
+};
+
+/**
+ * @fn zf_uring_destroy
+ */
+static
+void zf_uring_destroy(
+	struct zf_uring_s *ring)
 {
-	struct zf_intl_s *fio = (struct zf_intl_s *)fp;
-	uint8_t *ptr = (uint8_t *)_ptr;
-	size_t copied_size = 0;
+	if(ring == NULL) { return; }
+	if(ring->sqes != NULL) { munmap(ring->sqes, ring->sqes_size); }
+	if(ring->cq_map != NULL) { munmap(ring->cq_map, ring->cq_map_size); }
+	if(ring->sq_map != NULL) { munmap(ring->sq_map, ring->sq_map_size); }
+	close(ring->fd);
+	free(ring);
+	return;
+}
 
-	/* check eof */
-	if(fio->eof == 2) {
-		return(0);
-	}
+/**
+ * @fn zf_uring_init
+ * @brief returns NULL if io_uring is not available (e.g. disabled by the kernel or seccomp)
+ */
+static
+struct zf_uring_s *zf_uring_init(
+	uint32_t depth)
+{
+	struct zf_uring_s *ring = (struct zf_uring_s *)calloc(1, sizeof(struct zf_uring_s));
+	if(ring == NULL) { return(NULL); }
 
-	/* copy from buffer */
-	if(fio->curr < fio->end) {
-		uint64_t rem_size = fio->end - fio->curr;
-		uint64_t buf_copy_size = (rem_size < len) ? rem_size : len;
-		memcpy(ptr, (void *)&fio->buf[fio->curr], buf_copy_size);
-		
-		/* update length (without advancing pointer) */
-		len -= buf_copy_size;
-		ptr += buf_copy_size;
-		copied_size += buf_copy_size;
+	struct io_uring_params p;
+	memset(&p, 0, sizeof(struct io_uring_params));
+	if((ring->fd = syscall(SYS_io_uring_setup, depth, &p)) < 0) {
+		free(ring);
+		return(NULL);
 	}
 
-	if(len > 0) {
-		/* move existing elements to the head of the buffer */
-		if(fio->curr != 0 && fio->curr < fio->end) {
-			memmove((void *)fio->buf, (void *)&fio->buf[fio->curr], fio->end - fio->curr);
-			fio->end -= fio->curr;
-			fio->curr = 0;
-		}
+	/* the rings and the submission entries, mapped separately (IORING_FEAT_SINGLE_MMAP is not required) */
+	ring->sq_map_size = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+	ring->cq_map_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	void *sq = mmap(NULL, ring->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED, ring->fd, IORING_OFF_SQ_RING);
+	ring->sq_map = (sq != MAP_FAILED) ? sq : NULL;
+	void *cq = mmap(NULL, ring->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED, ring->fd, IORING_OFF_CQ_RING);
+	ring->cq_map = (cq != MAP_FAILED) ? cq : NULL;
+	void *sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED, ring->fd, IORING_OFF_SQES);
+	ring->sqes = (sqes != MAP_FAILED) ? (struct io_uring_sqe *)sqes : NULL;
+	if(ring->sq_map == NULL || ring->cq_map == NULL || ring->sqes == NULL) {
+		zf_uring_destroy(ring);
+		return(NULL);
+	}
 
-		/* read */
-		uint64_t read_size = fio->fn.read(fio->fp, (void *)&fio->buf[fio->end], fio->size - fio->end);
+	uint8_t *sqb = (uint8_t *)ring->sq_map, *cqb = (uint8_t *)ring->cq_map;
+	ring->sq_tail = (uint32_t *)(sqb + p.sq_off.tail);
+	ring->sq_mask = (uint32_t *)(sqb + p.sq_off.ring_mask);
+	ring->sq_array = (uint32_t *)(sqb + p.sq_off.array);
+	ring->cq_head = (uint32_t *)(cqb + p.cq_off.head);
+	ring->cq_tail = (uint32_t *)(cqb + p.cq_off.tail);
+	ring->cq_mask = (uint32_t *)(cqb + p.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)(cqb + p.cq_off.cqes);
+	return(ring);
+}
 
-		/* copy */
-		uint64_t copy_size = (read_size < len) ? read_size : len;
-		memcpy(ptr, (void *)&fio->buf[fio->end], copy_size);
+/**
+ * @fn zf_uring_submit
+ * @brief queue a read or a write (IORING_OP_READ / IORING_OP_WRITE) at offset and enter it; returns nonzero if failed
+ */
+static
+int zf_uring_submit(
+	struct zf_uring_s *ring,
+	int op,
+	int fd,
+	void *buf,
+	uint32_t len,
+	uint64_t offset,
+	uint64_t data)
+{
+	uint32_t tail = *ring->sq_tail;
+	uint32_t idx = tail & *ring->sq_mask;
+	struct io_uring_sqe *sqe = &ring->sqes[idx];
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+	sqe->opcode = op;
+	sqe->fd = fd;
+	sqe->addr = (uint64_t)(uintptr_t)buf;
+	sqe->len = len;
+	sqe->off = offset;
+	sqe->user_data = data;
+	ring->sq_array[idx] = idx;
+	__atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+	long ret;
+	while((ret = syscall(SYS_io_uring_enter, ring->fd, 1, 0, 0, NULL, 0)) < 0 && errno == EINTR) {}
+	return((ret == 1) ? 0 : -1);
+}
 
-		/* update status */
-		copied_size += copy_size;
-		fio->eof = (read_size < (uint64_t)(fio->size - fio->end)) + (copied_size == 0);
-		fio->end += read_size;
+/**
+ * @fn zf_uring_reap
+ * @brief take a completion, waiting for one if none; returns nonzero if failed
+ */
+static
+int zf_uring_reap(
+	struct zf_uring_s *ring,
+	uint64_t *data,
+	int32_t *res)
+{
+	uint32_t head = *ring->cq_head;
+	while(head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+		if(syscall(SYS_io_uring_enter, ring->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno != EINTR) {
+			return(-1);
+		}
 	}
-	return(copied_size);
+	struct io_uring_cqe const *cqe = &ring->cqes[head & *ring->cq_mask];
+	*data = cqe->user_data;
+	*res = cqe->res;
+	__atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+	return(0);
 }
+#endif /* HAVE_IO_URING */
+
+/* uncompressed files */
+#define ZF_RAW_BLOCK_SIZE			( 1024 * 1024 )		/* size of a read issued on a worker thread or io_uring */
 
 /**
- * @fn zfwrite
- * @brief write to file, similar to gzwrite
+ * @struct zf_raw_ublk_s
+ * @brief block read or written on io_uring
  */
-size_t zfwrite(
-	zf_t *fp,
-	void *ptr,
-	size_t len)
+struct zf_raw_ublk_s {
+	uint8_t *buf;
+	uint32_t len;					/* requested */
+	int32_t res;					/* bytes transferred or -errno, valid if not busy */
+	int busy;
+};
+
+/**
+ * @struct zf_raw_s
+ * @brief uncompressed file on raw fd; zfread / zfgetc read into the caller's pointer or the zf buffer directly.
+ * with `@<threads>', regular files are read by blocks with pread on the worker threads, keeping as many reads
+ * in flight as the threads. with "uring", regular files are read or written by blocks on io_uring instead, keeping
+ * `depth' requests in flight from the caller thread. with "mmap", regular files are mapped as a whole and zf serves
+ * them out of the mapping.
+ */
+struct zf_raw_s {
+	int fd;
+	size_t head_pos, head_len;		/* bytes consumed by zf_sniff, returned first */
+	uint8_t head[ZF_SNIFF_SIZE];
+
+	/* parallel */
+	int nth;
+	struct zf_mt_s *mt;
+	struct zf_mt_blk_s *blk;		/* block being consumed, NULL if not drained */
+	size_t pos;						/* position in blk */
+	uint64_t next;					/* feeder: offset of the next block */
+	uint64_t size;					/* file size at open */
+
+	/* "uring" */
+	struct zf_uring_s *ring;
+	uint32_t depth;
+	int uerr;						/* a read was short or failed (stop), or a write failed */
+	struct zf_raw_ublk_s *ublks;	/* depth blocks, used in the order of the offsets */
+	uint64_t uhead, utail;			/* submitted and consumed block counts */
+	uint64_t uoff;					/* offset of the next block */
+	size_t upos;					/* position in the block at utail */
+
+	/* "mmap" */
+	uint8_t *map;					/* a page reserved for zfungetc, followed by the file and a page for the padding, NULL if not mapped */
+	size_t map_size;
+};
+
+/**
+ * @fn zf_raw_feed
+ */
+static
+int zf_raw_feed(
+	void *arg,
+	struct zf_mt_blk_s *blk)
 {
-	struct zf_intl_s *fio = (struct zf_intl_s *)fp;
-	return(fio->fn.write(fio->fp, ptr, len));
+	struct zf_raw_s *raw = (struct zf_raw_s *)arg;
+	if(raw->next >= raw->size) { return(0); }
+	blk->aux[0] = raw->next;
+	blk->aux[1] = (raw->size - raw->next < ZF_RAW_BLOCK_SIZE) ? raw->size - raw->next : ZF_RAW_BLOCK_SIZE;
+	raw->next += blk->aux[1];
+	return(1);
 }
 
 /**
- * @fn zfgetc
+ * @fn zf_raw_work
  */
-int zfgetc(
-	zf_t *fp)
+static
+int zf_raw_work(
+	void *arg,
+	void *wctx,
+	struct zf_mt_blk_s *blk)
 {
-	struct zf_intl_s *fio = (struct zf_intl_s *)fp;
-
-	/* if the pointer reached the end, refill the buffer */
-	if(fio->curr >= fio->end) {
-		fio->curr = 0;
-		fio->end = (fio->eof == 0)
-			? fio->fn.read(fio->fp, fio->buf, fio->size)
-			: 0;
-		fio->eof = (fio->end < fio->size) + (fio->end == 0);
-	}
-	if(fio->eof == 2) {
-		return(EOF);
+	struct zf_raw_s *raw = (struct zf_raw_s *)arg;
+	while(blk->out_len < blk->aux[1]) {
+		ssize_t read_size = pread(raw->fd, &blk->out[blk->out_len], blk->aux[1] - blk->out_len, blk->aux[0] + blk->out_len);
+		if(read_size < 0 && errno == EINTR) { continue; }
+		if(read_size <= 0) { return(-1); }		/* shrunk or broken */
+		blk->out_len += read_size;
 	}
-	return((int)fio->buf[fio->curr++]);
+	return(0);
 }
 
 /**
- * @fn zfungetc
+ * @fn zf_raw_start
  */
-int zfungetc(
-	zf_t *fp,
-	int c)
+static
+int zf_raw_start(
+	struct zf_raw_s *raw,
+	uint64_t offset)
 {
-	struct zf_intl_s *fio = (struct zf_intl_s *)fp;
-	if(fio->curr > -ZF_UNGETC_MARGIN_SIZE) {
-		return(fio->buf[--fio->curr] = c);
-	} else {
-		return(-1);
-	}
+	raw->next = offset;
+	raw->mt = zf_mt_init(raw->nth,
+		sizeof(uint64_t), ZF_RAW_BLOCK_SIZE,
+		(void *)raw,
+		NULL, NULL, zf_raw_work, zf_raw_feed, NULL);
+	return((raw->mt != NULL) ? 0 : -1);
 }
 
 /**
- * @fn zfeof
+ * @fn zf_raw_stop
  */
-int zfeof(
-	zf_t *fp)
+static
+void zf_raw_stop(
+	struct zf_raw_s *raw)
 {
-	struct zf_intl_s *fio = (struct zf_intl_s *)fp;
-	return((int)(fio->eof == 2));
+	if(raw->blk != NULL) {
+		zf_mt_release(raw->mt);
+		raw->blk = NULL;
+	}
+	zf_mt_destroy(raw->mt);
+	raw->mt = NULL;
+	raw->pos = 0;
+	return;
 }
 
+#ifdef HAVE_IO_URING
 /**
- * @fn zfputc
+ * @fn zf_raw_uring_wait
+ * @brief reap completions until the block is done; returns nonzero if failed
  */
-int zfputc(
-	zf_t *fp,
-	int c)
+static
+int zf_raw_uring_wait(
+	struct zf_raw_s *raw,
+	struct zf_raw_ublk_s *u)
 {
-	struct zf_intl_s *fio = (struct zf_intl_s *)fp;
-	fio->buf[fio->curr++] = (uint8_t)c;
-	
-	/* flush if buffer is full */
-	if(fio->curr == fio->size) {
-		fio->curr = 0;
-		uint64_t written = fio->fn.write(fio->fp, fio->buf, fio->size);
-		if((int64_t)written != fio->size) {
+	while(u->busy != 0) {
+		uint64_t data;
+		int32_t res;
+		if(zf_uring_reap(raw->ring, &data, &res) != 0) {
+			raw->uerr = 1;
 			return(-1);
 		}
+		raw->ublks[data].res = res;
+		raw->ublks[data].busy = 0;
 	}
-	return(c);
+	return(0);
 }
 
 /**
- * @fn zfputs
+ * @fn zf_raw_uring_drain
+ * @brief wait for all the blocks in flight, checking the writes; returns nonzero if any failed
  */
-int zfputs(
-	zf_t *fp,
-	char const *s)
+static
+int zf_raw_uring_drain(
+	struct zf_raw_s *raw)
 {
-	while(*s != '\0') {
-		zfputc(fp, (int)*s++);
+	for(; raw->utail < raw->uhead; raw->utail++) {
+		struct zf_raw_ublk_s *u = &raw->ublks[raw->utail % raw->depth];
+		if(zf_raw_uring_wait(raw, u) != 0) { return(-1); }
+		raw->uerr |= (u->res != (int32_t)u->len);
 	}
-	zfputc(fp, '\n');
-	return(0);
+	raw->upos = 0;
+	return(raw->uerr);
 }
 
 /**
- * @fn zfprintf
+ * @fn zf_raw_uring_start
+ * @brief returns nonzero if io_uring is not available
  */
-int zfprintf(
-	zf_t *fp,
-	char const *format,
-	...)
+static
+int zf_raw_uring_start(
+	struct zf_raw_s *raw,
+	uint32_t depth,
+	uint64_t offset)
 {
-	struct zf_intl_s *fio = (struct zf_intl_s *)fp;
-	va_list l;
-	va_start(l, format);
-
-	/* flush */
-	if(fio->curr != 0) {
-		uint64_t flush = fio->fn.write(fio->fp, fio->buf, fio->curr);
-		/* something is wrong */
-		if((int64_t)flush != fio->curr) {
-			va_end(l);
-			return(0);
+	if((raw->ring = zf_uring_init(depth)) == NULL) { return(-1); }
+	if((raw->ublks = (struct zf_raw_ublk_s *)calloc(depth, sizeof(struct zf_raw_ublk_s))) == NULL) {
+		goto _zf_raw_uring_start_error;
+	}
+	raw->depth = depth;
+	for(uint32_t i = 0; i < depth; i++) {
+		if((raw->ublks[i].buf = (uint8_t *)malloc(ZF_RAW_BLOCK_SIZE)) == NULL) {
+			goto _zf_raw_uring_start_error;
 		}
 	}
+	raw->uoff = offset;
+	return(0);
 
-	/* fprintf */
-	uint64_t size = vsprintf((char *)fio->buf, format, l);
-
-	/* flush */
-	uint64_t written = fio->fn.write(fio->fp, fio->buf, size);
-	fio->curr = size - written;
-
-	va_end(l);
-	return((int)written);
+_zf_raw_uring_start_error:;
+	for(uint32_t i = 0; raw->ublks != NULL && i < depth; i++) {
+		free(raw->ublks[i].buf);
+	}
+	free(raw->ublks);
+	raw->ublks = NULL;
+	zf_uring_destroy(raw->ring);
+	raw->ring = NULL;
+	return(-1);
 }
 
-/* unittests */
-#include <time.h>
-
 /**
- * @fn init_rand
+ * @fn zf_raw_uring_stop
+ * @brief returns nonzero if any of the writes failed; the blocks are leaked if the completions are lost
  */
-void *init_rand(
-	void *params)
+static
+int zf_raw_uring_stop(
+	struct zf_raw_s *raw)
 {
-	srand(time(NULL));
-	return(NULL);
+	int ret = zf_raw_uring_drain(raw);
+	for(uint32_t i = 0; raw->utail == raw->uhead && i < raw->depth; i++) {
+		free(raw->ublks[i].buf);
+	}
+	if(raw->utail == raw->uhead) { free(raw->ublks); }
+	raw->ublks = NULL;
+	zf_uring_destroy(raw->ring);
+	raw->ring = NULL;
+	return(ret);
 }
-void clean_rand(
-	void *gctx)
+
+/**
+ * @fn zf_raw_read_uring
+ */
+static
+size_t zf_raw_read_uring(
+	struct zf_raw_s *raw,
+	uint8_t *ptr,
+	size_t len)
 {
-	return;		/* nothing to do */
-}
+	size_t copied_size = 0;
+	while(copied_size < len && raw->uerr == 0) {
+		/* keep the blocks in flight */
+		while(raw->uhead - raw->utail < raw->depth && raw->uoff < raw->size) {
+			struct zf_raw_ublk_s *u = &raw->ublks[raw->uhead % raw->depth];
+			u->len = (raw->size - raw->uoff < ZF_RAW_BLOCK_SIZE) ? raw->size - raw->uoff : ZF_RAW_BLOCK_SIZE;
+			u->busy = 1;
+			if(zf_uring_submit(raw->ring, IORING_OP_READ, raw->fd, u->buf, u->len, raw->uoff, raw->uhead % raw->depth) != 0) {
+				u->busy = 0;
+				raw->uerr = 1;
+				break;
+			}
+			raw->uoff += u->len;
+			raw->uhead++;
+		}
+		if(raw->utail == raw->uhead) { break; }
+
+		/* consume the oldest */
+		struct zf_raw_ublk_s *u = &raw->ublks[raw->utail % raw->depth];
+		if(zf_raw_uring_wait(raw, u) != 0) { break; }
+		size_t avail = (u->res > 0) ? u->res : 0;
+		size_t copy_size = (len - copied_size < avail - raw->upos) ? len - copied_size : avail - raw->upos;
+		memcpy(ptr + copied_size, &u->buf[raw->upos], copy_size);
+		raw->upos += copy_size;
+		copied_size += copy_size;
 
-unittest_config(
-	.name = "zf",
-	.init = init_rand,
-	.clean = clean_rand
-);
+		if(raw->upos == avail) {
+			raw->uerr = (u->res != (int32_t)u->len);		/* shrunk or broken */
+			raw->utail++;
+			raw->upos = 0;
+		}
+	}
+	return(copied_size);
+}
 
 /**
- * @val ascii_table
+ * @fn zf_raw_write_uring
+ * @brief copy into the blocks and submit them, waiting for the oldest one when all are in flight;
+ * failures are reported on the subsequent writes and on close
  */
 static
-char const *ascii_table =
-	" !\"#$%&\'()*+,-./"
-	"0123456789:;<=>?"
-	"@ABCDEFGHIJKLMNO"
-	"PQRSTUVWXYZ[\\]^_"
-	"`abcdefghijklmno"
-	"pqrstuvwxyz{|}~\n";
+size_t zf_raw_write_uring(
+	struct zf_raw_s *raw,
+	uint8_t const *ptr,
+	size_t len)
+{
+	size_t copied_size = 0;
+	while(copied_size < len && raw->uerr == 0) {
+		if(raw->uhead - raw->utail == raw->depth) {
+			struct zf_raw_ublk_s *u = &raw->ublks[raw->utail % raw->depth];
+			if(zf_raw_uring_wait(raw, u) != 0) { break; }
+			raw->uerr = (u->res != (int32_t)u->len);
+			raw->utail++;
+			continue;
+		}
+
+		struct zf_raw_ublk_s *u = &raw->ublks[raw->uhead % raw->depth];
+		u->len = (len - copied_size < ZF_RAW_BLOCK_SIZE) ? len - copied_size : ZF_RAW_BLOCK_SIZE;
+		memcpy(u->buf, ptr + copied_size, u->len);
+		u->busy = 1;
+		if(zf_uring_submit(raw->ring, IORING_OP_WRITE, raw->fd, u->buf, u->len, raw->uoff, raw->uhead % raw->depth) != 0) {
+			u->busy = 0;
+			raw->uerr = 1;
+			break;
+		}
+		raw->uoff += u->len;
+		raw->uhead++;
+		copied_size += u->len;
+	}
+	return((raw->uerr == 0) ? len : 0);
+}
+#endif /* HAVE_IO_URING */
 
 /**
- * @fn make_random_array
+ * @fn zf_raw_mmap
+ * @brief map the file privately (writable for zfungetc, copied on write) between anonymous pages; the bytes after the end of
+ * the file read as zero
  */
-static inline
-void *make_random_array(
-	void *params)
+static
+int zf_raw_mmap(
+	struct zf_raw_s *raw,
+	size_t size)
 {
-	uint64_t len = (uint64_t)params;
-	char *arr = (char *)malloc(len);
-	for(uint64_t i = 0; i < len; i++) {
-		arr[i] = ascii_table[rand() % strlen(ascii_table)];
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t len = page + ((size + page - 1) & ~(page - 1)) + page;
+	uint8_t *p = (uint8_t *)mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(p == MAP_FAILED) { return(-1); }
+	if(mmap(p + page, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, raw->fd, 0) == MAP_FAILED) {
+		munmap(p, len);
+		return(-1);
 	}
-	return((void *)arr);
-}
 
-#define with(_len) \
-	.init = make_random_array, \
-	.clean = free, \
-	.params = (void *)((uint64_t)(_len))
+	/* hints; failures are harmless */
+	madvise(p + page, size, MADV_SEQUENTIAL);
+	#ifdef MADV_HUGEPAGE
+	madvise(p + page, size, MADV_HUGEPAGE);
+	#endif
 
-#define omajinai() \
-	char *arr = (char *)ctx;
+	raw->map = p;
+	raw->map_size = len;
+	raw->size = size;
+	return(0);
+}
 
-/* return NULL when failed to open */
+/**
+ * @fn zf_raw_dopen
+ */
+static
+void *zf_raw_dopen(
+	int fd,
+	char const *mode,
+	struct zf_params_s const *params)
+{
+	if(fd < 0) { return(NULL); }
+
+	struct zf_raw_s *raw = (struct zf_raw_s *)calloc(1, sizeof(struct zf_raw_s));
+	if(raw == NULL) { return(NULL); }
+	raw->fd = fd;
+	if(params->head_len != 0) {
+		memcpy(raw->head, params->head, params->head_len);
+		raw->head_len = params->head_len;
+	}
+
+	/* map regular files from the head (read serially if failed) */
+	struct stat st;
+	off_t base;
+	if(mode[0] == 'r' && params->mmap != 0 && raw->head_len == 0
+	&& lseek(fd, 0, SEEK_CUR) == 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0
+	&& zf_raw_mmap(raw, st.st_size) == 0) {
+		return((void *)raw);
+	}
+
+	/* io_uring on regular files, except for appending (the offsets are not honored there) */
+	#ifdef HAVE_IO_URING
+	if(params->uring > 0 && raw->head_len == 0
+	&& (base = lseek(fd, 0, SEEK_CUR)) >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode)
+	&& (fcntl(fd, F_GETFL) & O_APPEND) == 0
+	&& zf_raw_uring_start(raw, params->uring, base) == 0) {
+		raw->size = st.st_size;
+		return((void *)raw);
+	}
+	#endif
+
+	/* parallel on regular files in read mode */
+	if(mode[0] == 'r' && params->nth > 0 && raw->head_len == 0
+	&& (base = lseek(fd, 0, SEEK_CUR)) >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+		raw->nth = params->nth;
+		raw->size = st.st_size;
+		if(zf_raw_start(raw, base) != 0) {
+			free(raw);
+			return(NULL);
+		}
+	}
+	return((void *)raw);
+}
+
+/**
+ * @fn zf_raw_open
+ */
+static
+void *zf_raw_open(
+	char const *path,
+	char const *mode,
+	struct zf_params_s const *params)
+{
+	int fd = zf_open_fd(path, mode);
+	if(fd < 0) { return(NULL); }
+
+	void *raw = zf_raw_dopen(fd, mode, params);
+	if(raw == NULL) { close(fd); }
+	return(raw);
+}
+
+/**
+ * @fn zf_raw_close
+ */
+static
+int zf_raw_close(
+	struct zf_raw_s *raw)
+{
+	if(raw == NULL) { return(1); }
+	int ret = 0;
+	zf_raw_stop(raw);
+	#ifdef HAVE_IO_URING
+	if(raw->ring != NULL) { ret |= zf_raw_uring_stop(raw); }
+	#endif
+	if(raw->map != NULL) { munmap(raw->map, raw->map_size); }
+	ret |= close(raw->fd);
+	free(raw);
+	return(ret);
+}
+
+/**
+ * @fn zf_raw_read_parallel
+ */
+static
+size_t zf_raw_read_parallel(
+	struct zf_raw_s *raw,
+	uint8_t *ptr,
+	size_t len)
+{
+	size_t copied_size = 0;
+	while(copied_size < len) {
+		if(raw->blk == NULL) {
+			/* fetch the next block */
+			if((raw->blk = zf_mt_drain(raw->mt)) == NULL) { break; }
+			raw->pos = 0;
+		}
+
+		size_t rem_size = raw->blk->out_len - raw->pos;
+		size_t copy_size = (len - copied_size < rem_size) ? len - copied_size : rem_size;
+		memcpy(ptr + copied_size, &raw->blk->out[raw->pos], copy_size);
+		raw->pos += copy_size;
+		copied_size += copy_size;
+
+		if(raw->pos == raw->blk->out_len) {
+			int err = raw->blk->err;
+			zf_mt_release(raw->mt);
+			raw->blk = NULL;
+			if(err != 0) { break; }
+		}
+	}
+	return(copied_size);
+}
+
+/**
+ * @fn zf_raw_read
+ * @brief read(2) until len bytes are filled or the input ends, as the callers take a short read as the end
+ */
+static
+size_t zf_raw_read(
+	struct zf_raw_s *raw,
+	void *_ptr,
+	size_t len)
+{
+	uint8_t *ptr = (uint8_t *)_ptr;
+	if(raw->mt != NULL) {
+		return(zf_raw_read_parallel(raw, ptr, len));
+	}
+	#ifdef HAVE_IO_URING
+	if(raw->ring != NULL) {
+		return(zf_raw_read_uring(raw, ptr, len));
+	}
+	#endif
+
+	size_t copied_size = 0;
+	if(raw->head_pos < raw->head_len) {
+		copied_size = (len < raw->head_len - raw->head_pos) ? len : raw->head_len - raw->head_pos;
+		memcpy(ptr, &raw->head[raw->head_pos], copied_size);
+		raw->head_pos += copied_size;
+	}
+	while(copied_size < len) {
+		ssize_t read_size = read(raw->fd, ptr + copied_size, len - copied_size);
+		if(read_size < 0 && errno == EINTR) { continue; }
+		if(read_size <= 0) { break; }
+		copied_size += read_size;
+	}
+	return(copied_size);
+}
+
+/**
+ * @fn zf_raw_write
+ */
+static
+size_t zf_raw_write(
+	struct zf_raw_s *raw,
+	void *ptr,
+	size_t len)
+{
+	#ifdef HAVE_IO_URING
+	if(raw->ring != NULL) {
+		return(zf_raw_write_uring(raw, (uint8_t const *)ptr, len));
+	}
+	#endif
+	return((zf_write_all(raw->fd, ptr, len) == 0) ? len : 0);
+}
+
+/**
+ * @fn zf_raw_seek
+ */
+static
+int zf_raw_seek(
+	struct zf_raw_s *raw,
+	int64_t offset)
+{
+	struct stat st;
+	if(fstat(raw->fd, &st) != 0 || offset > st.st_size) {
+		return(-1);		/* seeking past the end is not allowed, as in the other codecs */
+	}
+	raw->head_pos = raw->head_len = 0;
+	if(lseek(raw->fd, offset, SEEK_SET) != offset) {
+		return(-1);
+	}
+
+	/* restart the blocks (read serially from the offset if failed) */
+	if(raw->nth > 0) {
+		zf_raw_stop(raw);
+		raw->size = st.st_size;
+		zf_raw_start(raw, offset);
+	}
+	#ifdef HAVE_IO_URING
+	if(raw->ring != NULL) {
+		zf_raw_uring_drain(raw);
+		if(raw->utail != raw->uhead) { return(-1); }		/* lost the completions */
+		raw->uerr = 0;
+		raw->uhead = raw->utail = 0;
+		raw->uoff = offset;
+		raw->size = st.st_size;
+	}
+	#endif
+	return(0);
+}
+
+/**
+ * @fn zf_raw_map
+ */
+static
+uint8_t *zf_raw_map(
+	struct zf_raw_s *raw,
+	size_t *len)
+{
+	if(raw->map == NULL) { return(NULL); }
+	*len = raw->size;
+	return(raw->map + sysconf(_SC_PAGESIZE));
+}
+
+/* deflate engines (zlib-dependent) */
+#ifdef HAVE_Z
+/**
+ * @struct zf_gzeng_s
+ * @brief whole-buffer raw deflate codec, used for the BGZF blocks and small files;
+ * inflate returns 0 on success, 1 if the output did not fit, and -1 on broken input, with the number of
+ * input bytes consumed in *in_used. deflate returns the compressed length (0 if it did not fit).
+ * engines with a streaming API also have gzip stream codecs for the serial reader and writer (NULL otherwise,
+ * and zlib is used there); the contexts are released by dclean / cclean. sinflate and sdeflate return 1 at the
+ * end of the member (after finish for sdeflate), 0 if more input or output space is needed, and -1 on error.
+ */
+struct zf_gzeng_s {
+	void *(*dinit)(void);
+	void (*dclean)(void *dctx);
+	int (*inflate)(void *dctx, uint8_t *out, size_t out_size, size_t *out_len, uint8_t const *in, size_t in_len, size_t *in_used);
+	void *(*cinit)(int level);
+	void (*cclean)(void *cctx);
+	size_t (*deflate)(void *cctx, uint8_t *out, size_t out_size, uint8_t const *in, size_t in_len);
+	uint32_t (*crc32)(uint32_t crc, uint8_t const *p, size_t len);
+
+	void *(*sdinit)(void);
+	void (*sdreset)(void *dctx);	/* for the next member */
+	int (*sinflate)(void *dctx, uint8_t *out, size_t out_size, size_t *out_len, uint8_t const *in, size_t in_len, size_t *in_used);
+	void *(*scinit)(int level);
+	int (*sdeflate)(void *cctx, uint8_t *out, size_t out_size, size_t *out_len, uint8_t const *in, size_t in_len, size_t *in_used, int finish);
+};
+
+/**
+ * @fn zf_gzeng_zlib_dinit
+ */
+static
+void *zf_gzeng_zlib_dinit(
+	void)
+{
+	z_stream *zs = (z_stream *)calloc(1, sizeof(z_stream));
+	if(zs == NULL) { return(NULL); }
+	if(inflateInit2(zs, -15) != Z_OK) {
+		free(zs);
+		return(NULL);
+	}
+	return((void *)zs);
+}
+
+/**
+ * @fn zf_gzeng_zlib_dclean
+ */
+static
+void zf_gzeng_zlib_dclean(
+	void *dctx)
+{
+	if(dctx == NULL) { return; }
+	inflateEnd((z_stream *)dctx);
+	free(dctx);
+	return;
+}
+
+/**
+ * @fn zf_gzeng_zlib_inflate
+ */
+static
+int zf_gzeng_zlib_inflate(
+	void *dctx,
+	uint8_t *out,
+	size_t out_size,
+	size_t *out_len,
+	uint8_t const *in,
+	size_t in_len,
+	size_t *in_used)
+{
+	z_stream *zs = (z_stream *)dctx;
+	inflateReset(zs);
+	zs->next_in = (Bytef *)in;
+	zs->avail_in = in_len;
+	zs->next_out = out;
+	zs->avail_out = out_size;
+	if(in_len > UINT32_MAX || out_size > UINT32_MAX) {
+		return(-1);
+	}
+	int ret = inflate(zs, Z_FINISH);
+	*out_len = out_size - zs->avail_out;
+	*in_used = in_len - zs->avail_in;
+	return((ret == Z_STREAM_END) ? 0 : ((ret == Z_BUF_ERROR && zs->avail_out == 0) ? 1 : -1));
+}
+
+/**
+ * @fn zf_gzeng_zlib_cinit
+ */
+static
+void *zf_gzeng_zlib_cinit(
+	int level)
+{
+	z_stream *zs = (z_stream *)calloc(1, sizeof(z_stream));
+	if(zs == NULL) { return(NULL); }
+	if(deflateInit2(zs, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+		free(zs);
+		return(NULL);
+	}
+	return((void *)zs);
+}
+
+/**
+ * @fn zf_gzeng_zlib_cclean
+ */
+static
+void zf_gzeng_zlib_cclean(
+	void *cctx)
+{
+	if(cctx == NULL) { return; }
+	deflateEnd((z_stream *)cctx);
+	free(cctx);
+	return;
+}
+
+/**
+ * @fn zf_gzeng_zlib_deflate
+ */
+static
+size_t zf_gzeng_zlib_deflate(
+	void *cctx,
+	uint8_t *out,
+	size_t out_size,
+	uint8_t const *in,
+	size_t in_len)
+{
+	z_stream *zs = (z_stream *)cctx;
+	deflateReset(zs);
+	zs->next_in = (Bytef *)in;
+	zs->avail_in = in_len;
+	zs->next_out = out;
+	zs->avail_out = out_size;
+	if(in_len > UINT32_MAX || out_size > UINT32_MAX || deflate(zs, Z_FINISH) != Z_STREAM_END) {
+		return(0);
+	}
+	return(out_size - zs->avail_out);
+}
+
+/**
+ * @fn zf_gzeng_zlib_crc32
+ */
+static
+uint32_t zf_gzeng_zlib_crc32(
+	uint32_t crc,
+	uint8_t const *p,
+	size_t len)
+{
+	while(len > 0) {
+		uInt size = (len < 0x40000000) ? len : 0x40000000;
+		crc = crc32(crc, p, size);
+		p += size;
+		len -= size;
+	}
+	return(crc);
+}
+#endif /* HAVE_Z */
+
+#if defined(HAVE_Z) && defined(HAVE_LIBDEFLATE)
+/**
+ * @fn zf_gzeng_libdeflate_dinit
+ */
+static
+void *zf_gzeng_libdeflate_dinit(
+	void)
+{
+	return((void *)libdeflate_alloc_decompressor());
+}
+
+/**
+ * @fn zf_gzeng_libdeflate_dclean
+ */
+static
+void zf_gzeng_libdeflate_dclean(
+	void *dctx)
+{
+	if(dctx == NULL) { return; }
+	libdeflate_free_decompressor((struct libdeflate_decompressor *)dctx);
+	return;
+}
+
+/**
+ * @fn zf_gzeng_libdeflate_inflate
+ */
+static
+int zf_gzeng_libdeflate_inflate(
+	void *dctx,
+	uint8_t *out,
+	size_t out_size,
+	size_t *out_len,
+	uint8_t const *in,
+	size_t in_len,
+	size_t *in_used)
+{
+	enum libdeflate_result ret = libdeflate_deflate_decompress_ex(
+		(struct libdeflate_decompressor *)dctx, in, in_len, out, out_size, in_used, out_len);
+	return((ret == LIBDEFLATE_SUCCESS) ? 0 : ((ret == LIBDEFLATE_INSUFFICIENT_SPACE) ? 1 : -1));
+}
+
+/**
+ * @fn zf_gzeng_libdeflate_cinit
+ * @brief levels above 9 (up to 12) are also accepted
+ */
+static
+void *zf_gzeng_libdeflate_cinit(
+	int level)
+{
+	level = (level < 0) ? 6 : ((level > 12) ? 12 : level);
+	return((void *)libdeflate_alloc_compressor(level));
+}
+
+/**
+ * @fn zf_gzeng_libdeflate_cclean
+ */
+static
+void zf_gzeng_libdeflate_cclean(
+	void *cctx)
+{
+	if(cctx == NULL) { return; }
+	libdeflate_free_compressor((struct libdeflate_compressor *)cctx);
+	return;
+}
+
+/**
+ * @fn zf_gzeng_libdeflate_deflate
+ */
+static
+size_t zf_gzeng_libdeflate_deflate(
+	void *cctx,
+	uint8_t *out,
+	size_t out_size,
+	uint8_t const *in,
+	size_t in_len)
+{
+	return(libdeflate_deflate_compress((struct libdeflate_compressor *)cctx, in, in_len, out, out_size));
+}
+
+/**
+ * @fn zf_gzeng_libdeflate_crc32
+ */
+static
+uint32_t zf_gzeng_libdeflate_crc32(
+	uint32_t crc,
+	uint8_t const *p,
+	size_t len)
+{
+	return(libdeflate_crc32(crc, p, len));
+}
+#endif /* HAVE_LIBDEFLATE */
+
+#if defined(HAVE_Z) && defined(HAVE_ISAL)
+/**
+ * @struct zf_gzeng_isal_s
+ * @brief igzip compressor, with level buffer for levels 1 to 3
+ */
+struct zf_gzeng_isal_s {
+	struct isal_zstream zs;
+	int level;
+	uint32_t lsize;
+	uint8_t lbuf[];
+};
+
+/**
+ * @fn zf_gzeng_isal_dinit
+ */
+static
+void *zf_gzeng_isal_dinit(
+	void)
+{
+	return(malloc(sizeof(struct inflate_state)));
+}
+
+/**
+ * @fn zf_gzeng_isal_dclean
+ */
+static
+void zf_gzeng_isal_dclean(
+	void *dctx)
+{
+	free(dctx);
+	return;
+}
+
+/**
+ * @fn zf_gzeng_isal_inflate
+ */
+static
+int zf_gzeng_isal_inflate(
+	void *dctx,
+	uint8_t *out,
+	size_t out_size,
+	size_t *out_len,
+	uint8_t const *in,
+	size_t in_len,
+	size_t *in_used)
+{
+	struct inflate_state *st = (struct inflate_state *)dctx;
+	isal_inflate_init(st);
+	st->crc_flag = ISAL_DEFLATE;
+	st->next_in = (uint8_t *)in;
+	st->avail_in = in_len;
+	st->next_out = out;
+	st->avail_out = out_size;
+	if(in_len > UINT32_MAX || out_size > UINT32_MAX) {
+		return(-1);
+	}
+	int ret = isal_inflate_stateless(st);
+	*out_len = st->total_out;
+	*in_used = in_len - st->avail_in;
+	return((ret == ISAL_DECOMP_OK) ? 0 : ((ret == ISAL_OUT_OVERFLOW) ? 1 : -1));
+}
+
+/**
+ * @fn zf_gzeng_isal_cinit
+ * @brief zlib levels are mapped onto 1 (1, 2), 2 (3 to 6, default), and 3 (7 to 9)
+ */
+static
+void *zf_gzeng_isal_cinit(
+	int level)
+{
+	level = (level < 0) ? 2 : ((level <= 2) ? 1 : ((level <= 6) ? 2 : 3));
+	uint32_t const lsize[4] = { 0, ISAL_DEF_LVL1_DEFAULT, ISAL_DEF_LVL2_DEFAULT, ISAL_DEF_LVL3_DEFAULT };
+
+	struct zf_gzeng_isal_s *isal = (struct zf_gzeng_isal_s *)malloc(sizeof(struct zf_gzeng_isal_s) + lsize[level]);
+	if(isal == NULL) { return(NULL); }
+	isal->level = level;
+	isal->lsize = lsize[level];
+	return((void *)isal);
+}
+
+/**
+ * @fn zf_gzeng_isal_cclean
+ */
+static
+void zf_gzeng_isal_cclean(
+	void *cctx)
+{
+	free(cctx);
+	return;
+}
+
+/**
+ * @fn zf_gzeng_isal_deflate
+ */
+static
+size_t zf_gzeng_isal_deflate(
+	void *cctx,
+	uint8_t *out,
+	size_t out_size,
+	uint8_t const *in,
+	size_t in_len)
+{
+	struct zf_gzeng_isal_s *isal = (struct zf_gzeng_isal_s *)cctx;
+	struct isal_zstream *zs = &isal->zs;
+	isal_deflate_stateless_init(zs);
+	zs->level = isal->level;
+	zs->level_buf = isal->lbuf;
+	zs->level_buf_size = isal->lsize;
+	zs->gzip_flag = IGZIP_DEFLATE;
+	zs->flush = NO_FLUSH;
+	zs->end_of_stream = 1;
+	zs->next_in = (uint8_t *)in;
+	zs->avail_in = in_len;
+	zs->next_out = out;
+	zs->avail_out = out_size;
+	if(in_len > UINT32_MAX || out_size > UINT32_MAX || isal_deflate_stateless(zs) != COMP_OK) {
+		return(0);
+	}
+	return(zs->total_out);
+}
+
+/**
+ * @fn zf_gzeng_isal_crc32
+ */
+static
+uint32_t zf_gzeng_isal_crc32(
+	uint32_t crc,
+	uint8_t const *p,
+	size_t len)
+{
+	return(crc32_gzip_refl(crc, p, len));
+}
+
+/**
+ * @fn zf_gzeng_isal_sdinit
+ */
+static
+void *zf_gzeng_isal_sdinit(
+	void)
+{
+	struct inflate_state *st = (struct inflate_state *)malloc(sizeof(struct inflate_state));
+	if(st == NULL) { return(NULL); }
+	isal_inflate_init(st);
+	st->crc_flag = ISAL_GZIP;
+	return((void *)st);
+}
+
+/**
+ * @fn zf_gzeng_isal_sdreset
+ */
+static
+void zf_gzeng_isal_sdreset(
+	void *dctx)
+{
+	struct inflate_state *st = (struct inflate_state *)dctx;
+	isal_inflate_reset(st);
+	st->crc_flag = ISAL_GZIP;
+	return;
+}
+
+/**
+ * @fn zf_gzeng_isal_sinflate
+ */
+static
+int zf_gzeng_isal_sinflate(
+	void *dctx,
+	uint8_t *out,
+	size_t out_size,
+	size_t *out_len,
+	uint8_t const *in,
+	size_t in_len,
+	size_t *in_used)
+{
+	struct inflate_state *st = (struct inflate_state *)dctx;
+	st->next_in = (uint8_t *)in;
+	st->avail_in = (in_len < UINT32_MAX) ? in_len : UINT32_MAX;
+	st->next_out = out;
+	st->avail_out = (out_size < UINT32_MAX) ? out_size : UINT32_MAX;
+	uint32_t avail_in = st->avail_in, avail_out = st->avail_out;
+	int ret = isal_inflate(st);
+	*out_len = avail_out - st->avail_out;
+	*in_used = avail_in - st->avail_in;
+	return((ret != ISAL_DECOMP_OK) ? -1 : ((st->block_state == ISAL_BLOCK_FINISH) ? 1 : 0));
+}
+
+/**
+ * @fn zf_gzeng_isal_scinit
+ */
+static
+void *zf_gzeng_isal_scinit(
+	int level)
+{
+	struct zf_gzeng_isal_s *isal = (struct zf_gzeng_isal_s *)zf_gzeng_isal_cinit(level);
+	if(isal == NULL) { return(NULL); }
+	struct isal_zstream *zs = &isal->zs;
+	isal_deflate_init(zs);
+	zs->level = isal->level;
+	zs->level_buf = isal->lbuf;
+	zs->level_buf_size = isal->lsize;
+	zs->gzip_flag = IGZIP_GZIP;
+	zs->flush = NO_FLUSH;
+	return((void *)isal);
+}
+
+/**
+ * @fn zf_gzeng_isal_sdeflate
+ */
+static
+int zf_gzeng_isal_sdeflate(
+	void *cctx,
+	uint8_t *out,
+	size_t out_size,
+	size_t *out_len,
+	uint8_t const *in,
+	size_t in_len,
+	size_t *in_used,
+	int finish)
+{
+	struct isal_zstream *zs = &((struct zf_gzeng_isal_s *)cctx)->zs;
+	zs->next_in = (uint8_t *)in;
+	zs->avail_in = (in_len < UINT32_MAX) ? in_len : UINT32_MAX;
+	zs->next_out = out;
+	zs->avail_out = (out_size < UINT32_MAX) ? out_size : UINT32_MAX;
+	zs->end_of_stream = (finish != 0 && zs->avail_in == in_len);
+	uint32_t avail_in = zs->avail_in, avail_out = zs->avail_out;
+	int ret = isal_deflate(zs);
+	*out_len = avail_out - zs->avail_out;
+	*in_used = avail_in - zs->avail_in;
+	return((ret != COMP_OK) ? -1 : ((zs->internal_state.state == ZSTATE_END) ? 1 : 0));
+}
+#endif /* HAVE_ISAL */
+
+#if defined(HAVE_Z) && defined(HAVE_ZLIBNG)
+/**
+ * @fn zf_gzeng_zlibng_dinit
+ */
+static
+void *zf_gzeng_zlibng_dinit(
+	void)
+{
+	zng_stream *zs = (zng_stream *)calloc(1, sizeof(zng_stream));
+	if(zs == NULL) { return(NULL); }
+	if(zng_inflateInit2(zs, -15) != Z_OK) {
+		free(zs);
+		return(NULL);
+	}
+	return((void *)zs);
+}
+
+/**
+ * @fn zf_gzeng_zlibng_dclean
+ */
+static
+void zf_gzeng_zlibng_dclean(
+	void *dctx)
+{
+	if(dctx == NULL) { return; }
+	zng_inflateEnd((zng_stream *)dctx);
+	free(dctx);
+	return;
+}
+
+/**
+ * @fn zf_gzeng_zlibng_inflate
+ */
+static
+int zf_gzeng_zlibng_inflate(
+	void *dctx,
+	uint8_t *out,
+	size_t out_size,
+	size_t *out_len,
+	uint8_t const *in,
+	size_t in_len,
+	size_t *in_used)
+{
+	zng_stream *zs = (zng_stream *)dctx;
+	zng_inflateReset(zs);
+	zs->next_in = in;
+	zs->avail_in = in_len;
+	zs->next_out = out;
+	zs->avail_out = out_size;
+	if(in_len > UINT32_MAX || out_size > UINT32_MAX) {
+		return(-1);
+	}
+	int ret = zng_inflate(zs, Z_FINISH);
+	*out_len = out_size - zs->avail_out;
+	*in_used = in_len - zs->avail_in;
+	return((ret == Z_STREAM_END) ? 0 : ((ret == Z_BUF_ERROR && zs->avail_out == 0) ? 1 : -1));
+}
+
+/**
+ * @fn zf_gzeng_zlibng_cinit
+ */
+static
+void *zf_gzeng_zlibng_cinit(
+	int level)
+{
+	zng_stream *zs = (zng_stream *)calloc(1, sizeof(zng_stream));
+	if(zs == NULL) { return(NULL); }
+	if(zng_deflateInit2(zs, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+		free(zs);
+		return(NULL);
+	}
+	return((void *)zs);
+}
+
+/**
+ * @fn zf_gzeng_zlibng_cclean
+ */
+static
+void zf_gzeng_zlibng_cclean(
+	void *cctx)
+{
+	if(cctx == NULL) { return; }
+	zng_deflateEnd((zng_stream *)cctx);
+	free(cctx);
+	return;
+}
+
+/**
+ * @fn zf_gzeng_zlibng_deflate
+ */
+static
+size_t zf_gzeng_zlibng_deflate(
+	void *cctx,
+	uint8_t *out,
+	size_t out_size,
+	uint8_t const *in,
+	size_t in_len)
+{
+	zng_stream *zs = (zng_stream *)cctx;
+	zng_deflateReset(zs);
+	zs->next_in = in;
+	zs->avail_in = in_len;
+	zs->next_out = out;
+	zs->avail_out = out_size;
+	if(in_len > UINT32_MAX || out_size > UINT32_MAX || zng_deflate(zs, Z_FINISH) != Z_STREAM_END) {
+		return(0);
+	}
+	return(out_size - zs->avail_out);
+}
+
+/**
+ * @fn zf_gzeng_zlibng_crc32
+ */
+static
+uint32_t zf_gzeng_zlibng_crc32(
+	uint32_t crc,
+	uint8_t const *p,
+	size_t len)
+{
+	while(len > 0) {
+		uint32_t size = (len < 0x40000000) ? len : 0x40000000;
+		crc = zng_crc32(crc, p, size);
+		p += size;
+		len -= size;
+	}
+	return(crc);
+}
+
+/**
+ * @fn zf_gzeng_zlibng_sdinit
+ */
+static
+void *zf_gzeng_zlibng_sdinit(
+	void)
+{
+	zng_stream *zs = (zng_stream *)calloc(1, sizeof(zng_stream));
+	if(zs == NULL) { return(NULL); }
+	if(zng_inflateInit2(zs, 15 + 16) != Z_OK) {
+		free(zs);
+		return(NULL);
+	}
+	return((void *)zs);
+}
+
+/**
+ * @fn zf_gzeng_zlibng_sdreset
+ */
+static
+void zf_gzeng_zlibng_sdreset(
+	void *dctx)
+{
+	zng_inflateReset((zng_stream *)dctx);
+	return;
+}
+
+/**
+ * @fn zf_gzeng_zlibng_sinflate
+ */
+static
+int zf_gzeng_zlibng_sinflate(
+	void *dctx,
+	uint8_t *out,
+	size_t out_size,
+	size_t *out_len,
+	uint8_t const *in,
+	size_t in_len,
+	size_t *in_used)
+{
+	zng_stream *zs = (zng_stream *)dctx;
+	zs->next_in = in;
+	zs->avail_in = (in_len < UINT32_MAX) ? in_len : UINT32_MAX;
+	zs->next_out = out;
+	zs->avail_out = (out_size < UINT32_MAX) ? out_size : UINT32_MAX;
+	uint32_t avail_in = zs->avail_in, avail_out = zs->avail_out;
+	int ret = zng_inflate(zs, Z_NO_FLUSH);
+	*out_len = avail_out - zs->avail_out;
+	*in_used = avail_in - zs->avail_in;
+	return((ret == Z_STREAM_END) ? 1 : ((ret == Z_OK || ret == Z_BUF_ERROR) ? 0 : -1));
+}
+
+/**
+ * @fn zf_gzeng_zlibng_scinit
+ */
+static
+void *zf_gzeng_zlibng_scinit(
+	int level)
+{
+	zng_stream *zs = (zng_stream *)calloc(1, sizeof(zng_stream));
+	if(zs == NULL) { return(NULL); }
+	if(zng_deflateInit2(zs, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+		free(zs);
+		return(NULL);
+	}
+	return((void *)zs);
+}
+
+/**
+ * @fn zf_gzeng_zlibng_sdeflate
+ */
+static
+int zf_gzeng_zlibng_sdeflate(
+	void *cctx,
+	uint8_t *out,
+	size_t out_size,
+	size_t *out_len,
+	uint8_t const *in,
+	size_t in_len,
+	size_t *in_used,
+	int finish)
+{
+	zng_stream *zs = (zng_stream *)cctx;
+	zs->next_in = in;
+	zs->avail_in = (in_len < UINT32_MAX) ? in_len : UINT32_MAX;
+	zs->next_out = out;
+	zs->avail_out = (out_size < UINT32_MAX) ? out_size : UINT32_MAX;
+	uint32_t avail_in = zs->avail_in, avail_out = zs->avail_out;
+	int ret = zng_deflate(zs, (finish != 0 && avail_in == in_len) ? Z_FINISH : Z_NO_FLUSH);
+	*out_len = avail_out - zs->avail_out;
+	*in_used = avail_in - zs->avail_in;
+	return((ret == Z_STREAM_END) ? 1 : ((ret == Z_OK || ret == Z_BUF_ERROR) ? 0 : -1));
+}
+#endif /* HAVE_ZLIBNG */
+
+#ifdef HAVE_Z
+/**
+ * @val zf_gzeng_table
+ * @brief indexed by ZF_GZENG_*; entries of the engines not found at configure time are left empty
+ */
+static
+struct zf_gzeng_s const zf_gzeng_table[ZF_GZENG_CNT] = {
+	[ZF_GZENG_ZLIB] = {
+		.dinit = zf_gzeng_zlib_dinit,
+		.dclean = zf_gzeng_zlib_dclean,
+		.inflate = zf_gzeng_zlib_inflate,
+		.cinit = zf_gzeng_zlib_cinit,
+		.cclean = zf_gzeng_zlib_cclean,
+		.deflate = zf_gzeng_zlib_deflate,
+		.crc32 = zf_gzeng_zlib_crc32
+	},
+	[ZF_GZENG_LIBDEFLATE] = {
+		#ifdef HAVE_LIBDEFLATE
+		.dinit = zf_gzeng_libdeflate_dinit,
+		.dclean = zf_gzeng_libdeflate_dclean,
+		.inflate = zf_gzeng_libdeflate_inflate,
+		.cinit = zf_gzeng_libdeflate_cinit,
+		.cclean = zf_gzeng_libdeflate_cclean,
+		.deflate = zf_gzeng_libdeflate_deflate,
+		.crc32 = zf_gzeng_libdeflate_crc32
+		#endif
+	},
+	[ZF_GZENG_ISAL] = {
+		#ifdef HAVE_ISAL
+		.dinit = zf_gzeng_isal_dinit,
+		.dclean = zf_gzeng_isal_dclean,
+		.inflate = zf_gzeng_isal_inflate,
+		.cinit = zf_gzeng_isal_cinit,
+		.cclean = zf_gzeng_isal_cclean,
+		.deflate = zf_gzeng_isal_deflate,
+		.crc32 = zf_gzeng_isal_crc32,
+		.sdinit = zf_gzeng_isal_sdinit,
+		.sdreset = zf_gzeng_isal_sdreset,
+		.sinflate = zf_gzeng_isal_sinflate,
+		.scinit = zf_gzeng_isal_scinit,
+		.sdeflate = zf_gzeng_isal_sdeflate
+		#endif
+	},
+	[ZF_GZENG_ZLIBNG] = {
+		#ifdef HAVE_ZLIBNG
+		.dinit = zf_gzeng_zlibng_dinit,
+		.dclean = zf_gzeng_zlibng_dclean,
+		.inflate = zf_gzeng_zlibng_inflate,
+		.cinit = zf_gzeng_zlibng_cinit,
+		.cclean = zf_gzeng_zlibng_cclean,
+		.deflate = zf_gzeng_zlibng_deflate,
+		.crc32 = zf_gzeng_zlibng_crc32,
+		.sdinit = zf_gzeng_zlibng_sdinit,
+		.sdreset = zf_gzeng_zlibng_sdreset,
+		.sinflate = zf_gzeng_zlibng_sinflate,
+		.scinit = zf_gzeng_zlibng_scinit,
+		.sdeflate = zf_gzeng_zlibng_sdeflate
+		#endif
+	}
+};
+
+/**
+ * @fn zf_gzeng_get
+ * @brief the requested engine (checked by zf_gzeng_avail on open); ZF_GZENG_AUTO picks the fastest one available
+ */
+static
+struct zf_gzeng_s const *zf_gzeng_get(
+	int eng)
+{
+	int const order[ZF_GZENG_CNT - 1] = { ZF_GZENG_LIBDEFLATE, ZF_GZENG_ISAL, ZF_GZENG_ZLIBNG, ZF_GZENG_ZLIB };
+
+	if(eng > ZF_GZENG_AUTO && eng < ZF_GZENG_CNT && zf_gzeng_table[eng].inflate != NULL) {
+		return(&zf_gzeng_table[eng]);
+	}
+	for(int i = 0; i < ZF_GZENG_CNT - 1; i++) {
+		if(zf_gzeng_table[order[i]].inflate != NULL) {
+			return(&zf_gzeng_table[order[i]]);
+		}
+	}
+	return(&zf_gzeng_table[ZF_GZENG_ZLIB]);
+}
+
+/**
+ * @fn zf_gzeng_get_stream
+ * @brief engine for the serial gzip reader and writer, NULL for zlib (also for libdeflate, which has no streaming API);
+ * ZF_GZENG_AUTO picks the fastest one available
+ */
+static
+struct zf_gzeng_s const *zf_gzeng_get_stream(
+	int eng)
+{
+	int const order[2] = { ZF_GZENG_ISAL, ZF_GZENG_ZLIBNG };
+
+	if(eng > ZF_GZENG_AUTO && eng < ZF_GZENG_CNT) {
+		return((zf_gzeng_table[eng].sinflate != NULL) ? &zf_gzeng_table[eng] : NULL);
+	}
+	for(int i = 0; i < 2; i++) {
+		if(zf_gzeng_table[order[i]].sinflate != NULL) {
+			return(&zf_gzeng_table[order[i]]);
+		}
+	}
+	return(NULL);
+}
+
+/**
+ * @struct zf_gzeng_ctx_s
+ * @brief decompressor or compressor paired with its engine, used as the worker context of zf_mt_s
+ */
+struct zf_gzeng_ctx_s {
+	struct zf_gzeng_s const *eng;
+	int comp;
+	void *ctx;
+};
+
+/**
+ * @fn zf_gzeng_ctx_init
+ * @brief create compressor of `level' if comp is nonzero, decompressor otherwise
+ */
+static
+struct zf_gzeng_ctx_s *zf_gzeng_ctx_init(
+	struct zf_gzeng_s const *eng,
+	int comp,
+	int level)
+{
+	struct zf_gzeng_ctx_s *c = (struct zf_gzeng_ctx_s *)malloc(sizeof(struct zf_gzeng_ctx_s));
+	if(c == NULL) { return(NULL); }
+	c->eng = eng;
+	c->comp = comp;
+	if((c->ctx = (comp != 0) ? eng->cinit(level) : eng->dinit()) == NULL) {
+		free(c);
+		return(NULL);
+	}
+	return(c);
+}
+
+/**
+ * @fn zf_gzeng_ctx_clean
+ */
+static
+void zf_gzeng_ctx_clean(
+	void *wctx)
+{
+	struct zf_gzeng_ctx_s *c = (struct zf_gzeng_ctx_s *)wctx;
+	if(c == NULL) { return; }
+	if(c->comp != 0) {
+		c->eng->cclean(c->ctx);
+	} else {
+		c->eng->dclean(c->ctx);
+	}
+	free(c);
+	return;
+}
+#endif /* HAVE_Z */
+
+/* parallel gzip compressor (zlib-dependent) */
+#ifdef HAVE_Z
+#define ZF_PGZ_BLOCK_SIZE			( 128 * 1024 )		/* fixed to make the output independent of the number of threads */
+#define ZF_PGZ_DICT_SIZE			( 32 * 1024 )
+
+/**
+ * @struct zf_pgzw_s
+ * @brief parallel gzip writer context; input is split into ZF_PGZ_BLOCK_SIZE chunks,
+ * each compressed independently with the last 32KB of the previous chunk as dictionary
+ * and terminated with sync flush, so that the concatenation forms a single deflate stream.
+ */
+struct zf_pgzw_s {
+	int fd;
+	int level;
+	int err;
+	uint32_t crc;
+	uint64_t isize;
+	struct zf_mt_s *mt;
+	struct zf_mt_blk_s *blk;		/* block being filled, NULL if not acquired */
+	struct zf_mt_blk_s *prev;		/* the last pushed block, dictionary is copied from it */
+};
+
+/**
+ * @fn zf_pgzw_winit
+ * @brief create deflate stream for each worker
+ */
+static
+void *zf_pgzw_winit(
+	void *arg)
+{
+	struct zf_pgzw_s *pgz = (struct zf_pgzw_s *)arg;
+	z_stream *zs = (z_stream *)calloc(1, sizeof(z_stream));
+	if(zs == NULL) { return(NULL); }
+	if(deflateInit2(zs, pgz->level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+		free(zs);
+		return(NULL);
+	}
+	return((void *)zs);
+}
+
+/**
+ * @fn zf_pgzw_wclean
+ */
+static
+void zf_pgzw_wclean(
+	void *wctx)
+{
+	if(wctx == NULL) { return; }
+	deflateEnd((z_stream *)wctx);
+	free(wctx);
+	return;
+}
+
+/**
+ * @fn zf_pgzw_work
+ * @brief compress a block; in = [dictionary (aux[0] bytes)][data (in_len bytes)]
+ */
+static
+int zf_pgzw_work(
+	void *arg,
+	void *wctx,
+	struct zf_mt_blk_s *blk)
+{
+	z_stream *zs = (z_stream *)wctx;
+	if(zs == NULL) { return(-1); }
+
+	uint8_t *data = blk->in + ZF_PGZ_DICT_SIZE;
+	deflateReset(zs);
+	if(blk->aux[0] != 0) {
+		deflateSetDictionary(zs, data - blk->aux[0], blk->aux[0]);
+	}
+	zs->next_in = data;
+	zs->avail_in = blk->in_len;
+	zs->next_out = blk->out;
+	zs->avail_out = blk->out_size;
+	if(deflate(zs, Z_SYNC_FLUSH) != Z_OK || zs->avail_in != 0 || zs->avail_out == 0) {
+		return(-1);
+	}
+	blk->out_len = blk->out_size - zs->avail_out;
+	blk->aux[1] = crc32(0, data, blk->in_len);
+	return(0);
+}
+
+/**
+ * @fn zf_pgzw_emit
+ * @brief write compressed block to file in order
+ */
+static
+int zf_pgzw_emit(
+	void *arg,
+	struct zf_mt_blk_s *blk)
+{
+	struct zf_pgzw_s *pgz = (struct zf_pgzw_s *)arg;
+	if(pgz->err != 0 || blk->err != 0 || zf_write_all(pgz->fd, blk->out, blk->out_len) != 0) {
+		zf_mt_flag(pgz->mt, &pgz->err, 1);
+		return(-1);
+	}
+	pgz->crc = crc32_combine(pgz->crc, blk->aux[1], blk->in_len);
+	pgz->isize += blk->in_len;
+	return(0);
+}
+
+/**
+ * @fn zf_pgzw_push
+ * @brief send the current block to workers
+ */
+static
+void zf_pgzw_push(
+	struct zf_pgzw_s *pgz)
+{
+	zf_mt_push(pgz->mt);
+	pgz->prev = pgz->blk;
+	pgz->blk = NULL;
+	return;
+}
+
+/**
+ * @fn zf_pgzw_write
+ */
+static
+size_t zf_pgzw_write(
+	void *fp,
+	void *_ptr,
+	size_t len)
+{
+	struct zf_pgzw_s *pgz = (struct zf_pgzw_s *)fp;
+	uint8_t const *ptr = (uint8_t const *)_ptr;
+	size_t copied_size = 0;
+
+	while(copied_size < len) {
+		if(pgz->blk == NULL) {
+			/* get an empty block, then copy the tail of the previous (always full) one as dictionary */
+			if((pgz->blk = zf_mt_acquire(pgz->mt)) == NULL) { break; }
+			pgz->blk->aux[0] = 0;
+			if(pgz->prev != NULL) {
+				pgz->blk->aux[0] = ZF_PGZ_DICT_SIZE;
+				memcpy(pgz->blk->in, pgz->prev->in + ZF_PGZ_BLOCK_SIZE, ZF_PGZ_DICT_SIZE);
+			}
+		}
+
+		/* copy */
+		size_t rem_size = ZF_PGZ_BLOCK_SIZE - pgz->blk->in_len;
+		size_t copy_size = (len - copied_size < rem_size) ? len - copied_size : rem_size;
+		memcpy(pgz->blk->in + ZF_PGZ_DICT_SIZE + pgz->blk->in_len, ptr + copied_size, copy_size);
+		pgz->blk->in_len += copy_size;
+		copied_size += copy_size;
+
+		/* flush if full */
+		if(pgz->blk->in_len == ZF_PGZ_BLOCK_SIZE) {
+			zf_pgzw_push(pgz);
+		}
+	}
+	return((zf_mt_flag(pgz->mt, &pgz->err, 0) == 0) ? copied_size : 0);
+}
+
+/**
+ * @fn zf_pgzw_close
+ */
+static
+int zf_pgzw_close(
+	void *fp)
+{
+	struct zf_pgzw_s *pgz = (struct zf_pgzw_s *)fp;
+	if(pgz->blk != NULL && pgz->blk->in_len != 0) {
+		zf_pgzw_push(pgz);
+	}
+	zf_mt_destroy(pgz->mt);			/* drains all the blocks */
+
+	/* terminate the deflate stream with an empty final block, then trailer */
+	uint8_t const tail[10] = {
+		0x03, 0x00,
+		pgz->crc, pgz->crc>>8, pgz->crc>>16, pgz->crc>>24,
+		pgz->isize, pgz->isize>>8, pgz->isize>>16, pgz->isize>>24
+	};
+	int ret = (pgz->err == 0) ? zf_write_all(pgz->fd, tail, 10) : -1;
+	ret |= close(pgz->fd);
+	free(pgz);
+	return(ret);
+}
+
+/**
+ * @fn zf_pgzw_dopen
+ */
+static
+void *zf_pgzw_dopen(
+	int fd,
+	char const *mode,
+	struct zf_params_s const *params)
+{
+	if(fd < 0) { return(NULL); }
+
+	struct zf_pgzw_s *pgz = (struct zf_pgzw_s *)calloc(1, sizeof(struct zf_pgzw_s));
+	if(pgz == NULL) { return(NULL); }
+	pgz->fd = fd;
+	pgz->level = zf_parse_level(mode, Z_DEFAULT_COMPRESSION, 0, 9);
+	pgz->crc = crc32(0, NULL, 0);
+
+	/* header: no file name, mtime = 0, OS = unix */
+	uint8_t const head[10] = { 0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03 };
+	if(zf_write_all(fd, head, 10) != 0) {
+		free(pgz);
+		return(NULL);
+	}
+
+	pgz->mt = zf_mt_init(params->nth,
+		ZF_PGZ_DICT_SIZE + ZF_PGZ_BLOCK_SIZE,
+		deflateBound(NULL, ZF_PGZ_BLOCK_SIZE) + 16,
+		(void *)pgz,
+		zf_pgzw_winit, zf_pgzw_wclean, zf_pgzw_work, NULL, zf_pgzw_emit);
+	if(pgz->mt == NULL) {
+		free(pgz);
+		return(NULL);
+	}
+	return((void *)pgz);
+}
+
+/**
+ * @fn zf_pgzw_open
+ */
+static
+void *zf_pgzw_open(
+	char const *path,
+	char const *mode,
+	struct zf_params_s const *params)
+{
+	int fd = zf_open_fd(path, mode);
+	void *fp = zf_pgzw_dopen(fd, mode, params);
+	if(fp == NULL && fd >= 0) { close(fd); }
+	return(fp);
+}
+#endif /* HAVE_Z */
+
+/* gzip compressor (zlib-dependent) */
+#ifdef HAVE_Z
+#define ZF_GZW_OUT_SIZE				( 256 * 1024 )
+
+/**
+ * @struct zf_gzw_s
+ * @brief gzip writer context; deflated on the caller thread from the caller's pointer (or the zf buffer)
+ * directly, without the buffers of gzFile
+ */
+struct zf_gzw_s {
+	int fd;
+	int err;
+	struct zf_gzeng_s const *eng;	/* engine with the stream codec, NULL for zlib */
+	void *cctx;						/* stream compressor of eng */
+	z_stream zs;
+	uint8_t out[ZF_GZW_OUT_SIZE];
+};
+
+/**
+ * @fn zf_gzw_sdeflate
+ * @brief zf_gzw_deflate on the stream compressor of the engine
+ */
+static
+int zf_gzw_sdeflate(
+	struct zf_gzw_s *gz,
+	uint8_t const *in,
+	size_t len,
+	int finish)
+{
+	int ret;
+	size_t olen, used;
+	do {
+		ret = gz->eng->sdeflate(gz->cctx, gz->out, ZF_GZW_OUT_SIZE, &olen, in, len, &used, finish);
+		in += used;
+		len -= used;
+		if(ret < 0 || zf_write_all(gz->fd, gz->out, olen) != 0) {
+			gz->err = 1;
+			return(-1);
+		}
+	} while(len > 0 || olen == ZF_GZW_OUT_SIZE || (finish != 0 && ret != 1));
+	return(0);
+}
+
+/**
+ * @fn zf_gzw_deflate
+ * @brief deflate all the input in zs, and write out the compressed bytes
+ */
+static
+int zf_gzw_deflate(
+	struct zf_gzw_s *gz,
+	int flush)
+{
+	int ret;
+	do {
+		gz->zs.next_out = gz->out;
+		gz->zs.avail_out = ZF_GZW_OUT_SIZE;
+		ret = deflate(&gz->zs, flush);
+		if(ret == Z_STREAM_ERROR
+		|| zf_write_all(gz->fd, gz->out, ZF_GZW_OUT_SIZE - gz->zs.avail_out) != 0) {
+			gz->err = 1;
+			return(-1);
+		}
+	} while(gz->zs.avail_out == 0 || (flush == Z_FINISH && ret != Z_STREAM_END));
+	return(0);
+}
+
+/**
+ * @fn zf_gzw_write
+ */
+static
+size_t zf_gzw_write(
+	void *fp,
+	void *ptr,
+	size_t len)
+{
+	struct zf_gzw_s *gz = (struct zf_gzw_s *)fp;
+	if(gz->err != 0) { return(0); }
+	if(gz->cctx != NULL) {
+		return((zf_gzw_sdeflate(gz, (uint8_t const *)ptr, len, 0) == 0) ? len : 0);
+	}
+
+	gz->zs.next_in = (Bytef *)ptr;
+	for(size_t rem = len; rem > 0;) {
+		gz->zs.avail_in = (rem < 0x40000000) ? rem : 0x40000000;
+		rem -= gz->zs.avail_in;
+		if(zf_gzw_deflate(gz, Z_NO_FLUSH) != 0) { return(0); }
+	}
+	return(len);
+}
+
+/**
+ * @fn zf_gzw_close
+ */
+static
+int zf_gzw_close(
+	void *fp)
+{
+	struct zf_gzw_s *gz = (struct zf_gzw_s *)fp;
+	int ret;
+	if(gz->cctx != NULL) {
+		ret = (gz->err == 0) ? zf_gzw_sdeflate(gz, NULL, 0, 1) : -1;
+		gz->eng->cclean(gz->cctx);
+	} else {
+		gz->zs.avail_in = 0;
+		ret = (gz->err == 0) ? zf_gzw_deflate(gz, Z_FINISH) : -1;
+		deflateEnd(&gz->zs);
+	}
+	ret |= close(gz->fd);
+	free(gz);
+	return(ret);
+}
+
+/**
+ * @fn zf_gzw_dopen
+ */
+static
+void *zf_gzw_dopen(
+	int fd,
+	char const *mode,
+	struct zf_params_s const *params)
+{
+	if(fd < 0) { return(NULL); }
+
+	struct zf_gzw_s *gz = (struct zf_gzw_s *)calloc(1, sizeof(struct zf_gzw_s));
+	if(gz == NULL) { return(NULL); }
+	gz->fd = fd;
+	int level = zf_parse_level(mode, Z_DEFAULT_COMPRESSION, 0, 9);
+	if((gz->eng = zf_gzeng_get_stream(params->eng)) != NULL) {
+		gz->cctx = gz->eng->scinit(level);
+	}
+	if((gz->eng != NULL) ? (gz->cctx == NULL)
+	: (deflateInit2(&gz->zs, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)) {
+		free(gz);
+		return(NULL);
+	}
+	return((void *)gz);
+}
+
+/**
+ * @fn zf_gzw_open
+ */
+static
+void *zf_gzw_open(
+	char const *path,
+	char const *mode,
+	struct zf_params_s const *params)
+{
+	int fd = zf_open_fd(path, mode);
+	void *fp = zf_gzw_dopen(fd, mode, params);
+	if(fp == NULL && fd >= 0) { close(fd); }
+	return(fp);
+}
+#endif /* HAVE_Z */
+
+/* gzip decompressor (zlib-dependent) */
+#ifdef HAVE_Z
+#define ZF_BGZF_BLOCK_SIZE			( 64 * 1024 )		/* max size of compressed / decompressed blocks */
+#define ZF_GZIDX_WINDOW_SIZE		( 32 * 1024 )
+#define ZF_GZIDX_MAGIC				( "ZFI\x02" )
+#define ZF_GZIDX_STAMP_SIZE			( 4096 )			/* bytes of the head and tail of the compressed file in the crc */
+
+/* kind of input */
+#define ZF_GZR_RAW					( 0 )				/* not gzip, copied as is (same as gzread) */
+#define ZF_GZR_SERIAL				( 1 )				/* inflated on the caller thread */
+#define ZF_GZR_BGZF					( 2 )				/* BGZF, inflated on worker threads */
+#define ZF_GZR_WHOLE				( 3 )				/* small file, inflated at once on open */
+#define ZF_GZR_WHOLE_SIZE			( 4 * 1024 * 1024 )	/* max compressed size for ZF_GZR_WHOLE */
+#define ZF_GZR_WHOLE_OUT_SIZE		( 256 * 1024 * 1024 )	/* max decompressed size for ZF_GZR_WHOLE */
+#define ZF_GZR_SPEC					( 4 )				/* non-BGZF, inflated speculatively on worker threads */
+#define ZF_GZSP_CHUNK_SIZE			( 2 * 1024 * 1024 )	/* compressed size of a chunk for ZF_GZR_SPEC */
+#define ZF_GZSP_OUT_MARGIN			( 64 * 1024 )
+
+/**
+ * @struct zf_gzidx_point_s
+ * @brief random access checkpoint (see zran.c in zlib); inflate can be resumed from the
+ * coffset-th byte (the (coffset - 1)-th byte with `bits' bits if bits != 0) with the window.
+ */
+struct zf_gzidx_point_s {
+	uint64_t coffset, uoffset;
+	uint32_t bits, wlen;
+	uint8_t *window;
+};
+
+/**
+ * @struct zf_gzidx_s
+ */
+struct zf_gzidx_s {
+	uint64_t span;					/* minimum distance of points in the uncompressed stream */
+	int loaded;						/* loaded from file (no need to build) */
+	uint64_t cnt, max;
+	struct zf_gzidx_point_s *pts;
+};
+
+/**
+ * @struct zf_gzr_s
+ * @brief gzip reader context; BGZF blocks are inflated on worker threads,
+ * others are inflated on the caller thread
+ */
+struct zf_gzr_s {
+	int kind;
+	int err;
+	int broken;						/* err was set before rewinding, kept for close */
+	int zs_end;						/* serial: reached the end of stream */
+	int raw;						/* serial: resumed from a checkpoint (inflating without gzip header) */
+	struct zf_gzeng_s const *eng;	/* parallel: deflate engine for the blocks, serial: engine of dctx */
+	void *dctx;						/* serial: stream decompressor of eng, NULL to inflate with zs */
+	uint64_t uoffset;				/* serial: position in the uncompressed stream */
+	struct zf_gzidx_s *idx;			/* serial: NULL if disabled */
+	char *idx_path;
+	struct zf_mt_s *mt;
+	struct zf_mt_blk_s *blk;		/* block being consumed, NULL if not drained */
+	size_t pos;						/* position in blk or whole */
+	uint8_t *whole;					/* whole: decompressed content, after ZF_UNGETC_MARGIN_SIZE bytes and followed by ZF_BUF_PADDING zeroed bytes */
+	size_t whole_len, whole_size;
+
+	/* speculative: chunks are decoded from the mapped file */
+	int nth;
+	int spec_end;					/* what the current chunk ended at, see zf_gzsp_decode */
+	uint8_t const *map;
+	size_t map_size;
+	uint64_t spec_next;				/* feeder: index of the next chunk */
+	uint64_t spec_exp;				/* bit offset where the next chunk must start */
+	uint64_t spec_redo;				/* chunks decoded again on the caller thread */
+	uint32_t crc;
+	uint64_t isize;
+	uint8_t const *cur;				/* chunk being consumed, either blk->out or rep.out */
+	size_t cur_len;
+	struct zf_mt_blk_s rep;			/* chunk decoded again on the caller thread */
+	size_t wlen;
+	uint8_t window[ZF_GZIDX_WINDOW_SIZE];
+	z_stream zs;
+	struct zf_src_s src;
+};
+
+/**
+ * @fn zf_gzidx_put_u64
+ */
+static
+int zf_gzidx_put_u64(
+	FILE *fp,
+	uint64_t val)
+{
+	uint8_t b[8];
+	for(int i = 0; i < 8; i++) { b[i] = val>>(8 * i); }
+	return((fwrite(b, 1, 8, fp) == 8) ? 0 : -1);
+}
+
+/**
+ * @fn zf_gzidx_get_u64
+ */
+static
+uint64_t zf_gzidx_get_u64(
+	FILE *fp,
+	int *err)
+{
+	uint8_t b[8];
+	uint64_t val = 0;
+	if(fread(b, 1, 8, fp) != 8) {
+		*err = 1;
+		return(0);
+	}
+	for(int i = 0; i < 8; i++) { val |= (uint64_t)b[i]<<(8 * i); }
+	return(val);
+}
+
+/**
+ * @fn zf_gzidx_destroy
+ */
+static
+void zf_gzidx_destroy(
+	struct zf_gzidx_s *idx)
+{
+	if(idx == NULL) { return; }
+	for(uint64_t i = 0; i < idx->cnt; i++) {
+		free(idx->pts[i].window);
+	}
+	free(idx->pts);
+	free(idx);
+	return;
+}
+
+/**
+ * @fn zf_gzidx_stamp
+ * @brief identify the compressed file by size, mtime, and crc of its head and tail, which the index must match
+ */
+static
+int zf_gzidx_stamp(
+	int fd,
+	uint64_t stamp[3])
+{
+	struct stat st;
+	if(fstat(fd, &st) != 0) { return(-1); }
+
+	uint8_t buf[ZF_GZIDX_STAMP_SIZE];
+	off_t const offsets[2] = { 0, (st.st_size > ZF_GZIDX_STAMP_SIZE) ? st.st_size - ZF_GZIDX_STAMP_SIZE : 0 };
+	uint32_t crc = 0;
+	for(int i = 0; i < 2; i++) {
+		ssize_t read_size = pread(fd, buf, ZF_GZIDX_STAMP_SIZE, offsets[i]);
+		if(read_size < 0) { return(-1); }
+		crc = zf_gzeng_zlib_crc32(crc, buf, read_size);
+	}
+	stamp[0] = st.st_size;
+	stamp[1] = st.st_mtime;
+	stamp[2] = crc;
+	return(0);
+}
+
+/**
+ * @fn zf_gzidx_save
+ * @brief dump index; magic, stamp of the compressed file, span, count, then points
+ */
+static
+int zf_gzidx_save(
+	struct zf_gzidx_s const *idx,
+	char const *path,
+	uint64_t const stamp[3])
+{
+	FILE *fp = fopen(path, "wb");
+	if(fp == NULL) { return(-1); }
+
+	int ret = (fwrite(ZF_GZIDX_MAGIC, 1, 4, fp) == 4) ? 0 : -1;
+	for(int i = 0; i < 3; i++) {
+		ret |= zf_gzidx_put_u64(fp, stamp[i]);
+	}
+	ret |= zf_gzidx_put_u64(fp, idx->span);
+	ret |= zf_gzidx_put_u64(fp, idx->cnt);
+	for(uint64_t i = 0; i < idx->cnt; i++) {
+		struct zf_gzidx_point_s const *pt = &idx->pts[i];
+		ret |= zf_gzidx_put_u64(fp, pt->coffset);
+		ret |= zf_gzidx_put_u64(fp, pt->uoffset);
+		ret |= zf_gzidx_put_u64(fp, ((uint64_t)pt->wlen<<32) | pt->bits);
+		ret |= (fwrite(pt->window, 1, pt->wlen, fp) == pt->wlen) ? 0 : -1;
+	}
+	ret |= fclose(fp);
+
+	if(ret != 0) { remove(path); }
+	return(ret);
+}
+
+/**
+ * @fn zf_gzidx_load
+ * @brief returns NULL if the file does not exist or is not for the compressed file of the stamp
+ */
+static
+struct zf_gzidx_s *zf_gzidx_load(
+	char const *path,
+	uint64_t const stamp[3])
+{
+	FILE *fp = fopen(path, "rb");
+	if(fp == NULL) { return(NULL); }
+
+	char magic[4];
+	int err = (fread(magic, 1, 4, fp) != 4 || memcmp(magic, ZF_GZIDX_MAGIC, 4) != 0);
+	for(int i = 0; i < 3; i++) {
+		err |= (zf_gzidx_get_u64(fp, &err) != stamp[i]);
+	}
+	uint64_t span = zf_gzidx_get_u64(fp, &err);
+	uint64_t cnt = zf_gzidx_get_u64(fp, &err);
+
+	struct zf_gzidx_s *idx = (struct zf_gzidx_s *)calloc(1, sizeof(struct zf_gzidx_s));
+	struct zf_gzidx_point_s *pts = (struct zf_gzidx_point_s *)calloc(cnt + 1, sizeof(struct zf_gzidx_point_s));
+	if(err != 0 || idx == NULL || pts == NULL) {
+		free(idx); free(pts); fclose(fp);
+		return(NULL);
+	}
+	idx->span = span;
+	idx->loaded = 1;
+	idx->max = cnt + 1;
+	idx->pts = pts;
+
+	for(idx->cnt = 0; idx->cnt < cnt; idx->cnt++) {
+		struct zf_gzidx_point_s *pt = &idx->pts[idx->cnt];
+		pt->coffset = zf_gzidx_get_u64(fp, &err);
+		pt->uoffset = zf_gzidx_get_u64(fp, &err);
+		uint64_t w = zf_gzidx_get_u64(fp, &err);
+		pt->bits = w & 0x07;
+		pt->wlen = w>>32;
+		if(err != 0 || pt->wlen > ZF_GZIDX_WINDOW_SIZE || (pt->window = (uint8_t *)malloc(pt->wlen + 1)) == NULL) {
+			break;
+		}
+		if(fread(pt->window, 1, pt->wlen, fp) != pt->wlen) {
+			free(pt->window);
+			break;
+		}
+	}
+	fclose(fp);
+
+	if(idx->cnt != cnt) {
+		zf_gzidx_destroy(idx);
+		return(NULL);
+	}
+	return(idx);
+}
+
+/**
+ * @fn zf_gzidx_search
+ * @brief returns the last point at or before uoffset, NULL if none
+ */
+static
+struct zf_gzidx_point_s *zf_gzidx_search(
+	struct zf_gzidx_s *idx,
+	uint64_t uoffset)
+{
+	if(idx == NULL || idx->cnt == 0 || idx->pts[0].uoffset > uoffset) {
+		return(NULL);
+	}
+
+	/* binary search; pts[lb].uoffset <= uoffset < pts[ub].uoffset */
+	uint64_t lb = 0, ub = idx->cnt;
+	while(ub - lb > 1) {
+		uint64_t mid = (lb + ub) / 2;
+		if(idx->pts[mid].uoffset <= uoffset) {
+			lb = mid;
+		} else {
+			ub = mid;
+		}
+	}
+	return(&idx->pts[lb]);
+}
+
+/**
+ * @fn zf_gzr_add_point
+ * @brief record checkpoint if inflate stopped at a block boundary far enough from the last one
+ */
+static
+void zf_gzr_add_point(
+	struct zf_gzr_s *gz)
+{
+	struct zf_gzidx_s *idx = gz->idx;
+
+	/* at the end of a non-last block */
+	if((gz->zs.data_type & 128) == 0 || (gz->zs.data_type & 64) != 0) {
+		return;
+	}
+	uint64_t last = (idx->cnt == 0) ? 0 : idx->pts[idx->cnt - 1].uoffset;
+	if(gz->uoffset < last + idx->span) {
+		return;
+	}
+
+	if(idx->cnt == idx->max) {
+		uint64_t max = (idx->max == 0) ? 256 : 2 * idx->max;
+		struct zf_gzidx_point_s *pts = (struct zf_gzidx_point_s *)realloc(
+			idx->pts, max * sizeof(struct zf_gzidx_point_s));
+		if(pts == NULL) { return; }
+		idx->pts = pts;
+		idx->max = max;
+	}
+
+	struct zf_gzidx_point_s *pt = &idx->pts[idx->cnt];
+	if((pt->window = (uint8_t *)malloc(ZF_GZIDX_WINDOW_SIZE)) == NULL) {
+		return;
+	}
+	uInt wlen = 0;
+	inflateGetDictionary(&gz->zs, pt->window, &wlen);
+	pt->coffset = gz->src.base + gz->src.curr;
+	pt->uoffset = gz->uoffset;
+	pt->bits = gz->zs.data_type & 0x07;
+	pt->wlen = wlen;
+	idx->cnt++;
+	return;
+}
+
+/**
+ * @fn zf_bgzf_block_size
+ * @brief returns the size of the BGZF block at the head of src, 0 if not BGZF
+ */
+static
+size_t zf_bgzf_block_size(
+	struct zf_src_s *src)
+{
+	uint8_t const *p = zf_src_peek(src, 12);
+	if(p == NULL || p[0] != 0x1f || p[1] != 0x8b || p[2] != 0x08 || (p[3] & 0x04) == 0) {
+		return(0);
+	}
+
+	/* search `BC' in the extra subfields */
+	size_t xlen = p[10] | (p[11]<<8);
+	if((p = zf_src_peek(src, 12 + xlen)) == NULL) {
+		return(0);
+	}
+	for(size_t i = 12; i + 4 <= 12 + xlen; i += 4 + (p[i + 2] | (p[i + 3]<<8))) {
+		if(p[i] == 'B' && p[i + 1] == 'C' && (p[i + 2] | (p[i + 3]<<8)) == 2 && i + 6 <= 12 + xlen) {
+			return((p[i + 4] | (p[i + 5]<<8)) + 1);
+		}
+	}
+	return(0);
+}
+
+/**
+ * @fn zf_gzr_winit
+ */
+static
+void *zf_gzr_winit(
+	void *arg)
+{
+	struct zf_gzr_s *gz = (struct zf_gzr_s *)arg;
+	return((void *)zf_gzeng_ctx_init(gz->eng, 0, 0));
+}
+
+/**
+ * @fn zf_gzr_feed
+ * @brief cut a BGZF block out of the input
+ */
+static
+int zf_gzr_feed(
+	void *arg,
+	struct zf_mt_blk_s *blk)
+{
+	struct zf_gzr_s *gz = (struct zf_gzr_s *)arg;
+	if(zf_src_peek(&gz->src, 1) == NULL) {
+		return(0);					/* end of input */
+	}
+
+	size_t size = zf_bgzf_block_size(&gz->src);
+	uint8_t const *p = zf_src_peek(&gz->src, size);
+	if(size < 26 || size > blk->in_size || p == NULL) {
+		gz->err = 1;				/* broken or not a BGZF block */
+		return(-1);
+	}
+	memcpy(blk->in, p, size);
+	blk->in_len = size;
+	gz->src.curr += size;
+	return(1);
+}
+
+/**
+ * @fn zf_gzr_work
+ * @brief inflate a BGZF block, then verify crc and size
+ */
+static
+int zf_gzr_work(
+	void *arg,
+	void *wctx,
+	struct zf_mt_blk_s *blk)
+{
+	struct zf_gzeng_ctx_s *c = (struct zf_gzeng_ctx_s *)wctx;
+	if(c == NULL) { return(-1); }
+
+	uint8_t const *tail = &blk->in[blk->in_len - 8];
+	size_t xlen = blk->in[10] | (blk->in[11]<<8);
+	uint32_t crc = tail[0] | (tail[1]<<8) | (tail[2]<<16) | ((uint32_t)tail[3]<<24);
+	uint32_t isize = tail[4] | (tail[5]<<8) | (tail[6]<<16) | ((uint32_t)tail[7]<<24);
+	if(12 + xlen + 8 > blk->in_len || isize > blk->out_size) {
+		return(-1);
+	}
+
+	size_t used;
+	if(c->eng->inflate(c->ctx, blk->out, blk->out_size, &blk->out_len, &blk->in[12 + xlen], blk->in_len - 12 - xlen - 8, &used) != 0
+	|| blk->out_len != isize) {
+		return(-1);
+	}
+	return((c->eng->crc32(0, blk->out, isize) == crc) ? 0 : -1);
+}
+
+/**
+ * @fn zf_gzr_next_member
+ * @brief called at the end of a member; continue if the next member follows, trailing garbage is ignored
+ */
+static
+void zf_gzr_next_member(
+	struct zf_gzr_s *gz)
+{
+	if(gz->raw != 0) {
+		/* skip trailer (not verified when resumed from a checkpoint) */
+		if(zf_src_peek(&gz->src, 8) == NULL) {
+			gz->zs_end = 1;
+			return;
+		}
+		gz->src.curr += 8;
+	}
+
+	uint8_t const *p = zf_src_peek(&gz->src, 2);
+	if(p != NULL && p[0] == 0x1f && p[1] == 0x8b && gz->dctx != NULL) {
+		gz->eng->sdreset(gz->dctx);
+	} else if(p != NULL && p[0] == 0x1f && p[1] == 0x8b) {
+		inflateReset2(&gz->zs, 15 + 16);
+		gz->raw = 0;
+	} else {
+		gz->zs_end = 1;
+	}
+	return;
+}
+
+/**
+ * @fn zf_gzr_read_stream
+ * @brief zf_gzr_read_serial on the stream decompressor of the engine
+ */
+static
+size_t zf_gzr_read_stream(
+	struct zf_gzr_s *gz,
+	uint8_t *ptr,
+	size_t len)
+{
+	uint8_t const *p;
+	size_t copied_size = 0;
+	while(copied_size < len && gz->zs_end == 0 && (p = zf_src_peek(&gz->src, 1)) != NULL) {
+		size_t out_len, used;
+		int ret = gz->eng->sinflate(gz->dctx, &ptr[copied_size], len - copied_size, &out_len,
+			p, gz->src.end - gz->src.curr, &used);
+		gz->src.curr += used;
+		gz->uoffset += out_len;
+		copied_size += out_len;
+
+		if(ret == 1) {
+			zf_gzr_next_member(gz);
+		} else if(ret != 0) {
+			gz->err = gz->zs_end = 1;
+		}
+	}
+	return(copied_size);
+}
+
+/**
+ * @fn zf_gzr_read_serial
+ * @brief inflate non-BGZF gzip stream on the caller thread, concatenated members are also decoded
+ */
+static
+size_t zf_gzr_read_serial(
+	struct zf_gzr_s *gz,
+	uint8_t *ptr,
+	size_t len)
+{
+	uint8_t const *p;
+	gz->zs.next_out = ptr;
+	gz->zs.avail_out = len;
+	while(gz->zs.avail_out > 0 && gz->zs_end == 0 && (p = zf_src_peek(&gz->src, 1)) != NULL) {
+		uInt avail_out = gz->zs.avail_out;
+		gz->zs.next_in = (uint8_t *)p;
+		gz->zs.avail_in = gz->src.end - gz->src.curr;
+
+		/* stop at every block boundary when building index */
+		int building = (gz->idx != NULL && gz->idx->loaded == 0);
+		int ret = inflate(&gz->zs, building ? Z_BLOCK : Z_NO_FLUSH);
+		gz->src.curr = gz->src.end - gz->zs.avail_in;
+		gz->uoffset += avail_out - gz->zs.avail_out;
+
+		if(ret == Z_STREAM_END) {
+			zf_gzr_next_member(gz);
+		} else if(ret != Z_OK && ret != Z_BUF_ERROR) {
+			gz->err = gz->zs_end = 1;
+		} else if(building) {
+			zf_gzr_add_point(gz);
+		}
+	}
+	return(len - gz->zs.avail_out);
+}
+
+/**
+ * @fn zf_gz_get_u32
+ */
+static inline
+uint32_t zf_gz_get_u32(
+	uint8_t const *p)
+{
+	return(p[0] | (p[1]<<8) | (p[2]<<16) | ((uint32_t)p[3]<<24));
+}
+
+/**
+ * @fn zf_gz_header_size
+ * @brief returns the size of the gzip member header at p, 0 if broken or not gzip
+ */
+static
+size_t zf_gz_header_size(
+	uint8_t const *p,
+	size_t len)
+{
+	if(len < 10 || p[0] != 0x1f || p[1] != 0x8b || p[2] != 0x08 || (p[3] & 0xe0) != 0) {
+		return(0);
+	}
+
+	size_t pos = 10;
+	if((p[3] & 0x04) != 0) {		/* FEXTRA */
+		if(pos + 2 > len) { return(0); }
+		pos += 2 + (p[pos] | (p[pos + 1]<<8));
+	}
+	for(int flag = 0x08; flag <= 0x10; flag <<= 1) {
+		if((p[3] & flag) == 0) { continue; }
+		while(pos < len && p[pos] != '\0') { pos++; }
+		pos++;						/* FNAME and FCOMMENT, zero-terminated */
+	}
+	pos += ((p[3] & 0x02) != 0) ? 2 : 0;	/* FHCRC */
+	return((pos < len) ? pos : 0);
+}
+
+/**
+ * @fn zf_gzr_inflate_whole
+ * @brief inflate all the members of a small regular file at once; the file is mapped instead of read,
+ * and the output is sized from ISIZE of the last member if plausible. returns nonzero to fall back to the streaming
+ * reader, also if the output exceeds ZF_GZR_WHOLE_OUT_SIZE.
+ */
+static
+int zf_gzr_inflate_whole(
+	struct zf_gzr_s *gz,
+	struct zf_gzeng_s const *eng,
+	size_t size)
+{
+	uint8_t const *p = (uint8_t const *)mmap(NULL, size, PROT_READ, MAP_PRIVATE, gz->src.fd, 0);
+	if(p == MAP_FAILED) { return(-1); }
+	madvise((void *)p, size, MADV_SEQUENTIAL);
+
+	/* the tail is ISIZE only if no garbage follows the last member; taken if deflate can expand to it (1032 times at most) */
+	void *dctx = eng->dinit();
+	size_t cap = zf_gz_get_u32(&p[size - 4]);
+	cap = (cap <= 1032 * size) ? cap : 0;
+	size_t pos = 0, hlen;
+	size_t const extra = ZF_UNGETC_MARGIN_SIZE + ZF_BUF_PADDING;
+	int ret = (dctx == NULL) ? -1 : 0;
+
+	/* trailing garbage is ignored */
+	while(ret == 0 && (hlen = zf_gz_header_size(&p[pos], size - pos)) != 0) {
+		size_t olen, used;
+		do {
+			cap = (cap > gz->whole_len + 1) ? cap : 2 * gz->whole_len + ZF_BGZF_BLOCK_SIZE;
+			cap = (cap < ZF_GZR_WHOLE_OUT_SIZE) ? cap : ZF_GZR_WHOLE_OUT_SIZE;
+			if((ret == 1 && cap <= gz->whole_size - extra) || zf_mt_reserve(&gz->whole, &gz->whole_size, extra + cap) != 0) { ret = -1; break; }
+			size_t avail = ((gz->whole_size - extra < ZF_GZR_WHOLE_OUT_SIZE) ? gz->whole_size - extra : ZF_GZR_WHOLE_OUT_SIZE) - gz->whole_len;
+			ret = eng->inflate(dctx, &gz->whole[ZF_UNGETC_MARGIN_SIZE + gz->whole_len], avail, &olen,
+				&p[pos + hlen], size - pos - hlen, &used);
+			cap = 2 * (gz->whole_size - extra);	/* for retry */
+		} while(ret == 1);
+
+		/* verify trailer */
+		pos += hlen + used;
+		if(ret != 0 || pos + 8 > size
+		|| zf_gz_get_u32(&p[pos]) != eng->crc32(0, &gz->whole[ZF_UNGETC_MARGIN_SIZE + gz->whole_len], olen)
+		|| zf_gz_get_u32(&p[pos + 4]) != (uint32_t)olen) {
+			ret = -1;
+			break;
+		}
+		pos += 8;
+		gz->whole_len += olen;
+		cap = 0;
+	}
+
+	if(dctx != NULL) { eng->dclean(dctx); }
+	munmap((void *)p, size);
+	if(ret != 0 || pos == 0) {
+		free(gz->whole);
+		gz->whole = NULL;
+		gz->whole_len = gz->whole_size = 0;
+		return(-1);
+	}
+
+	/* release the excess if sized from garbage */
+	uint8_t *whole = (uint8_t *)realloc(gz->whole, extra + gz->whole_len);
+	if(whole != NULL) {
+		gz->whole = whole;
+		gz->whole_size = extra + gz->whole_len;
+	}
+	memset(&gz->whole[ZF_UNGETC_MARGIN_SIZE + gz->whole_len], 0, ZF_BUF_PADDING);
+	return(0);
+}
+
+/**
+ * @struct zf_gzsp_wctx_s
+ * @brief worker context of the speculative decoder; the two dummy windows map each window position k
+ * to byte pairs (k & 0xff, ((k>>8) + (k & 0xff) + 1) & 0xff), which never coincide, so a byte that differs
+ * between the two passes is a copy of the unknown window and the pair tells where it came from.
+ */
+struct zf_gzsp_wctx_s {
+	z_stream zs;
+	struct zf_mt_blk_s tmp;			/* output of the second pass */
+	uint8_t dict[2][ZF_GZIDX_WINDOW_SIZE];
+};
+
+/**
+ * @fn zf_gzsp_bits
+ * @brief peek n (<= 25) bits at bit offset pos; four bytes must be readable from pos / 8
+ */
+static inline
+uint32_t zf_gzsp_bits(
+	uint8_t const *p,
+	uint64_t pos,
+	int n)
+{
+	return((zf_gz_get_u32(&p[pos>>3])>>(pos & 7)) & ((1U<<n) - 1));
+}
+
+/**
+ * @fn zf_gzsp_is_dynamic
+ * @brief nonzero if a non-final block with dynamic Huffman codes starts at pos
+ */
+static inline
+int zf_gzsp_is_dynamic(
+	uint8_t const *p,
+	size_t size,
+	uint64_t pos)
+{
+	return((pos>>3) + 4 <= size && zf_gzsp_bits(p, pos, 3) == 0x04);
+}
+
+/**
+ * @fn zf_gzsp_is_member
+ * @brief nonzero if a gzip member seems to start at byte offset pos
+ */
+static inline
+int zf_gzsp_is_member(
+	uint8_t const *p,
+	size_t size,
+	size_t pos)
+{
+	size_t hlen = zf_gz_header_size(&p[pos], size - pos);
+	return(hlen != 0 && pos + hlen + 4 <= size && zf_gzsp_bits(p, 8 * (pos + hlen) + 1, 2) != 0x03);
+}
+
+/**
+ * @fn zf_gzsp_search
+ * @brief find the first position in [head, tail) that looks like the head of a member or the start of
+ * a non-final dynamic block; for the latter, the lengths of the code length codes must form a complete code,
+ * then the whole block header is decoded with zlib. returns UINT64_MAX if not found.
+ */
+static
+uint64_t zf_gzsp_search(
+	struct zf_gzr_s *gz,
+	z_stream *zs,
+	uint64_t head,
+	uint64_t tail)
+{
+	uint8_t const *p = gz->map;
+	size_t size = gz->map_size;
+	uint8_t scratch[1];
+
+	for(uint64_t pos = head; pos < tail && (pos>>3) + 16 <= size; pos++) {
+		if((pos & 7) == 0 && p[pos>>3] == 0x1f && zf_gzsp_is_member(p, size, pos>>3)) {
+			return(pos);
+		}
+		if(zf_gzsp_bits(p, pos, 3) != 0x04) { continue; }
+		uint32_t hlit = zf_gzsp_bits(p, pos + 3, 5), hdist = zf_gzsp_bits(p, pos + 8, 5);
+		uint32_t hclen = zf_gzsp_bits(p, pos + 13, 4) + 4;
+		if(hlit > 29 || hdist > 29) { continue; }
+
+		uint32_t kraft = 0;
+		for(uint32_t i = 0; i < hclen; i++) {
+			uint32_t len = zf_gzsp_bits(p, pos + 17 + 3 * i, 3);
+			kraft += (len != 0) ? 128>>len : 0;
+		}
+		if(kraft != 128) { continue; }
+
+		/* literal / length and distance codes */
+		inflateReset2(zs, -15);
+		if((pos & 7) != 0) { inflatePrime(zs, 8 - (pos & 7), p[pos>>3]>>(pos & 7)); }
+		zs->next_in = (Bytef *)&p[(pos + 7)>>3];
+		zs->avail_in = (size - ((pos + 7)>>3) < 1024) ? size - ((pos + 7)>>3) : 1024;
+		zs->next_out = scratch;
+		zs->avail_out = 1;
+		int ret = inflate(zs, Z_TREES);
+		if((ret == Z_OK || ret == Z_BUF_ERROR) && (zs->data_type & 256) != 0) {
+			return(pos);
+		}
+	}
+	return(UINT64_MAX);
+}
+
+/**
+ * @fn zf_gzsp_decode
+ * @brief inflate from bit offset aux[1] (the head of a member if aux[5] is set) until the first member or
+ * non-final dynamic block at or after `target'; members are decoded through, recording (output offset,
+ * crc | isize<<32) of their ends to blk->in. the end position is set to aux[2], and aux[3] tells what is there
+ * (0: a block, 1: the head of a member, 2: the end of the stream). decodes exactly `limit' bytes instead if limit is nonzero. dict is the preceding window.
+ */
+static
+int zf_gzsp_decode(
+	struct zf_gzr_s *gz,
+	z_stream *zs,
+	struct zf_mt_blk_s *blk,
+	uint64_t target,
+	uint8_t const *dict,
+	size_t dict_len,
+	size_t limit)
+{
+	uint8_t const *p = gz->map;
+	size_t size = gz->map_size;
+	uint64_t start = blk->aux[1];
+
+	blk->out_len = blk->in_len = 0;
+	blk->aux[3] = blk->aux[4] = 0;
+	if(blk->aux[5] != 0) {
+		/* member head */
+		size_t hlen = zf_gz_header_size(&p[start>>3], size - (start>>3));
+		if(hlen == 0) { return(-1); }
+		start += 8 * hlen;
+		dict_len = 0;
+	}
+	inflateReset2(zs, -15);
+	if((start & 7) != 0) { inflatePrime(zs, 8 - (start & 7), p[start>>3]>>(start & 7)); }
+	if(dict_len != 0) { inflateSetDictionary(zs, dict, dict_len); }
+	zs->next_in = (Bytef *)&p[(start + 7)>>3];
+	zs->avail_in = 0;
+
+	while(limit == 0 || blk->out_len < limit) {
+		if(zf_mt_reserve(&blk->out, &blk->out_size, blk->out_len + ZF_GZSP_OUT_MARGIN) != 0) { return(-1); }
+		size_t avail = blk->out_size - blk->out_len;
+		avail = (limit != 0 && limit - blk->out_len < avail) ? limit - blk->out_len : avail;
+		zs->next_out = &blk->out[blk->out_len];
+		zs->avail_out = (avail < 0x40000000) ? avail : 0x40000000;
+		if(zs->avail_in == 0) {
+			size_t rem = size - (zs->next_in - p);
+			if(rem == 0) { return(-1); }	/* truncated */
+			zs->avail_in = (rem < 0x40000000) ? rem : 0x40000000;
+		}
+
+		int ret = inflate(zs, Z_BLOCK);
+		blk->out_len = zs->next_out - blk->out;
+		if(ret == Z_STREAM_END) {
+			/* record the end of the member, then continue if the next member is found before target */
+			size_t tail = zs->next_in - p, hlen;
+			if(tail + 8 > size) { return(-1); }
+			if(limit == 0) {
+				uint64_t end[2] = { blk->out_len, zf_gz_get_u32(&p[tail]) | ((uint64_t)zf_gz_get_u32(&p[tail + 4])<<32) };
+				if(zf_mt_reserve(&blk->in, &blk->in_size, blk->in_len + sizeof(end)) != 0) { return(-1); }
+				memcpy(&blk->in[blk->in_len], end, sizeof(end));
+				blk->in_len += sizeof(end);
+				blk->aux[4]++;
+			}
+			blk->aux[2] = 8 * (uint64_t)(tail + 8);
+			if((hlen = zf_gz_header_size(&p[tail + 8], size - tail - 8)) == 0) {
+				blk->aux[3] = 2;	/* trailing garbage is ignored */
+				return(0);
+			}
+			if(blk->aux[2] >= target) {
+				blk->aux[3] = 1;
+				return(0);
+			}
+
+			inflateReset2(zs, -15);
+			zs->next_in = (Bytef *)&p[tail + 8 + hlen];
+			zs->avail_in = 0;
+			continue;
+		}
+		if(ret != Z_OK) { return(-1); }
+
+		uint64_t pos = 8 * (uint64_t)(zs->next_in - p) - (zs->data_type & 7);
+		if(limit == 0 && (zs->data_type & 192) == 128 && pos >= target && zf_gzsp_is_dynamic(p, size, pos)) {
+			blk->aux[2] = pos;
+			return(0);
+		}
+	}
+	return(0);
+}
+
+/**
+ * @fn zf_gzsp_winit
+ */
+static
+void *zf_gzsp_winit(
+	void *arg)
+{
+	struct zf_gzsp_wctx_s *w = (struct zf_gzsp_wctx_s *)calloc(1, sizeof(struct zf_gzsp_wctx_s));
+	if(w == NULL) { return(NULL); }
+	if(inflateInit2(&w->zs, -15) != Z_OK) {
+		free(w);
+		return(NULL);
+	}
+	for(uint32_t k = 0; k < ZF_GZIDX_WINDOW_SIZE; k++) {
+		w->dict[0][k] = k & 0xff;
+		w->dict[1][k] = ((k>>8) + (k & 0xff) + 1) & 0xff;
+	}
+	return((void *)w);
+}
+
+/**
+ * @fn zf_gzsp_wclean
+ */
+static
+void zf_gzsp_wclean(
+	void *wctx)
+{
+	struct zf_gzsp_wctx_s *w = (struct zf_gzsp_wctx_s *)wctx;
+	if(w == NULL) { return; }
+	inflateEnd(&w->zs);
+	free(w->tmp.in);
+	free(w->tmp.out);
+	free(w);
+	return;
+}
+
+/**
+ * @fn zf_gzsp_feed
+ * @brief push chunk indices; chunks are cut out by the workers
+ */
+static
+int zf_gzsp_feed(
+	void *arg,
+	struct zf_mt_blk_s *blk)
+{
+	struct zf_gzr_s *gz = (struct zf_gzr_s *)arg;
+	if(gz->spec_next * ZF_GZSP_CHUNK_SIZE >= gz->map_size) {
+		return(0);
+	}
+	blk->aux[0] = gz->spec_next++;
+	return(1);
+}
+
+/**
+ * @fn zf_gzsp_work
+ * @brief decode a chunk from the first member or block found in it; the window is unknown if started from
+ * a block, so the chunk is decoded twice with the dummy windows and the bytes copied from the window are
+ * recorded as markers (output position<<15 | window position) in blk->in, after the member ends.
+ * aux[0]: chunk index, aux[1]: start (UINT64_MAX if not found), aux[5]: started from a member head
+ */
+static
+int zf_gzsp_work(
+	void *arg,
+	void *wctx,
+	struct zf_mt_blk_s *blk)
+{
+	struct zf_gzr_s *gz = (struct zf_gzr_s *)arg;
+	struct zf_gzsp_wctx_s *w = (struct zf_gzsp_wctx_s *)wctx;
+	if(w == NULL) { return(-1); }
+
+	uint64_t head = 8 * blk->aux[0] * ZF_GZSP_CHUNK_SIZE;
+	uint64_t tail = head + 8 * ZF_GZSP_CHUNK_SIZE;
+	uint64_t start = (head == 0) ? 0 : zf_gzsp_search(gz, &w->zs, head, tail);
+	blk->aux[1] = start;
+	if(start == UINT64_MAX) {
+		return(0);
+	}
+	blk->aux[5] = ((start & 7) == 0 && gz->map[start>>3] == 0x1f && zf_gzsp_is_member(gz->map, gz->map_size, start>>3));
+	if(zf_gzsp_decode(gz, &w->zs, blk, tail, w->dict[0], ZF_GZIDX_WINDOW_SIZE, 0) != 0) {
+		return(-1);
+	}
+	if(blk->aux[5] != 0 || blk->out_len == 0) {
+		return(0);
+	}
+
+	/* second pass, up to the first member end (the window is reset there) */
+	size_t len = (blk->aux[4] != 0) ? *(uint64_t const *)blk->in : blk->out_len;
+	w->tmp.aux[1] = start;
+	w->tmp.aux[5] = 0;
+	if(len != 0 && (zf_gzsp_decode(gz, &w->zs, &w->tmp, tail, w->dict[1], ZF_GZIDX_WINDOW_SIZE, len) != 0 || w->tmp.out_len != len)) {
+		return(-1);
+	}
+	for(size_t j = 0; j < len; j++) {
+		if(blk->out[j] == w->tmp.out[j]) { continue; }
+
+		uint64_t l = blk->out[j], h = (w->tmp.out[j] - l - 1) & 0xff;
+		if(h >= (ZF_GZIDX_WINDOW_SIZE>>8) || zf_mt_reserve(&blk->in, &blk->in_size, blk->in_len + sizeof(uint64_t)) != 0) {
+			return(-1);
+		}
+		uint64_t marker = ((uint64_t)j<<15) | (h<<8) | l;
+		memcpy(&blk->in[blk->in_len], &marker, sizeof(uint64_t));
+		blk->in_len += sizeof(uint64_t);
+	}
+	return(0);
+}
+
+/**
+ * @fn zf_gzsp_start
+ * @brief (re)start decoding from the head of the file
+ */
+static
+int zf_gzsp_start(
+	struct zf_gzr_s *gz)
+{
+	gz->spec_next = 0;
+	gz->spec_exp = 0;
+	gz->spec_end = 1;
+	gz->crc = 0;
+	gz->isize = 0;
+	gz->wlen = 0;
+	gz->mt = zf_mt_init(gz->nth,
+		sizeof(uint64_t), ZF_GZSP_OUT_MARGIN,
+		(void *)gz,
+		zf_gzsp_winit, zf_gzsp_wclean, zf_gzsp_work, zf_gzsp_feed, NULL);
+	return((gz->mt != NULL) ? 0 : -1);
+}
+
+/**
+ * @fn zf_gzsp_stop
+ */
+static
+void zf_gzsp_stop(
+	struct zf_gzr_s *gz)
+{
+	if(gz->blk != NULL) {
+		zf_mt_release(gz->mt);
+		gz->blk = NULL;
+	}
+	zf_mt_destroy(gz->mt);
+	gz->mt = NULL;
+	gz->cur = NULL;
+	gz->cur_len = gz->pos = 0;
+	return;
+}
+
+/**
+ * @fn zf_gzsp_resolve
+ * @brief replace the markers with the bytes of the preceding window
+ */
+static
+int zf_gzsp_resolve(
+	struct zf_gzr_s *gz,
+	struct zf_mt_blk_s *blk)
+{
+	for(size_t j = 16 * blk->aux[4]; j < blk->in_len; j += sizeof(uint64_t)) {
+		uint64_t marker;
+		memcpy(&marker, &blk->in[j], sizeof(uint64_t));
+
+		size_t k = marker & (ZF_GZIDX_WINDOW_SIZE - 1);
+		if(k + gz->wlen < ZF_GZIDX_WINDOW_SIZE) {
+			return(-1);				/* refers before the head of the member */
+		}
+		blk->out[marker>>15] = gz->window[k + gz->wlen - ZF_GZIDX_WINDOW_SIZE];
+	}
+	return(0);
+}
+
+/**
+ * @fn zf_gzsp_update
+ * @brief accumulate crc and size, and slide the window
+ */
+static
+void zf_gzsp_update(
+	struct zf_gzr_s *gz,
+	uint8_t const *p,
+	size_t len)
+{
+	gz->crc = zf_gzeng_zlib_crc32(gz->crc, p, len);
+	gz->isize += len;
+
+	if(len >= ZF_GZIDX_WINDOW_SIZE) {
+		memcpy(gz->window, &p[len - ZF_GZIDX_WINDOW_SIZE], ZF_GZIDX_WINDOW_SIZE);
+		gz->wlen = ZF_GZIDX_WINDOW_SIZE;
+		return;
+	}
+	size_t keep = (gz->wlen + len <= ZF_GZIDX_WINDOW_SIZE) ? gz->wlen : ZF_GZIDX_WINDOW_SIZE - len;
+	memmove(gz->window, &gz->window[gz->wlen - keep], keep);
+	memcpy(&gz->window[keep], p, len);
+	gz->wlen = keep + len;
+	return;
+}
+
+/**
+ * @fn zf_gzsp_check
+ * @brief verify crc and size of the members ending in the chunk
+ */
+static
+int zf_gzsp_check(
+	struct zf_gzr_s *gz,
+	struct zf_mt_blk_s *blk)
+{
+	size_t prev = 0;
+	for(size_t j = 0; j < blk->aux[4]; j++) {
+		uint64_t end[2];
+		memcpy(end, &blk->in[16 * j], sizeof(end));
+		zf_gzsp_update(gz, &blk->out[prev], end[0] - prev);
+		if(gz->crc != (uint32_t)end[1] || (uint32_t)gz->isize != (end[1]>>32)) {
+			return(-1);
+		}
+		gz->crc = 0;
+		gz->isize = 0;
+		gz->wlen = 0;
+		prev = end[0];
+	}
+	zf_gzsp_update(gz, &blk->out[prev], blk->out_len - prev);
+	return(0);
+}
+
+/**
+ * @fn zf_gzsp_next
+ * @brief take the next chunk in order; it is used as is if it started where the previous one ended,
+ * otherwise the range is decoded again on the caller thread with the true window.
+ * returns nonzero at the end of input or on error.
+ */
+static
+int zf_gzsp_next(
+	struct zf_gzr_s *gz)
+{
+	if(gz->blk != NULL) {
+		zf_mt_release(gz->mt);
+		gz->blk = NULL;
+	}
+	gz->cur = NULL;
+	gz->cur_len = gz->pos = 0;
+	if(gz->err != 0 || gz->spec_end == 2) {
+		gz->zs_end = (gz->err == 0);
+		return(-1);
+	}
+
+	while(1) {
+		struct zf_mt_blk_s *blk = zf_mt_drain(gz->mt);
+		if(blk == NULL) {
+			gz->err = 1;			/* end of input before the end of stream */
+			return(-1);
+		}
+
+		/* skip if the range is already covered */
+		uint64_t tail = 8 * (blk->aux[0] + 1) * ZF_GZSP_CHUNK_SIZE;
+		if(tail <= gz->spec_exp) {
+			zf_mt_release(gz->mt);
+			continue;
+		}
+
+		int head = (gz->spec_end == 1);
+		if(blk->err == 0 && blk->aux[1] == gz->spec_exp && blk->aux[5] == (uint64_t)head && zf_gzsp_resolve(gz, blk) == 0) {
+			gz->blk = blk;
+		} else {
+			zf_mt_release(gz->mt);
+			gz->spec_redo++;
+			gz->blk = &gz->rep;
+			gz->rep.aux[1] = gz->spec_exp;
+			gz->rep.aux[5] = head;
+			if(zf_gzsp_decode(gz, &gz->zs, &gz->rep, tail, gz->window, gz->wlen, 0) != 0) {
+				gz->blk = NULL;
+				gz->err = 1;
+				return(-1);
+			}
+		}
+
+		gz->cur = gz->blk->out;
+		gz->cur_len = gz->blk->out_len;
+		gz->spec_exp = gz->blk->aux[2];
+		gz->spec_end = gz->blk->aux[3];
+		gz->err = zf_gzsp_check(gz, gz->blk);
+		if(gz->blk == &gz->rep) {
+			gz->blk = NULL;
+		}
+		return(0);
+	}
+}
+
+/**
+ * @fn zf_gzsp_read
+ */
+static
+size_t zf_gzsp_read(
+	struct zf_gzr_s *gz,
+	uint8_t *ptr,
+	size_t len)
+{
+	size_t copied_size = 0;
+	while(copied_size < len) {
+		if(gz->pos == gz->cur_len) {
+			if(zf_gzsp_next(gz) != 0) { break; }
+			continue;
+		}
+
+		size_t rem_size = gz->cur_len - gz->pos;
+		size_t copy_size = (len - copied_size < rem_size) ? len - copied_size : rem_size;
+		memcpy(ptr + copied_size, &gz->cur[gz->pos], copy_size);
+		gz->pos += copy_size;
+		copied_size += copy_size;
+	}
+	gz->uoffset += copied_size;
+	return(copied_size);
+}
+
+/**
+ * @fn zf_gzr_read
+ */
+static
+size_t zf_gzr_read(
+	void *fp,
+	void *_ptr,
+	size_t len)
+{
+	struct zf_gzr_s *gz = (struct zf_gzr_s *)fp;
+	uint8_t *ptr = (uint8_t *)_ptr;
+	size_t copied_size = 0;
+
+	if(gz->kind == ZF_GZR_SERIAL) {
+		return((gz->dctx != NULL) ? zf_gzr_read_stream(gz, ptr, len) : zf_gzr_read_serial(gz, ptr, len));
+	}
+
+	if(gz->kind == ZF_GZR_SPEC) {
+		return(zf_gzsp_read(gz, ptr, len));
+	}
+
+	if(gz->kind == ZF_GZR_WHOLE) {
+		size_t copy_size = (len < gz->whole_len - gz->pos) ? len : gz->whole_len - gz->pos;
+		memcpy(ptr, &gz->whole[ZF_UNGETC_MARGIN_SIZE + gz->pos], copy_size);
+		gz->pos += copy_size;
+		return(copy_size);
+	}
+
+	if(gz->kind == ZF_GZR_RAW) {
+		uint8_t const *p;
+		while(copied_size < len && (p = zf_src_peek(&gz->src, 1)) != NULL) {
+			size_t rem_size = gz->src.end - gz->src.curr;
+			size_t copy_size = (len - copied_size < rem_size) ? len - copied_size : rem_size;
+			memcpy(ptr + copied_size, p, copy_size);
+			gz->src.curr += copy_size;
+			copied_size += copy_size;
+		}
+		return(copied_size);
+	}
+
+	/* BGZF */
+	while(copied_size < len) {
+		if(gz->blk == NULL || gz->pos == gz->blk->out_len) {
+			/* fetch the next block */
+			if(gz->blk != NULL) {
+				zf_mt_release(gz->mt);
+			}
+			gz->pos = 0;
+			if((gz->blk = zf_mt_drain(gz->mt)) == NULL) {
+				break;
+			}
+			if(gz->blk->err != 0) {
+				gz->err = 1;
+				zf_mt_release(gz->mt); gz->blk = NULL;
+				break;
+			}
+			continue;
+		}
+
+		/* copy */
+		size_t rem_size = gz->blk->out_len - gz->pos;
+		size_t copy_size = (len - copied_size < rem_size) ? len - copied_size : rem_size;
+		memcpy(ptr + copied_size, &gz->blk->out[gz->pos], copy_size);
+		gz->pos += copy_size;
+		copied_size += copy_size;
+	}
+	return(copied_size);
+}
+
+/**
+ * @fn zf_gzr_seek
+ * @brief move to uoffset in the uncompressed stream; resumes from the nearest checkpoint if
+ * indexed, otherwise inflates from the current position or the head. BGZF is not supported here.
+ */
+static
+int zf_gzr_seek(
+	void *fp,
+	int64_t uoffset)
+{
+	struct zf_gzr_s *gz = (struct zf_gzr_s *)fp;
+
+	if(gz->kind == ZF_GZR_BGZF) {
+		return(-1);
+	}
+	if(gz->kind == ZF_GZR_WHOLE) {
+		if((uint64_t)uoffset > gz->whole_len) { return(-1); }
+		gz->pos = uoffset;
+		return(0);
+	}
+	if(gz->kind == ZF_GZR_RAW) {
+		struct stat st;
+		if(fstat(gz->src.fd, &st) != 0 || uoffset > st.st_size) { return(-1); }
+		if(lseek(gz->src.fd, uoffset, SEEK_SET) != uoffset) { return(-1); }
+		gz->src.curr = gz->src.end = 0;
+		gz->src.eof = 0;
+		gz->src.base = uoffset;
+		return(0);
+	}
+
+	/* speculative: restart from the head if backward */
+	if(gz->kind == ZF_GZR_SPEC && (gz->err != 0 || gz->uoffset > (uint64_t)uoffset)) {
+		zf_gzsp_stop(gz);
+		gz->broken |= gz->err;
+		gz->err = gz->zs_end = 0;
+		gz->uoffset = 0;
+		if(zf_gzsp_start(gz) != 0) { return(-1); }
+	}
+
+	/* resume from the checkpoint if the current position is not between the checkpoint and the target */
+	struct zf_gzidx_point_s const *pt = zf_gzidx_search(gz->idx, uoffset);
+	uint64_t start = (pt != NULL) ? pt->uoffset : 0;
+	if(gz->kind == ZF_GZR_SERIAL && (gz->err != 0 || gz->uoffset > (uint64_t)uoffset || gz->uoffset < start)) {
+		int64_t coffset = (pt != NULL) ? (int64_t)(pt->coffset - (pt->bits != 0)) : 0;
+		if(lseek(gz->src.fd, coffset, SEEK_SET) != coffset) { return(-1); }
+		gz->src.curr = gz->src.end = 0;
+		gz->src.eof = 0;
+		gz->src.base = coffset;
+
+		if(pt != NULL) {
+			inflateReset2(&gz->zs, -15);
+			if(pt->bits != 0) {
+				uint8_t const *p = zf_src_peek(&gz->src, 1);
+				if(p == NULL) { return(-1); }
+				inflatePrime(&gz->zs, pt->bits, p[0]>>(8 - pt->bits));
+				gz->src.curr++;
+			}
+			inflateSetDictionary(&gz->zs, pt->window, pt->wlen);
+		} else if(gz->dctx != NULL) {
+			gz->eng->sdreset(gz->dctx);
+		} else {
+			inflateReset2(&gz->zs, 15 + 16);
+		}
+		gz->raw = (pt != NULL);
+		gz->broken |= gz->err;
+		gz->err = gz->zs_end = 0;
+		gz->uoffset = start;
+	}
+
+	/* skip */
+	uint8_t *scratch = (uint8_t *)malloc(ZF_GZIDX_WINDOW_SIZE);
+	if(scratch == NULL) { return(-1); }
+	while(gz->uoffset < (uint64_t)uoffset) {
+		uint64_t skip_size = (uint64_t)uoffset - gz->uoffset;
+		skip_size = (skip_size < ZF_GZIDX_WINDOW_SIZE) ? skip_size : ZF_GZIDX_WINDOW_SIZE;
+		if(zf_gzr_read(gz, scratch, skip_size) == 0) { break; }
+	}
+	free(scratch);
+	return((gz->uoffset == (uint64_t)uoffset) ? 0 : -1);
+}
+
+/**
+ * @fn zf_gzr_map
+ * @brief the inflated content of a small file, served by zf without copying
+ */
+static
+uint8_t *zf_gzr_map(
+	struct zf_gzr_s *gz,
+	size_t *len)
+{
+	if(gz->kind != ZF_GZR_WHOLE) { return(NULL); }
+	*len = gz->whole_len;
+	return(&gz->whole[ZF_UNGETC_MARGIN_SIZE]);
+}
+
+/**
+ * @fn zf_gzr_close
+ * @brief the index is saved if built over the whole stream
+ */
+static
+int zf_gzr_close(
+	void *fp)
+{
+	struct zf_gzr_s *gz = (struct zf_gzr_s *)fp;
+	zf_mt_destroy(gz->mt);
+	if(gz->dctx != NULL) {
+		gz->eng->dclean(gz->dctx);
+	} else if(gz->kind == ZF_GZR_SERIAL || gz->kind == ZF_GZR_SPEC) {
+		inflateEnd(&gz->zs);
+	}
+	if(gz->map != NULL) {
+		munmap((void *)gz->map, gz->map_size);
+	}
+	free(gz->rep.in);
+	free(gz->rep.out);
+
+	if(gz->idx != NULL && gz->idx->loaded == 0 && gz->zs_end != 0 && gz->err == 0) {
+		uint64_t stamp[3];
+		if(zf_gzidx_stamp(gz->src.fd, stamp) == 0) {
+			zf_gzidx_save(gz->idx, gz->idx_path, stamp);
+		}
+	}
+	zf_gzidx_destroy(gz->idx);
+	free(gz->idx_path);
+	free(gz->whole);
+
+	/* broken or truncated input is reported here, as reads just end short */
+	int ret = close(gz->src.fd);
+	ret |= gz->err | gz->broken;
+	free(gz);
+	return(ret);
+}
+
+/**
+ * @fn zf_gzr_dopen
+ * @brief determine input kind from the first block
+ */
+static
+void *zf_gzr_dopen(
+	int fd,
+	char const *mode,
+	struct zf_params_s const *params)
+{
+	if(fd < 0) { return(NULL); }
+
+	struct zf_gzr_s *gz = (struct zf_gzr_s *)calloc(1, sizeof(struct zf_gzr_s));
+	if(gz == NULL) { return(NULL); }
+	zf_src_init(&gz->src, fd, params);
+	gz->src.base = lseek(fd, 0, SEEK_CUR);
+
+	/* small regular file from the head, without threads and random access index */
+	struct stat st;
+	if(params->nth == 0 && params->span == 0 && gz->src.base == 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode)
+	&& st.st_size >= 18 && st.st_size <= ZF_GZR_WHOLE_SIZE
+	&& zf_gzr_inflate_whole(gz, zf_gzeng_get(params->eng), st.st_size) == 0) {
+		gz->kind = ZF_GZR_WHOLE;
+		return((void *)gz);
+	}
+
+	uint8_t const *p = zf_src_peek(&gz->src, 2);
+	if(params->nth > 0 && zf_bgzf_block_size(&gz->src) != 0) {
+		gz->kind = ZF_GZR_BGZF;
+		gz->eng = zf_gzeng_get(params->eng);
+		gz->mt = zf_mt_init(params->nth,
+			ZF_BGZF_BLOCK_SIZE, ZF_BGZF_BLOCK_SIZE,
+			(void *)gz,
+			zf_gzr_winit, zf_gzeng_ctx_clean, zf_gzr_work, zf_gzr_feed, NULL);
+		if(gz->mt == NULL) { goto _zf_gzr_dopen_error; }
+	} else if(params->nth > 1 && params->span == 0 && gz->src.base == 0 && p != NULL && p[0] == 0x1f && p[1] == 0x8b
+	&& fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size >= 2 * ZF_GZSP_CHUNK_SIZE) {
+		/* two or more workers; slower than the serial reader on a single one */
+		gz->kind = ZF_GZR_SPEC;
+		gz->nth = params->nth;
+		gz->map_size = st.st_size;
+		if((gz->map = (uint8_t const *)mmap(NULL, gz->map_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+			gz->map = NULL;
+			goto _zf_gzr_dopen_error;
+		}
+		madvise((void *)gz->map, gz->map_size, MADV_SEQUENTIAL);
+		if(zf_gz_header_size(gz->map, gz->map_size) == 0 || inflateInit2(&gz->zs, -15) != Z_OK) { goto _zf_gzr_dopen_error; }
+		if(zf_gzsp_start(gz) != 0) { goto _zf_gzr_dopen_error; }
+	} else if(p != NULL && p[0] == 0x1f && p[1] == 0x8b) {
+		/* the index is built with zlib, which stops at the block boundaries */
+		gz->kind = ZF_GZR_SERIAL;
+		if(params->span == 0 && (gz->eng = zf_gzeng_get_stream(params->eng)) != NULL) {
+			if((gz->dctx = gz->eng->sdinit()) == NULL) { goto _zf_gzr_dopen_error; }
+		} else if(inflateInit2(&gz->zs, 15 + 16) != Z_OK) { goto _zf_gzr_dopen_error; }
+	} else {
+		gz->kind = ZF_GZR_RAW;
+	}
+
+	/* load or build index, only on regular files from the head */
+	if(gz->kind == ZF_GZR_SERIAL && params->span != 0 && params->path != NULL
+	&& gz->src.base == 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+		if((gz->idx_path = (char *)malloc(strlen(params->path) + strlen(".zfi") + 1)) == NULL) {
+			goto _zf_gzr_dopen_error;
+		}
+		strcpy(gz->idx_path, params->path);
+		strcat(gz->idx_path, ".zfi");
+
+		uint64_t stamp[3];
+		if(zf_gzidx_stamp(fd, stamp) != 0 || (gz->idx = zf_gzidx_load(gz->idx_path, stamp)) == NULL) {
+			gz->idx = (struct zf_gzidx_s *)calloc(1, sizeof(struct zf_gzidx_s));
+			if(gz->idx == NULL) { goto _zf_gzr_dopen_error; }
+			gz->idx->span = params->span;
+		}
+	}
+	return((void *)gz);
+
+_zf_gzr_dopen_error:;
+	zf_gzr_close((void *)gz);
+	return(NULL);
+}
+#endif /* HAVE_Z */
+
+/* parallel BGZF compressor (zlib-dependent) */
+#ifdef HAVE_Z
+#define ZF_BGZF_INPUT_SIZE			( 0xff00 )			/* same as bgzip */
+
+/**
+ * @struct zf_bgzfw_s
+ * @brief BGZF writer context
+ */
+struct zf_bgzfw_s {
+	int fd;
+	int level;
+	int err;
+	uint64_t coffset, uoffset;		/* compressed / uncompressed offsets of the next block */
+	struct zf_gzeng_s const *eng;
+	FILE *gzi;						/* index output, NULL if disabled */
+	uint64_t gzi_cnt;
+	struct zf_mt_s *mt;
+	struct zf_mt_blk_s *blk;
+};
+
+/**
+ * @fn zf_bgzfw_winit
+ */
+static
+void *zf_bgzfw_winit(
+	void *arg)
+{
+	struct zf_bgzfw_s *bgzf = (struct zf_bgzfw_s *)arg;
+	return((void *)zf_gzeng_ctx_init(bgzf->eng, 1, bgzf->level));
+}
+
+/**
+ * @fn zf_bgzfw_work
+ * @brief compress a block into a complete BGZF block
+ */
+static
+int zf_bgzfw_work(
+	void *arg,
+	void *wctx,
+	struct zf_mt_blk_s *blk)
+{
+	struct zf_gzeng_ctx_s *c = (struct zf_gzeng_ctx_s *)wctx;
+	if(c == NULL) { return(-1); }
+
+	size_t clen = c->eng->deflate(c->ctx, blk->out + 18, ZF_BGZF_BLOCK_SIZE - 26, blk->in, blk->in_len);
+	if(clen == 0) {
+		/* did not shrink; store as is (ZF_BGZF_INPUT_SIZE bytes always fit in a single stored block) */
+		uint8_t const stored[5] = { 0x01, blk->in_len, blk->in_len>>8, ~blk->in_len, ~blk->in_len>>8 };
+		memcpy(blk->out + 18, stored, 5);
+		memcpy(blk->out + 23, blk->in, blk->in_len);
+		clen = 5 + blk->in_len;
+	}
+
+	/* header and trailer */
+	size_t bsize = 18 + clen + 8 - 1;
+	uint32_t crc = c->eng->crc32(0, blk->in, blk->in_len);
+	uint8_t const head[18] = {
+		0x1f, 0x8b, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff,
+		0x06, 0x00, 'B', 'C', 0x02, 0x00, bsize, bsize>>8
+	};
+	uint8_t const tail[8] = {
+		crc, crc>>8, crc>>16, crc>>24,
+		blk->in_len, blk->in_len>>8, blk->in_len>>16, blk->in_len>>24
+	};
+	memcpy(blk->out, head, 18);
+	memcpy(blk->out + 18 + clen, tail, 8);
+	blk->out_len = bsize + 1;
+	return(0);
+}
+
+/**
+ * @fn zf_bgzfw_put_u64
+ * @brief write uint64_t in little endian to the index
+ */
+static
+int zf_bgzfw_put_u64(
+	FILE *fp,
+	uint64_t val)
+{
+	uint8_t b[8];
+	for(int i = 0; i < 8; i++) { b[i] = val>>(8 * i); }
+	return((fwrite(b, 1, 8, fp) == 8) ? 0 : -1);
+}
+
+/**
+ * @fn zf_bgzfw_emit
+ * @brief write block, then record the start of the next block to the index
+ */
+static
+int zf_bgzfw_emit(
+	void *arg,
+	struct zf_mt_blk_s *blk)
+{
+	struct zf_bgzfw_s *bgzf = (struct zf_bgzfw_s *)arg;
+	if(bgzf->err != 0 || blk->err != 0 || zf_write_all(bgzf->fd, blk->out, blk->out_len) != 0) {
+		zf_mt_flag(bgzf->mt, &bgzf->err, 1);
+		return(-1);
+	}
+	bgzf->coffset += blk->out_len;
+	bgzf->uoffset += blk->in_len;
+
+	if(bgzf->gzi != NULL) {
+		int err = zf_bgzfw_put_u64(bgzf->gzi, bgzf->coffset);
+		err |= zf_bgzfw_put_u64(bgzf->gzi, bgzf->uoffset);
+		zf_mt_flag(bgzf->mt, &bgzf->err, err);
+		bgzf->gzi_cnt++;
+	}
+	return(0);
+}
+
+/**
+ * @fn zf_bgzfw_write
+ */
+static
+size_t zf_bgzfw_write(
+	void *fp,
+	void *_ptr,
+	size_t len)
+{
+	struct zf_bgzfw_s *bgzf = (struct zf_bgzfw_s *)fp;
+	uint8_t const *ptr = (uint8_t const *)_ptr;
+	size_t copied_size = 0;
+
+	while(copied_size < len) {
+		if(bgzf->blk == NULL && (bgzf->blk = zf_mt_acquire(bgzf->mt)) == NULL) {
+			break;
+		}
+
+		/* copy */
+		size_t rem_size = ZF_BGZF_INPUT_SIZE - bgzf->blk->in_len;
+		size_t copy_size = (len - copied_size < rem_size) ? len - copied_size : rem_size;
+		memcpy(bgzf->blk->in + bgzf->blk->in_len, ptr + copied_size, copy_size);
+		bgzf->blk->in_len += copy_size;
+		copied_size += copy_size;
+
+		/* flush if full */
+		if(bgzf->blk->in_len == ZF_BGZF_INPUT_SIZE) {
+			zf_mt_push(bgzf->mt);
+			bgzf->blk = NULL;
+		}
+	}
+	return((zf_mt_flag(bgzf->mt, &bgzf->err, 0) == 0) ? copied_size : 0);
+}
+
+/**
+ * @fn zf_bgzfw_close
+ * @brief flush the last block, append EOF marker, then dump index
+ */
+static
+int zf_bgzfw_close(
+	void *fp)
+{
+	struct zf_bgzfw_s *bgzf = (struct zf_bgzfw_s *)fp;
+	if(bgzf->blk != NULL && bgzf->blk->in_len != 0) {
+		zf_mt_push(bgzf->mt);
+	}
+	zf_mt_destroy(bgzf->mt);
+
+	uint8_t const eof[28] = {
+		0x1f, 0x8b, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff,
+		0x06, 0x00, 'B', 'C', 0x02, 0x00, 0x1b, 0x00,
+		0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+	};
+	int ret = (bgzf->err == 0) ? zf_write_all(bgzf->fd, eof, 28) : -1;
+	ret |= close(bgzf->fd);
+
+	/* the number of entries is put at the head */
+	if(bgzf->gzi != NULL) {
+		if(fseek(bgzf->gzi, 0, SEEK_SET) != 0 || zf_bgzfw_put_u64(bgzf->gzi, bgzf->gzi_cnt) != 0) {
+			ret = -1;
+		}
+		ret |= fclose(bgzf->gzi);
+	}
+	free(bgzf);
+	return(ret);
+}
+
+/**
+ * @fn zf_bgzfw_dopen
+ */
+static
+void *zf_bgzfw_dopen(
+	int fd,
+	char const *mode,
+	struct zf_params_s const *params)
+{
+	if(fd < 0) { return(NULL); }
+
+	struct zf_bgzfw_s *bgzf = (struct zf_bgzfw_s *)calloc(1, sizeof(struct zf_bgzfw_s));
+	if(bgzf == NULL) { return(NULL); }
+	bgzf->fd = fd;
+	bgzf->eng = zf_gzeng_get(params->eng);
+	bgzf->level = zf_parse_level(mode, Z_DEFAULT_COMPRESSION, 0, (bgzf->eng == &zf_gzeng_table[ZF_GZENG_LIBDEFLATE]) ? 12 : 9);
+
+	bgzf->mt = zf_mt_init(params->nth,
+		ZF_BGZF_INPUT_SIZE, ZF_BGZF_BLOCK_SIZE,
+		(void *)bgzf,
+		zf_bgzfw_winit, zf_gzeng_ctx_clean, zf_bgzfw_work, NULL, zf_bgzfw_emit);
+	if(bgzf->mt == NULL) {
+		free(bgzf);
+		return(NULL);
+	}
+	return((void *)bgzf);
+}
+
+/**
+ * @fn zf_bgzfw_open
+ * @brief open BGZF file and its index (path + ".gzi") if "gzi" is in the params
+ */
+static
+void *zf_bgzfw_open(
+	char const *path,
+	char const *mode,
+	struct zf_params_s const *params)
+{
+	FILE *gzi = NULL;
+	if(params->gzi != 0) {
+		char *gzi_path = (char *)malloc(strlen(path) + strlen(".gzi") + 1);
+		if(gzi_path == NULL) { return(NULL); }
+		strcpy(gzi_path, path);
+		strcat(gzi_path, ".gzi");
+		gzi = fopen(gzi_path, "wb");
+		free(gzi_path);
+
+		/* reserve space for the number of entries */
+		if(gzi == NULL || zf_bgzfw_put_u64(gzi, 0) != 0) {
+			if(gzi != NULL) { fclose(gzi); }
+			return(NULL);
+		}
+	}
+
+	int fd = zf_open_fd(path, mode);
+	struct zf_bgzfw_s *bgzf = (struct zf_bgzfw_s *)zf_bgzfw_dopen(fd, mode, params);
+	if(bgzf == NULL) {
+		if(fd >= 0) { close(fd); }
+		if(gzi != NULL) { fclose(gzi); }
+		return(NULL);
+	}
+	bgzf->gzi = gzi;
+	return((void *)bgzf);
+}
+#endif /* HAVE_Z */
+
+/* bzip2 decompressor (bzip2-dependent) */
+#ifdef HAVE_BZ2
+#define ZF_BZ2R_OUT_SIZE			( 1024 * 1024 )		/* initial capacity, extended if a block is larger */
+#define ZF_BZ2R_MAX_BLOCK			( 4 * 1024 * 1024 )	/* upper bound of compressed block size, for merging candidates */
+#define ZF_BZ2R_BLOCK_MAGIC			( 0x314159265359ULL )	/* pi */
+#define ZF_BZ2R_EOS_MAGIC			( 0x177245385090ULL )	/* sqrt(pi) */
+#define ZF_BZ2R_MAGIC_MASK			( 0xffffffffffffULL )
+
+/**
+ * @struct zf_bz2r_s
+ * @brief bzip2 reader context; decoded on the caller thread if no worker thread is requested.
+ * in parallel mode, the feeder thread cuts the input at every block magic (found at any bit
+ * offset) and the workers decode the candidate blocks. the slots carry (bit offset of the head,
+ * bit length, block size digit, stored crc) in aux, and the end of a stream is pushed as an
+ * empty slot with the combined crc.
+ */
+struct zf_bz2r_s {
+	int err;
+	int serial;
+	int bs_live;					/* serial: bs is initialized */
+	bz_stream bs;
+	uint32_t crc;					/* combined crc of the blocks in the current stream */
+	struct zf_mt_s *mt;
+	struct zf_mt_blk_s *blk;		/* block being consumed, NULL if not drained or merged */
+	struct zf_mt_blk_s merged;		/* candidates concatenated on the caller thread */
+	uint8_t const *out;
+	size_t out_len, pos;
+	void *wctx;						/* for decoding merged blocks */
+
+	/* feeder states */
+	int feed_err;					/* read after the pool is finished */
+	int in_stream, level;
+	uint64_t head;					/* bit offset of the next magic */
+	uint64_t magic;
+	uint8_t filt[256];				/* possible values of the third byte of the magics */
+	struct zf_src_s src;
+};
+
+/**
+ * @struct zf_bz2r_wctx_s
+ * @brief scratch for building single-block stream
+ */
+struct zf_bz2r_wctx_s {
+	uint8_t *buf;
+	size_t size;
+};
+
+/**
+ * @fn zf_bz2r_get_bits
+ * @brief read up to 57 bits at a bit offset (msb first)
+ */
+static inline
+uint64_t zf_bz2r_get_bits(
+	uint8_t const *p,
+	uint64_t pos,
+	int len)
+{
+	uint64_t w = 0;
+	int n = ((pos & 0x07) + len + 7) / 8;		/* touches only the bytes containing the bits */
+	p += pos>>3;
+	for(int i = 0; i < n; i++) {
+		w = (w<<8) | p[i];
+	}
+	return((w>>(8 * n - (pos & 0x07) - len)) & ((0x01ULL<<len) - 1));
+}
+
+/**
+ * @fn zf_bz2r_winit
+ */
+static
+void *zf_bz2r_winit(
+	void *arg)
+{
+	return(calloc(1, sizeof(struct zf_bz2r_wctx_s)));
+}
+
+/**
+ * @fn zf_bz2r_wclean
+ */
+static
+void zf_bz2r_wclean(
+	void *wctx)
+{
+	if(wctx == NULL) { return; }
+	free(((struct zf_bz2r_wctx_s *)wctx)->buf);
+	free(wctx);
+	return;
+}
+
+/**
+ * @fn zf_bz2r_work
+ * @brief wrap the candidate block into a single-block stream and decode it. libbz2 verifies
+ * the block crc, and the combined crc (equal to the block crc for a single-block stream).
+ */
+static
+int zf_bz2r_work(
+	void *arg,
+	void *_wctx,
+	struct zf_mt_blk_s *blk)
+{
+	struct zf_bz2r_wctx_s *wctx = (struct zf_bz2r_wctx_s *)_wctx;
+	if(blk->in_len == 0) { return(0); }		/* end of stream */
+	if(wctx == NULL) { return(-1); }
+
+	/* "BZh" + level, the block, end-of-stream magic + combined crc, padding */
+	uint64_t shift = blk->aux[0] & 0x07, nbits = blk->aux[1];
+	if(zf_mt_reserve(&wctx->buf, &wctx->size, 4 + (nbits + 80 + 7) / 8 + 8) != 0) {
+		return(-1);
+	}
+	uint8_t *q = wctx->buf;
+	q[0] = 'B'; q[1] = 'Z'; q[2] = 'h'; q[3] = '0' + blk->aux[2];
+	q += 4;
+	for(uint64_t i = 0; i < nbits / 8; i++) {
+		*q++ = zf_bz2r_get_bits(blk->in, shift + 8 * i, 8);
+	}
+
+	/* the remaining bits are followed by the trailer, flushed through a 64-bit accumulator */
+	int acc_len = nbits & 0x07;
+	uint64_t acc = (acc_len != 0) ? zf_bz2r_get_bits(blk->in, shift + (nbits & ~0x07ULL), acc_len) : 0;
+	uint64_t const trailer[2] = { ZF_BZ2R_EOS_MAGIC, (uint32_t)blk->aux[3] };
+	int const trailer_len[2] = { 48, 32 };
+	for(int i = 0; i < 2; i++) {
+		acc = (acc<<trailer_len[i]) | trailer[i];
+		acc_len += trailer_len[i];
+		while(acc_len >= 8) {
+			*q++ = acc>>(acc_len - 8);
+			acc_len -= 8;
+		}
+	}
+	if(acc_len > 0) {
+		*q++ = acc<<(8 - acc_len);
+	}
+
+	/* decode */
+	bz_stream bs;
+	memset(&bs, 0, sizeof(bz_stream));
+	if(BZ2_bzDecompressInit(&bs, 0, 0) != BZ_OK) {
+		return(-1);
+	}
+	bs.next_in = (char *)wctx->buf;
+	bs.avail_in = q - wctx->buf;
+
+	int ret = BZ_OK;
+	blk->out_len = 0;
+	while(ret == BZ_OK) {
+		if(blk->out_len == blk->out_size && zf_mt_reserve(&blk->out, &blk->out_size, blk->out_size + 1) != 0) {
+			break;
+		}
+		bs.next_out = (char *)&blk->out[blk->out_len];
+		bs.avail_out = blk->out_size - blk->out_len;
+		ret = BZ2_bzDecompress(&bs);
+		blk->out_len = blk->out_size - bs.avail_out;
+		if(ret == BZ_OK && bs.avail_in == 0 && bs.avail_out != 0) {
+			break;					/* truncated */
+		}
+	}
+	BZ2_bzDecompressEnd(&bs);
+	return((ret == BZ_STREAM_END) ? 0 : -1);
+}
+
+/**
+ * @fn zf_bz2r_feed
+ * @brief cut the input at the next block or end-of-stream magic
+ */
+static
+int zf_bz2r_feed(
+	void *arg,
+	struct zf_mt_blk_s *blk)
+{
+	struct zf_bz2r_s *bz = (struct zf_bz2r_s *)arg;
+	struct zf_src_s *src = &bz->src;
+	uint8_t const *p;
+
+	if(bz->in_stream == 0) {
+		/* stream header; trailing garbage is ignored (same as bzip2) */
+		p = zf_src_peek(src, 10);
+		if(p == NULL || p[0] != 'B' || p[1] != 'Z' || p[2] != 'h' || p[3] < '1' || p[3] > '9') {
+			return(0);
+		}
+		bz->in_stream = 1;
+		bz->level = p[3] - '0';
+		bz->head = 8 * (src->base + src->curr + 4);
+		bz->magic = zf_bz2r_get_bits(p, 32, 48);
+		src->curr += 4;
+	}
+
+	blk->aux[0] = bz->head;
+	blk->aux[2] = bz->level;
+	if(bz->magic == ZF_BZ2R_EOS_MAGIC) {
+		/* end of stream: magic and combined crc, then padded to byte boundary */
+		if((p = zf_src_peek(src, 11)) == NULL) { goto _zf_bz2r_feed_error; }
+		blk->aux[1] = 0;
+		blk->aux[3] = zf_bz2r_get_bits(p, (bz->head & 0x07) + 48, 32);
+		src->curr += ((bz->head & 0x07) + 80 + 7) / 8;
+		bz->in_stream = 0;
+		return(1);
+	}
+	if(bz->magic != ZF_BZ2R_BLOCK_MAGIC || (p = zf_src_peek(src, 11)) == NULL) {
+		goto _zf_bz2r_feed_error;
+	}
+	blk->aux[3] = zf_bz2r_get_bits(p, (bz->head & 0x07) + 48, 32);
+
+	/* scan the next magic; src->curr is at the byte containing the head of the block */
+	uint64_t from = bz->head + 48;
+	while(1) {
+		if((p = zf_src_peek(src, 8)) == NULL) {
+			goto _zf_bz2r_feed_error;	/* end-of-stream magic not found */
+		}
+		size_t len = src->end - src->curr - 7;
+		uint64_t base = 8 * (src->base + src->curr);
+		for(size_t i = 0; i < len; i++) {
+			if(bz->filt[p[i + 2]] == 0) { continue; }
+
+			for(uint64_t s = 0; s < 8; s++) {
+				if(base + 8 * i + s < from) { continue; }
+				uint64_t magic = zf_bz2r_get_bits(p, 8 * i + s, 48);
+				if(magic != ZF_BZ2R_BLOCK_MAGIC && magic != ZF_BZ2R_EOS_MAGIC) { continue; }
+
+				/* found; the byte containing the next head is left in src */
+				if(zf_mt_append(blk, p, i + (s != 0)) != 0) { goto _zf_bz2r_feed_error; }
+				src->curr += i;
+				blk->aux[1] = base + 8 * i + s - bz->head;
+				bz->head = base + 8 * i + s;
+				bz->magic = magic;
+				return(1);
+			}
+		}
+		if(zf_mt_append(blk, p, len) != 0) { goto _zf_bz2r_feed_error; }
+		src->curr += len;
+	}
+
+_zf_bz2r_feed_error:;
+	bz->feed_err = 1;
+	return(-1);
+}
+
+/**
+ * @fn zf_bz2r_merge
+ * @brief the candidate failed to decode; it may be a block cut at a false magic in the
+ * compressed bits, so concatenate the following candidates and decode again on the caller thread.
+ */
+static
+int zf_bz2r_merge(
+	struct zf_bz2r_s *bz,
+	struct zf_mt_blk_s *blk)
+{
+	struct zf_mt_blk_s *m = &bz->merged;
+	m->in_len = 0;
+	memcpy(m->aux, blk->aux, sizeof(m->aux));
+	if(zf_mt_append(m, blk->in, blk->in_len) != 0) { return(-1); }
+	zf_mt_release(bz->mt);
+
+	while(m->aux[1] < 8ULL * ZF_BZ2R_MAX_BLOCK) {
+		if((blk = zf_mt_drain(bz->mt)) == NULL) { return(-1); }
+		if(blk->in_len == 0) {
+			zf_mt_release(bz->mt);
+			return(-1);				/* reached the end of stream */
+		}
+
+		/* the byte containing the boundary is taken from the latter */
+		m->in_len = (blk->aux[0]>>3) - (m->aux[0]>>3);
+		int ret = zf_mt_append(m, blk->in, blk->in_len);
+		m->aux[1] += blk->aux[1];
+		zf_mt_release(bz->mt);
+		if(ret != 0) { return(-1); }
+
+		if(zf_bz2r_work(NULL, bz->wctx, m) == 0) {
+			return(0);
+		}
+	}
+	return(-1);
+}
+
+/**
+ * @fn zf_bz2r_next
+ * @brief fetch the next decoded block, returns nonzero at the end of input or on error
+ */
+static
+int zf_bz2r_next(
+	struct zf_bz2r_s *bz)
+{
+	if(bz->blk != NULL) {
+		zf_mt_release(bz->mt);
+		bz->blk = NULL;
+	}
+	bz->out_len = bz->pos = 0;
+
+	while(bz->err == 0) {
+		struct zf_mt_blk_s *blk = zf_mt_drain(bz->mt);
+		if(blk == NULL) {
+			bz->err = bz->feed_err;		/* the feeder has finished if drain returned NULL */
+			break;
+		}
+
+		if(blk->in_len == 0) {
+			/* end of stream */
+			bz->err = (blk->aux[3] != bz->crc);
+			bz->crc = 0;
+			zf_mt_release(bz->mt);
+			continue;
+		}
+
+		if(blk->err == 0) {
+			bz->blk = blk;
+		} else if(zf_bz2r_merge(bz, blk) == 0) {
+			blk = &bz->merged;
+		} else {
+			bz->err = 1;
+			break;
+		}
+		bz->crc = ((bz->crc<<1) | (bz->crc>>31)) ^ (uint32_t)blk->aux[3];
+		bz->out = blk->out;
+		bz->out_len = blk->out_len;
+		return(0);
+	}
+	return(-1);
+}
+
+/**
+ * @fn zf_bz2r_read_serial
+ * @brief decode on the caller thread, concatenated streams are also decoded
+ */
+static
+size_t zf_bz2r_read_serial(
+	struct zf_bz2r_s *bz,
+	uint8_t *ptr,
+	size_t len)
+{
+	uint8_t const *p;
+	bz->bs.next_out = (char *)ptr;
+	bz->bs.avail_out = len;
+	while(bz->bs.avail_out > 0 && bz->bs_live != 0 && (p = zf_src_peek(&bz->src, 1)) != NULL) {
+		bz->bs.next_in = (char *)p;
+		bz->bs.avail_in = bz->src.end - bz->src.curr;
+		int ret = BZ2_bzDecompress(&bz->bs);
+		bz->src.curr = bz->src.end - bz->bs.avail_in;
+
+		if(ret == BZ_STREAM_END) {
+			/* continue if the next stream follows, trailing garbage is ignored */
+			BZ2_bzDecompressEnd(&bz->bs);
+			bz->bs_live = 0;
+			p = zf_src_peek(&bz->src, 4);
+			if(p != NULL && p[0] == 'B' && p[1] == 'Z' && p[2] == 'h') {
+				bz->bs_live = (BZ2_bzDecompressInit(&bz->bs, 0, 0) == BZ_OK);
+			}
+		} else if(ret != BZ_OK) {
+			bz->err = 1;
+			BZ2_bzDecompressEnd(&bz->bs);
+			bz->bs_live = 0;
+		}
+	}
+	return(len - bz->bs.avail_out);
+}
+
+/**
+ * @fn zf_bz2r_read
+ */
+static
+size_t zf_bz2r_read(
+	void *fp,
+	void *_ptr,
+	size_t len)
+{
+	struct zf_bz2r_s *bz = (struct zf_bz2r_s *)fp;
+	uint8_t *ptr = (uint8_t *)_ptr;
+	size_t copied_size = 0;
+
+	if(bz->serial != 0) {
+		return(zf_bz2r_read_serial(bz, ptr, len));
+	}
+
+	while(copied_size < len) {
+		if(bz->pos == bz->out_len) {
+			if(zf_bz2r_next(bz) != 0) { break; }
+			continue;
+		}
+
+		size_t rem_size = bz->out_len - bz->pos;
+		size_t copy_size = (len - copied_size < rem_size) ? len - copied_size : rem_size;
+		memcpy(ptr + copied_size, &bz->out[bz->pos], copy_size);
+		bz->pos += copy_size;
+		copied_size += copy_size;
+	}
+	return(copied_size);
+}
+
+/**
+ * @fn zf_bz2r_close
+ */
+static
+int zf_bz2r_close(
+	void *fp)
+{
+	struct zf_bz2r_s *bz = (struct zf_bz2r_s *)fp;
+	zf_mt_destroy(bz->mt);
+	if(bz->bs_live != 0) {
+		BZ2_bzDecompressEnd(&bz->bs);
+	}
+	zf_bz2r_wclean(bz->wctx);
+	free(bz->merged.in);
+	free(bz->merged.out);
+
+	int ret = close(bz->src.fd);
+	free(bz);
+	return(ret);
+}
+
+/**
+ * @fn zf_bz2r_dopen
+ * @brief parallel if the number of threads is specified
+ */
+static
+void *zf_bz2r_dopen(
+	int fd,
+	char const *mode,
+	struct zf_params_s const *params)
+{
+	if(fd < 0) { return(NULL); }
+
+	struct zf_bz2r_s *bz = (struct zf_bz2r_s *)calloc(1, sizeof(struct zf_bz2r_s));
+	if(bz == NULL) { return(NULL); }
+	zf_src_init(&bz->src, fd, params);
+	bz->src.base = lseek(fd, 0, SEEK_CUR);
+	bz->src.base = (bz->src.base < 0) ? 0 : bz->src.base;
+
+	/* bzip2 has no transparent mode */
+	uint8_t const *p = zf_src_peek(&bz->src, 4);
+	if(p == NULL || p[0] != 'B' || p[1] != 'Z' || p[2] != 'h') {
+		goto _zf_bz2r_dopen_error;
+	}
+
+	if(params->nth == 0) {
+		bz->serial = 1;
+		bz->bs_live = (BZ2_bzDecompressInit(&bz->bs, 0, 0) == BZ_OK);
+		if(bz->bs_live == 0) { goto _zf_bz2r_dopen_error; }
+		return((void *)bz);
+	}
+
+	/* the third byte of the magics at the bit offsets 0 to 7 */
+	for(int s = 0; s < 8; s++) {
+		bz->filt[(ZF_BZ2R_BLOCK_MAGIC>>(24 + s)) & 0xff] = 1;
+		bz->filt[(ZF_BZ2R_EOS_MAGIC>>(24 + s)) & 0xff] = 1;
+	}
+
+	if((bz->wctx = zf_bz2r_winit(NULL)) == NULL) { goto _zf_bz2r_dopen_error; }
+	bz->mt = zf_mt_init(params->nth,
+		ZF_BZ2R_OUT_SIZE, ZF_BZ2R_OUT_SIZE,
+		(void *)bz,
+		zf_bz2r_winit, zf_bz2r_wclean, zf_bz2r_work, zf_bz2r_feed, NULL);
+	if(bz->mt == NULL) { goto _zf_bz2r_dopen_error; }
+	return((void *)bz);
+
+_zf_bz2r_dopen_error:;
+	zf_bz2r_wclean(bz->wctx);
+	free(bz);
+	return(NULL);
+}
+#endif /* HAVE_BZ2 */
+
+/* parallel bzip2 compressor (bzip2-dependent) */
+#ifdef HAVE_BZ2
+/**
+ * @struct zf_pbz2w_s
+ * @brief parallel bzip2 writer context (same as pbzip2); input is split into chunks of
+ * the block size, each compressed into an independent stream, and the streams are concatenated.
+ */
+struct zf_pbz2w_s {
+	int fd;
+	int level;
+	int err;
+	size_t chunk_size;
+	struct zf_mt_s *mt;
+	struct zf_mt_blk_s *blk;		/* block being filled, NULL if not acquired */
+};
+
+/**
+ * @fn zf_pbz2w_work
+ */
+static
+int zf_pbz2w_work(
+	void *arg,
+	void *wctx,
+	struct zf_mt_blk_s *blk)
+{
+	struct zf_pbz2w_s *pbz = (struct zf_pbz2w_s *)arg;
+	unsigned int out_len = blk->out_size;
+	int ret = BZ2_bzBuffToBuffCompress((char *)blk->out, &out_len,
+		(char *)blk->in, blk->in_len, pbz->level, 0, 0);
+	blk->out_len = out_len;
+	return((ret == BZ_OK) ? 0 : -1);
+}
+
+/**
+ * @fn zf_pbz2w_emit
+ */
+static
+int zf_pbz2w_emit(
+	void *arg,
+	struct zf_mt_blk_s *blk)
+{
+	struct zf_pbz2w_s *pbz = (struct zf_pbz2w_s *)arg;
+	if(pbz->err != 0 || blk->err != 0 || zf_write_all(pbz->fd, blk->out, blk->out_len) != 0) {
+		zf_mt_flag(pbz->mt, &pbz->err, 1);
+		return(-1);
+	}
+	return(0);
+}
+
+/**
+ * @fn zf_pbz2w_write
+ */
+static
+size_t zf_pbz2w_write(
+	void *fp,
+	void *_ptr,
+	size_t len)
+{
+	struct zf_pbz2w_s *pbz = (struct zf_pbz2w_s *)fp;
+	uint8_t const *ptr = (uint8_t const *)_ptr;
+	size_t copied_size = 0;
+
+	while(copied_size < len) {
+		if(pbz->blk == NULL && (pbz->blk = zf_mt_acquire(pbz->mt)) == NULL) {
+			break;
+		}
+
+		/* copy */
+		size_t rem_size = pbz->chunk_size - pbz->blk->in_len;
+		size_t copy_size = (len - copied_size < rem_size) ? len - copied_size : rem_size;
+		memcpy(pbz->blk->in + pbz->blk->in_len, ptr + copied_size, copy_size);
+		pbz->blk->in_len += copy_size;
+		copied_size += copy_size;
+
+		/* flush if full */
+		if(pbz->blk->in_len == pbz->chunk_size) {
+			zf_mt_push(pbz->mt);
+			pbz->blk = NULL;
+		}
+	}
+	return((zf_mt_flag(pbz->mt, &pbz->err, 0) == 0) ? copied_size : 0);
+}
+
+/**
+ * @fn zf_pbz2w_close
+ */
+static
+int zf_pbz2w_close(
+	void *fp)
+{
+	struct zf_pbz2w_s *pbz = (struct zf_pbz2w_s *)fp;
+	if(pbz->blk != NULL && pbz->blk->in_len != 0) {
+		zf_mt_push(pbz->mt);
+	}
+	zf_mt_destroy(pbz->mt);			/* drains all the blocks */
+
+	int ret = (pbz->err == 0) ? 0 : -1;
+	ret |= close(pbz->fd);
+	free(pbz);
+	return(ret);
+}
+
+/**
+ * @fn zf_pbz2w_dopen
+ */
+static
+void *zf_pbz2w_dopen(
+	int fd,
+	char const *mode,
+	struct zf_params_s const *params)
+{
+	if(fd < 0) { return(NULL); }
+
+	struct zf_pbz2w_s *pbz = (struct zf_pbz2w_s *)calloc(1, sizeof(struct zf_pbz2w_s));
+	if(pbz == NULL) { return(NULL); }
+	pbz->fd = fd;
+	pbz->level = zf_parse_level(mode, 9, 1, 9);
+	pbz->chunk_size = 100000 * pbz->level;
+
+	/* output size bound from the bzip2 manual (1% + 600 bytes) */
+	pbz->mt = zf_mt_init(params->nth,
+		pbz->chunk_size, pbz->chunk_size + pbz->chunk_size / 100 + 600,
+		(void *)pbz,
+		NULL, NULL, zf_pbz2w_work, NULL, zf_pbz2w_emit);
+	if(pbz->mt == NULL) {
+		free(pbz);
+		return(NULL);
+	}
+	return((void *)pbz);
+}
+
+/**
+ * @fn zf_pbz2w_open
+ */
+static
+void *zf_pbz2w_open(
+	char const *path,
+	char const *mode,
+	struct zf_params_s const *params)
+{
+	int fd = zf_open_fd(path, mode);
+	void *fp = zf_pbz2w_dopen(fd, mode, params);
+	if(fp == NULL && fd >= 0) { close(fd); }
+	return(fp);
+}
+
+/**
+ * @fn zf_bz2w_close
+ * @brief wrap BZ2_bzclose, which returns nothing
+ */
+static
+int zf_bz2w_close(
+	void *fp)
+{
+	BZ2_bzclose((BZFILE *)fp);
+	return(0);
+}
+#endif /* HAVE_BZ2 */
+
+/* zstd decompressor (zstd-dependent) */
+#ifdef HAVE_ZSTD
+#define ZF_ZST_BLOCK_SIZE			( 1024 * 1024 )		/* initial capacity, extended if a frame is larger */
+#define ZF_ZST_SEEKABLE_MAGIC		( 0x8f92eab1 )		/* seekable format, at the tail of the seek table */
+#define ZF_ZST_SEEKTABLE_MAGIC		( 0x184d2a5e )		/* skippable frame containing the seek table */
+#define ZF_ZST_SEEKABLE_MAX_FRAME	( 1024 * 1024 * 1024 )	/* max decompressed size of a frame (1GB) */
+
+/**
+ * @struct zf_zstr_s
+ * @brief zstd reader context; decoded on the caller thread if no worker thread is requested
+ * or the first frame is larger than the input buffer, otherwise frames are cut out on the
+ * feeder thread and decoded on the workers (e.g. files by pzstd or the seekable format).
+ * random access is available if the seek table of the seekable format is found.
+ */
+struct zf_zstr_s {
+	int err;
+	int feed_err;					/* read after the pool is finished */
+	int wlog;						/* maximum window size in log2, 0 for the default */
+	int nth;
+	uint64_t nfr;					/* seekable format: number of frames, 0 if the seek table is not found */
+	uint64_t *coff, *uoff;			/* seekable format: compressed / decompressed offsets of the frames (nfr + 1 each) */
+	ZSTD_DCtx *dctx;				/* serial */
+	struct zf_mt_s *mt;
+	struct zf_mt_blk_s *blk;		/* block being consumed, NULL if not drained */
+	size_t pos;
+	struct zf_src_s src;
+};
+
+/**
+ * @fn zf_zstr_get_u32
+ */
+static inline
+uint32_t zf_zstr_get_u32(
+	uint8_t const *p)
+{
+	return(p[0] | (p[1]<<8) | (p[2]<<16) | ((uint32_t)p[3]<<24));
+}
+
+/**
+ * @fn zf_zstr_winit
+ */
+static
+void *zf_zstr_winit(
+	void *arg)
+{
+	struct zf_zstr_s *zst = (struct zf_zstr_s *)arg;
+	ZSTD_DCtx *dctx = ZSTD_createDCtx();
+	if(dctx != NULL && zst->wlog != 0) {
+		ZSTD_DCtx_setParameter(dctx, ZSTD_d_windowLogMax, zst->wlog);
+	}
+	return((void *)dctx);
+}
+
+/**
+ * @fn zf_zstr_wclean
+ */
+static
+void zf_zstr_wclean(
+	void *wctx)
+{
+	ZSTD_freeDCtx((ZSTD_DCtx *)wctx);
+	return;
+}
+
+/**
+ * @fn zf_zstr_skip
+ * @brief advance src by len bytes, returns nonzero if the input ended
+ */
+static
+int zf_zstr_skip(
+	struct zf_src_s *src,
+	uint64_t len)
+{
+	while(len > 0) {
+		if(zf_src_peek(src, 1) == NULL) { return(-1); }
+		size_t skip_size = (src->end - src->curr < len) ? src->end - src->curr : len;
+		src->curr += skip_size;
+		len -= skip_size;
+	}
+	return(0);
+}
+
+/**
+ * @fn zf_zstr_feed
+ * @brief cut a frame out of the input, walking the block headers; skippable frames are dropped
+ */
+static
+int zf_zstr_feed(
+	void *arg,
+	struct zf_mt_blk_s *blk)
+{
+	struct zf_zstr_s *zst = (struct zf_zstr_s *)arg;
+	struct zf_src_s *src = &zst->src;
+	uint8_t const *p;
+
+	while(1) {
+		if(zf_src_peek(src, 1) == NULL) {
+			return(0);				/* end of input */
+		}
+		if((p = zf_src_peek(src, 8)) == NULL) { goto _zf_zstr_feed_error; }
+		if((zf_zstr_get_u32(p) & ZSTD_MAGIC_SKIPPABLE_MASK) != ZSTD_MAGIC_SKIPPABLE_START) { break; }
+		if(zf_zstr_skip(src, 8 + (uint64_t)zf_zstr_get_u32(p + 4)) != 0) { goto _zf_zstr_feed_error; }
+	}
+
+	/* frame header: magic, descriptor, window descriptor, dictionary id, and content size */
+	if(zf_zstr_get_u32(p) != ZSTD_MAGICNUMBER) { goto _zf_zstr_feed_error; }
+	uint8_t const fhd = p[4];
+	uint8_t const dict_size[4] = { 0, 1, 2, 4 }, fcs_size[4] = { 0, 2, 4, 8 };
+	int single = (fhd>>5) & 0x01;
+	size_t hsize = 5 + (single == 0) + dict_size[fhd & 0x03] + fcs_size[fhd>>6] + (single != 0 && (fhd>>6) == 0);
+	if((p = zf_src_peek(src, hsize)) == NULL || zf_mt_append(blk, p, hsize) != 0) {
+		goto _zf_zstr_feed_error;
+	}
+	int checksum = (fhd & 0x04) != 0;
+	src->curr += hsize;
+
+	/* blocks */
+	int last = 0;
+	while(last == 0) {
+		if((p = zf_src_peek(src, 3)) == NULL) { goto _zf_zstr_feed_error; }
+		uint32_t head = p[0] | (p[1]<<8) | (p[2]<<16);
+		uint32_t type = (head>>1) & 0x03;
+		size_t size = 3 + ((type == 1) ? 1 : (head>>3));	/* RLE block has a byte */
+		last = head & 0x01;
+		if(type == 3 || (p = zf_src_peek(src, size)) == NULL || zf_mt_append(blk, p, size) != 0) {
+			goto _zf_zstr_feed_error;
+		}
+		src->curr += size;
+	}
+
+	/* content checksum */
+	if(checksum != 0) {
+		if((p = zf_src_peek(src, 4)) == NULL || zf_mt_append(blk, p, 4) != 0) {
+			goto _zf_zstr_feed_error;
+		}
+		src->curr += 4;
+	}
+	return(1);
+
+_zf_zstr_feed_error:;
+	zst->feed_err = 1;
+	return(-1);
+}
+
+/**
+ * @fn zf_zstr_work
+ * @brief decode a frame, the output buffer is extended if the frame is larger
+ */
+static
+int zf_zstr_work(
+	void *arg,
+	void *wctx,
+	struct zf_mt_blk_s *blk)
+{
+	ZSTD_DCtx *dctx = (ZSTD_DCtx *)wctx;
+	if(dctx == NULL) { return(-1); }
+
+	ZSTD_DCtx_reset(dctx, ZSTD_reset_session_only);
+	ZSTD_inBuffer in = { blk->in, blk->in_len, 0 };
+	size_t ret = 1;
+	while(ret != 0) {
+		if(blk->out_len == blk->out_size && zf_mt_reserve(&blk->out, &blk->out_size, blk->out_size + 1) != 0) {
+			return(-1);
+		}
+		ZSTD_outBuffer out = { blk->out, blk->out_size, blk->out_len };
+		ret = ZSTD_decompressStream(dctx, &out, &in);
+		blk->out_len = out.pos;
+		if(ZSTD_isError(ret) || (ret != 0 && in.pos == in.size && out.pos < out.size)) {
+			return(-1);				/* broken or truncated */
+		}
+	}
+	return(0);
+}
+
+/**
+ * @fn zf_zstr_read_serial
+ */
+static
+size_t zf_zstr_read_serial(
+	struct zf_zstr_s *zst,
+	uint8_t *ptr,
+	size_t len)
+{
+	ZSTD_outBuffer out = { ptr, len, 0 };
+	while(out.pos < out.size && zst->err == 0) {
+		/* the decoder may hold decoded bytes after the input ended */
+		uint8_t const *p = zf_src_peek(&zst->src, 1);
+		ZSTD_inBuffer in = { p, (p != NULL) ? zst->src.end - zst->src.curr : 0, 0 };
+		size_t prev_pos = out.pos;
+		size_t ret = ZSTD_decompressStream(zst->dctx, &out, &in);
+		zst->src.curr += in.pos;
+
+		if(ZSTD_isError(ret)) {
+			zst->err = 1;
+		} else if(p == NULL && out.pos == prev_pos) {
+			zst->err = (ret != 0);	/* truncated in the middle of a frame */
+			break;
+		}
+	}
+	return(out.pos);
+}
+
+/**
+ * @fn zf_zstr_read
+ */
+static
+size_t zf_zstr_read(
+	void *fp,
+	void *_ptr,
+	size_t len)
+{
+	struct zf_zstr_s *zst = (struct zf_zstr_s *)fp;
+	uint8_t *ptr = (uint8_t *)_ptr;
+	size_t copied_size = 0;
+
+	if(zst->mt == NULL) {
+		return(zf_zstr_read_serial(zst, ptr, len));
+	}
+
+	while(copied_size < len) {
+		if(zst->blk == NULL || zst->pos == zst->blk->out_len) {
+			/* fetch the next block */
+			if(zst->blk != NULL) {
+				zf_mt_release(zst->mt);
+			}
+			zst->pos = 0;
+			if((zst->blk = zf_mt_drain(zst->mt)) == NULL) {
+				zst->err |= zst->feed_err;
+				break;
+			}
+			if(zst->blk->err != 0) {
+				zst->err = 1;
+				zf_mt_release(zst->mt); zst->blk = NULL;
+				break;
+			}
+			continue;
+		}
+
+		/* copy */
+		size_t rem_size = zst->blk->out_len - zst->pos;
+		size_t copy_size = (len - copied_size < rem_size) ? len - copied_size : rem_size;
+		memcpy(ptr + copied_size, &zst->blk->out[zst->pos], copy_size);
+		zst->pos += copy_size;
+		copied_size += copy_size;
+	}
+	return(copied_size);
+}
+
+/**
+ * @fn zf_zstr_load_seektable
+ * @brief load the seek table of the seekable format at the tail of the file, without moving the file pointer
+ */
+static
+int zf_zstr_load_seektable(
+	struct zf_zstr_s *zst)
+{
+	struct stat st;
+	uint8_t foot[9];
+	if(fstat(zst->src.fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size < 17
+	|| pread(zst->src.fd, foot, 9, st.st_size - 9) != 9
+	|| zf_zstr_get_u32(foot + 5) != ZF_ZST_SEEKABLE_MAGIC || (foot[4] & 0x7c) != 0) {
+		return(-1);
+	}
+
+	/* entries: compressed size, decompressed size, and checksum (if the descriptor has 0x80) */
+	uint64_t nfr = zf_zstr_get_u32(foot), esize = (foot[4] & 0x80) ? 12 : 8;
+	uint64_t tsize = 8 + nfr * esize + 9;
+	if(tsize > (uint64_t)st.st_size) { return(-1); }
+
+	uint8_t *tbl = (uint8_t *)malloc(tsize);
+	zst->coff = (uint64_t *)malloc(sizeof(uint64_t) * (nfr + 1));
+	zst->uoff = (uint64_t *)malloc(sizeof(uint64_t) * (nfr + 1));
+	if(tbl == NULL || zst->coff == NULL || zst->uoff == NULL
+	|| pread(zst->src.fd, tbl, tsize, st.st_size - tsize) != (ssize_t)tsize
+	|| zf_zstr_get_u32(tbl) != ZF_ZST_SEEKTABLE_MAGIC || zf_zstr_get_u32(tbl + 4) != tsize - 8) {
+		goto _zf_zstr_load_seektable_error;
+	}
+
+	zst->coff[0] = zst->uoff[0] = 0;
+	for(uint64_t i = 0; i < nfr; i++) {
+		zst->coff[i + 1] = zst->coff[i] + zf_zstr_get_u32(tbl + 8 + i * esize);
+		zst->uoff[i + 1] = zst->uoff[i] + zf_zstr_get_u32(tbl + 8 + i * esize + 4);
+	}
+	if(zst->coff[nfr] + tsize != (uint64_t)st.st_size) {
+		goto _zf_zstr_load_seektable_error;		/* other frames are in the file */
+	}
+	free(tbl);
+	zst->nfr = nfr;
+	return(0);
+
+_zf_zstr_load_seektable_error:;
+	free(tbl);
+	free(zst->coff); zst->coff = NULL;
+	free(zst->uoff); zst->uoff = NULL;
+	return(-1);
+}
+
+/**
+ * @fn zf_zstr_start
+ * @brief (re)start decoding at the current position of src
+ */
+static
+int zf_zstr_start(
+	struct zf_zstr_s *zst)
+{
+	zst->err = zst->feed_err = 0;
+	if(zst->nth > 0) {
+		zst->mt = zf_mt_init(zst->nth,
+			ZF_ZST_BLOCK_SIZE, ZF_ZST_BLOCK_SIZE,
+			(void *)zst,
+			zf_zstr_winit, zf_zstr_wclean, zf_zstr_work, zf_zstr_feed, NULL);
+		return((zst->mt != NULL) ? 0 : -1);
+	}
+
+	if(zst->dctx == NULL) {
+		zst->dctx = (ZSTD_DCtx *)zf_zstr_winit((void *)zst);
+	}
+	return((zst->dctx != NULL) ? 0 : -1);
+}
+
+/**
+ * @fn zf_zstr_seek
+ * @brief binary search the frame in the seek table, then decode from the head of the frame
+ */
+static
+int zf_zstr_seek(
+	void *fp,
+	int64_t uoffset)
+{
+	struct zf_zstr_s *zst = (struct zf_zstr_s *)fp;
+	if(zst->nfr == 0 || (uint64_t)uoffset > zst->uoff[zst->nfr]) {
+		return(-1);
+	}
+
+	/* the last frame starting at or before uoffset */
+	uint64_t lb = 0, ub = zst->nfr;
+	while(ub - lb > 1) {
+		uint64_t mid = (lb + ub) / 2;
+		if(zst->uoff[mid] <= (uint64_t)uoffset) { lb = mid; } else { ub = mid; }
+	}
+
+	/* stop the workers, then restart from the frame */
+	zf_mt_destroy(zst->mt);
+	zst->mt = NULL;
+	zst->blk = NULL;
+	zst->pos = 0;
+	if(lseek(zst->src.fd, zst->coff[lb], SEEK_SET) != (off_t)zst->coff[lb]) { return(-1); }
+	zst->src.curr = zst->src.end = 0;
+	zst->src.eof = 0;
+	zst->src.base = zst->coff[lb];
+	if(zst->dctx != NULL) {
+		ZSTD_DCtx_reset(zst->dctx, ZSTD_reset_session_only);
+	}
+	if(zf_zstr_start(zst) != 0) {
+		zst->err = 1;
+		return(-1);
+	}
+
+	/* skip in the frame */
+	uint8_t buf[4096];
+	uint64_t rem = uoffset - zst->uoff[lb];
+	while(rem > 0) {
+		size_t read_size = zf_zstr_read(fp, buf, (rem < 4096) ? rem : 4096);
+		if(read_size == 0) { return(-1); }
+		rem -= read_size;
+	}
+	return(0);
+}
+
+/**
+ * @fn zf_zstr_close
+ */
+static
+int zf_zstr_close(
+	void *fp)
+{
+	struct zf_zstr_s *zst = (struct zf_zstr_s *)fp;
+	zf_mt_destroy(zst->mt);
+	ZSTD_freeDCtx(zst->dctx);
+	free(zst->coff);
+	free(zst->uoff);
+
+	int ret = close(zst->src.fd);
+	free(zst);
+	return(ret);
+}
+
+/**
+ * @fn zf_zstr_dopen
+ */
+static
+void *zf_zstr_dopen(
+	int fd,
+	char const *mode,
+	struct zf_params_s const *params)
+{
+	if(fd < 0) { return(NULL); }
+
+	struct zf_zstr_s *zst = (struct zf_zstr_s *)calloc(1, sizeof(struct zf_zstr_s));
+	if(zst == NULL) { return(NULL); }
+	zf_src_init(&zst->src, fd, params);
+	zst->wlog = params->wlog;
+	zst->src.base = lseek(fd, 0, SEEK_CUR);
+	if(zst->src.base == 0) {
+		zf_zstr_load_seektable(zst);
+	}
+
+	/* zstd has no transparent mode; fill the buffer to examine the first frame */
+	zf_src_peek(&zst->src, ZF_SRC_BUF_SIZE);
+	uint8_t const *p = &zst->src.buf[zst->src.curr];
+	size_t avail = zst->src.end - zst->src.curr;
+	if(avail < 4 || (zf_zstr_get_u32(p) != ZSTD_MAGICNUMBER
+	&& (zf_zstr_get_u32(p) & ZSTD_MAGIC_SKIPPABLE_MASK) != ZSTD_MAGIC_SKIPPABLE_START)) {
+		goto _zf_zstr_dopen_error;
+	}
+
+	/* frames are known to be independent in the seekable format */
+	if(params->nth > 0 && (zst->nfr != 0 || !ZSTD_isError(ZSTD_findFrameCompressedSize(p, avail)))) {
+		zst->nth = params->nth;
+	}
+	if(zf_zstr_start(zst) != 0) { goto _zf_zstr_dopen_error; }
+	return((void *)zst);
+
+_zf_zstr_dopen_error:;
+	free(zst->coff);
+	free(zst->uoff);
+	free(zst);
+	return(NULL);
+}
+#endif /* HAVE_ZSTD */
+
+/* zstd compressor (zstd-dependent) */
+#ifdef HAVE_ZSTD
+/**
+ * @struct zf_zstw_s
+ * @brief zstd writer context; compressed on the worker threads of libzstd if requested
+ */
+struct zf_zstw_s {
+	int fd;
+	int err;
+	uint64_t span;					/* seekable format: decompressed size of frames, 0 if disabled */
+	uint64_t csize, usize;			/* seekable format: sizes of the current frame */
+	uint64_t nfr, max;
+	uint32_t *tbl;					/* seekable format: (compressed, decompressed) sizes of the frames */
+	ZSTD_CCtx *cctx;
+	uint8_t *buf;
+	size_t size;
+};
+
+/**
+ * @fn zf_zstw_compress
+ * @brief feed input to the compressor and write out the result
+ */
+static
+int zf_zstw_compress(
+	struct zf_zstw_s *zst,
+	void const *ptr,
+	size_t len,
+	ZSTD_EndDirective op)
+{
+	ZSTD_inBuffer in = { ptr, len, 0 };
+	size_t ret = 1;
+	while(zst->err == 0 && (in.pos < in.size || (op == ZSTD_e_end && ret != 0))) {
+		ZSTD_outBuffer out = { zst->buf, zst->size, 0 };
+		ret = ZSTD_compressStream2(zst->cctx, &out, &in, op);
+		if(ZSTD_isError(ret) || zf_write_all(zst->fd, zst->buf, out.pos) != 0) {
+			zst->err = 1;
+		}
+		zst->csize += out.pos;
+	}
+	return(zst->err);
+}
+
+/**
+ * @fn zf_zstw_end_frame
+ * @brief close the current frame, and record it to the seek table
+ */
+static
+int zf_zstw_end_frame(
+	struct zf_zstw_s *zst)
+{
+	if(zf_zstw_compress(zst, NULL, 0, ZSTD_e_end) != 0) {
+		return(-1);
+	}
+	if(zst->nfr == zst->max) {
+		zst->max = (zst->max < 256) ? 256 : 2 * zst->max;
+		uint32_t *tbl = (uint32_t *)realloc(zst->tbl, sizeof(uint32_t) * 2 * zst->max);
+		if(tbl == NULL) {
+			zst->err = 1;
+			return(-1);
+		}
+		zst->tbl = tbl;
+	}
+	zst->tbl[2 * zst->nfr] = zst->csize;
+	zst->tbl[2 * zst->nfr + 1] = zst->usize;
+	zst->nfr++;
+	zst->csize = zst->usize = 0;
+	return(0);
+}
+
+/**
+ * @fn zf_zstw_put_seektable
+ * @brief seek table in a skippable frame, without checksums
+ */
+static
+int zf_zstw_put_seektable(
+	struct zf_zstw_s *zst)
+{
+	uint64_t size = 8 + 8 * zst->nfr + 9;
+	uint8_t *p = (uint8_t *)malloc(size);
+	if(p == NULL) { return(-1); }
+
+	uint32_t const vals[2] = { ZF_ZST_SEEKTABLE_MAGIC, size - 8 };
+	for(uint64_t i = 0; i < 2 + 2 * zst->nfr; i++) {
+		uint32_t val = (i < 2) ? vals[i] : zst->tbl[i - 2];
+		for(int j = 0; j < 4; j++) { p[4 * i + j] = val>>(8 * j); }
+	}
+	uint8_t *foot = p + 8 + 8 * zst->nfr;
+	uint32_t const nfr = zst->nfr, magic = ZF_ZST_SEEKABLE_MAGIC;
+	for(int j = 0; j < 4; j++) {
+		foot[j] = nfr>>(8 * j);
+		foot[5 + j] = magic>>(8 * j);
+	}
+	foot[4] = 0;				/* descriptor: no checksum */
+
+	int ret = zf_write_all(zst->fd, p, size);
+	free(p);
+	return(ret);
+}
+
+/**
+ * @fn zf_zstw_write
+ */
+static
+size_t zf_zstw_write(
+	void *fp,
+	void *ptr,
+	size_t len)
+{
+	struct zf_zstw_s *zst = (struct zf_zstw_s *)fp;
+	if(zst->span == 0) {
+		return((zf_zstw_compress(zst, ptr, len, ZSTD_e_continue) == 0) ? len : 0);
+	}
+
+	/* seekable format: close the frame at every span bytes */
+	size_t copied_size = 0;
+	while(copied_size < len && zst->err == 0) {
+		size_t rem_size = zst->span - zst->usize;
+		size_t copy_size = (len - copied_size < rem_size) ? len - copied_size : rem_size;
+		zf_zstw_compress(zst, (uint8_t const *)ptr + copied_size, copy_size, ZSTD_e_continue);
+		zst->usize += copy_size;
+		copied_size += copy_size;
+
+		if(zst->usize == zst->span) {
+			zf_zstw_end_frame(zst);
+		}
+	}
+	return((zst->err == 0) ? len : 0);
+}
+
+/**
+ * @fn zf_zstw_close
+ */
+static
+int zf_zstw_close(
+	void *fp)
+{
+	struct zf_zstw_s *zst = (struct zf_zstw_s *)fp;
+	int ret = 0;
+	if(zst->span == 0) {
+		ret = (zf_zstw_compress(zst, NULL, 0, ZSTD_e_end) == 0) ? 0 : -1;
+	} else {
+		if(zst->usize != 0 && zf_zstw_end_frame(zst) != 0) { ret = -1; }
+		if(ret != 0 || zst->err != 0 || zf_zstw_put_seektable(zst) != 0) { ret = -1; }
+	}
+	ZSTD_freeCCtx(zst->cctx);
+	free(zst->tbl);
+	ret |= close(zst->fd);
+	free(zst);
+	return(ret);
+}
+
+/**
+ * @fn zf_zstw_dopen
+ * @brief level is taken from the mode string, e.g. "w19", and the long distance matching
+ * is enabled with "long" or "long=<window log>" in the params. "idx" / "idx=<span>" switches
+ * to the seekable format, with frames of span bytes and the seek table at the tail.
+ */
+static
+void *zf_zstw_dopen(
+	int fd,
+	char const *mode,
+	struct zf_params_s const *params)
+{
+	if(fd < 0) { return(NULL); }
+
+	size_t size = ZSTD_CStreamOutSize();
+	struct zf_zstw_s *zst = (struct zf_zstw_s *)calloc(1, sizeof(struct zf_zstw_s) + size);
+	if(zst == NULL) { return(NULL); }
+	zst->fd = fd;
+	zst->buf = (uint8_t *)(zst + 1);
+	zst->size = size;
+	zst->span = (params->span > ZF_ZST_SEEKABLE_MAX_FRAME) ? ZF_ZST_SEEKABLE_MAX_FRAME : params->span;
+	if((zst->cctx = ZSTD_createCCtx()) == NULL) {
+		free(zst);
+		return(NULL);
+	}
+
+	if(ZSTD_isError(ZSTD_CCtx_setParameter(zst->cctx, ZSTD_c_compressionLevel, zf_parse_level(mode, ZSTD_CLEVEL_DEFAULT, 1, ZSTD_maxCLevel())))
+	|| (params->wlog != 0 && ZSTD_isError(ZSTD_CCtx_setParameter(zst->cctx, ZSTD_c_enableLongDistanceMatching, 1)))
+	|| (params->wlog != 0 && ZSTD_isError(ZSTD_CCtx_setParameter(zst->cctx, ZSTD_c_windowLog, params->wlog)))) {
+		ZSTD_freeCCtx(zst->cctx);
+		free(zst);
+		return(NULL);
+	}
+
+	/* falls back to single-threaded if libzstd is built without multithreading support */
+	if(params->nth > 0) {
+		ZSTD_CCtx_setParameter(zst->cctx, ZSTD_c_nbWorkers, params->nth);
+	}
+	return((void *)zst);
+}
+
+/**
+ * @fn zf_zstw_open
+ */
+static
+void *zf_zstw_open(
+	char const *path,
+	char const *mode,
+	struct zf_params_s const *params)
+{
+	int fd = zf_open_fd(path, mode);
+	void *fp = zf_zstw_dopen(fd, mode, params);
+	if(fp == NULL && fd >= 0) { close(fd); }
+	return(fp);
+}
+#endif /* HAVE_ZSTD */
+
+/* xz / lzma decompressor (liblzma-dependent) */
+#ifdef HAVE_LZMA
+/**
+ * @struct zf_xzr_s
+ * @brief xz / lzma reader context; xz is decoded on the block-parallel decoder of liblzma if requested
+ */
+struct zf_xzr_s {
+	int err;
+	int end;
+	lzma_stream strm;
+	struct zf_src_s src;
+};
+
+/**
+ * @fn zf_xzr_read
+ */
+static
+size_t zf_xzr_read(
+	void *fp,
+	void *ptr,
+	size_t len)
+{
+	struct zf_xzr_s *xz = (struct zf_xzr_s *)fp;
+	xz->strm.next_out = (uint8_t *)ptr;
+	xz->strm.avail_out = len;
+	while(xz->strm.avail_out > 0 && xz->end == 0) {
+		/* LZMA_FINISH at the end of input, for concatenated streams and buffered outputs */
+		uint8_t const *p = zf_src_peek(&xz->src, 1);
+		xz->strm.next_in = p;
+		xz->strm.avail_in = (p != NULL) ? xz->src.end - xz->src.curr : 0;
+		lzma_ret ret = lzma_code(&xz->strm, (p != NULL) ? LZMA_RUN : LZMA_FINISH);
+		xz->src.curr = xz->src.end - xz->strm.avail_in;
+
+		if(ret == LZMA_STREAM_END) {
+			xz->end = 1;
+		} else if(ret != LZMA_OK) {
+			xz->err = xz->end = 1;	/* broken or truncated */
+		}
+	}
+	return(len - xz->strm.avail_out);
+}
+
+/**
+ * @fn zf_xzr_close
+ */
+static
+int zf_xzr_close(
+	void *fp)
+{
+	struct zf_xzr_s *xz = (struct zf_xzr_s *)fp;
+	lzma_end(&xz->strm);
+
+	/* broken or truncated input is reported here, as reads just end short */
+	int ret = close(xz->src.fd);
+	ret |= xz->err;
+	free(xz);
+	return(ret);
+}
+
+/**
+ * @fn zf_xzr_dopen
+ * @brief format is determined from the magic; .lzma (lzma_alone) is decoded on the caller thread
+ */
+static
+void *zf_xzr_dopen(
+	int fd,
+	char const *mode,
+	struct zf_params_s const *params)
+{
+	if(fd < 0) { return(NULL); }
+
+	struct zf_xzr_s *xz = (struct zf_xzr_s *)calloc(1, sizeof(struct zf_xzr_s));
+	if(xz == NULL) { return(NULL); }
+	zf_src_init(&xz->src, fd, params);
+	lzma_stream const init = LZMA_STREAM_INIT;
+	xz->strm = init;
+
+	uint8_t const magic[6] = { 0xfd, '7', 'z', 'X', 'Z', 0x00 };
+	uint8_t const *p = zf_src_peek(&xz->src, 6);
+	lzma_ret ret;
+	if(p == NULL || memcmp(p, magic, 6) != 0) {
+		ret = lzma_alone_decoder(&xz->strm, UINT64_MAX);
+	#ifdef HAVE_LZMA_MT		/* liblzma >= 5.4 */
+	} else if(params->nth > 0) {
+		lzma_mt mt = {
+			.flags = LZMA_CONCATENATED,
+			.threads = params->nth,
+			.memlimit_threading = lzma_physmem() / 4,		/* same as xz */
+			.memlimit_stop = UINT64_MAX
+		};
+		ret = lzma_stream_decoder_mt(&xz->strm, &mt);
+	#endif
+	} else {
+		ret = lzma_stream_decoder(&xz->strm, UINT64_MAX, LZMA_CONCATENATED);
+	}
+	if(ret != LZMA_OK) {
+		free(xz);
+		return(NULL);
+	}
+	return((void *)xz);
+}
+#endif /* HAVE_LZMA */
+
+/* xz / lzma compressor (liblzma-dependent) */
+#ifdef HAVE_LZMA
+#define ZF_XZW_BUF_SIZE				( 128 * 1024 )
+
+/**
+ * @struct zf_xzw_s
+ * @brief xz / lzma writer context
+ */
+struct zf_xzw_s {
+	int fd;
+	int err;
+	lzma_stream strm;
+	uint8_t buf[ZF_XZW_BUF_SIZE];
+};
+
+/**
+ * @fn zf_xzw_code
+ * @brief feed input to the encoder and write out the result, until the end of stream for LZMA_FINISH
+ */
+static
+int zf_xzw_code(
+	struct zf_xzw_s *xz,
+	void const *ptr,
+	size_t len,
+	lzma_action action)
+{
+	xz->strm.next_in = (uint8_t const *)ptr;
+	xz->strm.avail_in = len;
+	lzma_ret ret = LZMA_OK;
+	while(xz->err == 0 && (xz->strm.avail_in > 0 || (action == LZMA_FINISH && ret != LZMA_STREAM_END))) {
+		xz->strm.next_out = xz->buf;
+		xz->strm.avail_out = ZF_XZW_BUF_SIZE;
+		ret = lzma_code(&xz->strm, action);
+		if((ret != LZMA_OK && ret != LZMA_STREAM_END)
+		|| zf_write_all(xz->fd, xz->buf, ZF_XZW_BUF_SIZE - xz->strm.avail_out) != 0) {
+			xz->err = 1;
+		}
+	}
+	return(xz->err);
+}
+
+/**
+ * @fn zf_xzw_write
+ */
+static
+size_t zf_xzw_write(
+	void *fp,
+	void *ptr,
+	size_t len)
+{
+	struct zf_xzw_s *xz = (struct zf_xzw_s *)fp;
+	return((zf_xzw_code(xz, ptr, len, LZMA_RUN) == 0) ? len : 0);
+}
+
+/**
+ * @fn zf_xzw_close
+ */
+static
+int zf_xzw_close(
+	void *fp)
+{
+	struct zf_xzw_s *xz = (struct zf_xzw_s *)fp;
+	int ret = (zf_xzw_code(xz, NULL, 0, LZMA_FINISH) == 0) ? 0 : -1;
+	lzma_end(&xz->strm);
+	ret |= close(xz->fd);
+	free(xz);
+	return(ret);
+}
+
+/**
+ * @fn zf_xzw_init
+ * @brief xz is compressed on the block-parallel encoder of liblzma if requested
+ */
+static
+void *zf_xzw_init(
+	int fd,
+	char const *mode,
+	struct zf_params_s const *params,
+	int alone)
+{
+	if(fd < 0) { return(NULL); }
+
+	struct zf_xzw_s *xz = (struct zf_xzw_s *)calloc(1, sizeof(struct zf_xzw_s));
+	if(xz == NULL) { return(NULL); }
+	xz->fd = fd;
+	lzma_stream const init = LZMA_STREAM_INIT;
+	xz->strm = init;
+
+	uint32_t preset = zf_parse_level(mode, LZMA_PRESET_DEFAULT, 0, 9);
+	lzma_ret ret;
+	if(alone != 0) {
+		lzma_options_lzma opt;
+		ret = lzma_lzma_preset(&opt, preset) ? LZMA_OPTIONS_ERROR : lzma_alone_encoder(&xz->strm, &opt);
+	} else if(params->nth > 0) {
+		lzma_mt mt = {
+			.threads = params->nth,
+			.preset = preset,
+			.check = LZMA_CHECK_CRC64
+		};
+		ret = lzma_stream_encoder_mt(&xz->strm, &mt);
+	} else {
+		ret = lzma_easy_encoder(&xz->strm, preset, LZMA_CHECK_CRC64);
+	}
+	if(ret != LZMA_OK) {
+		free(xz);
+		return(NULL);
+	}
+	return((void *)xz);
+}
+
+/**
+ * @fn zf_xzw_dopen
+ */
+static
+void *zf_xzw_dopen(
+	int fd,
+	char const *mode,
+	struct zf_params_s const *params)
+{
+	return(zf_xzw_init(fd, mode, params, 0));
+}
+
+/**
+ * @fn zf_xzw_open
+ */
+static
+void *zf_xzw_open(
+	char const *path,
+	char const *mode,
+	struct zf_params_s const *params)
+{
+	int fd = zf_open_fd(path, mode);
+	void *fp = zf_xzw_init(fd, mode, params, 0);
+	if(fp == NULL && fd >= 0) { close(fd); }
+	return(fp);
+}
+
+/**
+ * @fn zf_lzmaw_dopen
+ */
+static
+void *zf_lzmaw_dopen(
+	int fd,
+	char const *mode,
+	struct zf_params_s const *params)
+{
+	return(zf_xzw_init(fd, mode, params, 1));
+}
+
+/**
+ * @fn zf_lzmaw_open
+ */
+static
+void *zf_lzmaw_open(
+	char const *path,
+	char const *mode,
+	struct zf_params_s const *params)
+{
+	int fd = zf_open_fd(path, mode);
+	void *fp = zf_xzw_init(fd, mode, params, 1);
+	if(fp == NULL && fd >= 0) { close(fd); }
+	return(fp);
+}
+#endif /* HAVE_LZMA */
+
+/* lz4 decompressor (lz4-dependent) */
+#ifdef HAVE_LZ4
+#define ZF_LZ4_MAGIC				( 0x184d2204 )
+#define ZF_LZ4_BLOCK_SIZE			( 4 * 1024 * 1024 )	/* LZ4F_max4MB */
+
+/**
+ * @struct zf_lz4r_s
+ * @brief lz4 frame reader context; frames with independent blocks are decoded block-by-block on
+ * the worker threads if requested (block and content checksums are not verified in this mode),
+ * others are decoded with LZ4F on the caller thread.
+ */
+struct zf_lz4r_s {
+	int err;
+	int feed_err;					/* read after the pool is finished */
+	LZ4F_dctx *dctx;				/* serial */
+	size_t hint;					/* serial: nonzero in the middle of a frame */
+	struct zf_mt_s *mt;
+	struct zf_mt_blk_s *blk;		/* block being consumed, NULL if not drained */
+	size_t pos;
+
+	/* feeder states */
+	int in_frame;
+	int bchk, cchk;					/* block / content checksum flags of the current frame */
+	size_t bmax;					/* block max size of the current frame */
+	struct zf_src_s src;
+};
+
+/**
+ * @fn zf_lz4_get_u32
+ */
+static inline
+uint32_t zf_lz4_get_u32(
+	uint8_t const *p)
+{
+	return(p[0] | (p[1]<<8) | (p[2]<<16) | ((uint32_t)p[3]<<24));
+}
+
+/**
+ * @fn zf_lz4_put_u32
+ */
+static inline
+void zf_lz4_put_u32(
+	uint8_t *p,
+	uint32_t val)
+{
+	for(int i = 0; i < 4; i++) { p[i] = val>>(8 * i); }
+	return;
+}
+
+/**
+ * @fn zf_lz4r_parse_header
+ * @brief returns the size of the frame header at p, 0 if the frame is not decodable block-by-block
+ */
+static
+size_t zf_lz4r_parse_header(
+	struct zf_lz4r_s *lz,
+	uint8_t const *p)
+{
+	uint8_t flg = p[4], bd = p[5];
+	if(zf_lz4_get_u32(p) != ZF_LZ4_MAGIC || (flg>>6) != 0x01 || (flg & 0x20) == 0 || (flg & 0x01) != 0) {
+		return(0);					/* not lz4, linked blocks, or with dictionary */
+	}
+	lz->bchk = (flg>>4) & 0x01;
+	lz->cchk = (flg>>2) & 0x01;
+	lz->bmax = 1ULL<<(8 + 2 * ((bd>>4) & 0x07));	/* 64KB for 4, 4MB for 7 */
+	return(7 + ((flg & 0x08) ? 8 : 0));
+}
+
+/**
+ * @fn zf_lz4r_copy
+ * @brief append len bytes of the input to blk (skip if blk is NULL); blocks may exceed the source window
+ */
+static
+int zf_lz4r_copy(
+	struct zf_src_s *src,
+	struct zf_mt_blk_s *blk,
+	uint64_t len)
+{
+	while(len > 0) {
+		uint8_t const *p = zf_src_peek(src, 1);
+		if(p == NULL) { return(-1); }
+
+		size_t size = (src->end - src->curr < len) ? src->end - src->curr : len;
+		if(blk != NULL && zf_mt_append(blk, p, size) != 0) { return(-1); }
+		src->curr += size;
+		len -= size;
+	}
+	return(0);
+}
+
+/**
+ * @fn zf_lz4r_feed
+ * @brief cut a block out of the input, skipping frame headers, end marks, and skippable frames
+ */
+static
+int zf_lz4r_feed(
+	void *arg,
+	struct zf_mt_blk_s *blk)
+{
+	struct zf_lz4r_s *lz = (struct zf_lz4r_s *)arg;
+	struct zf_src_s *src = &lz->src;
+	uint8_t const *p;
+
+	while(1) {
+		if(lz->in_frame == 0) {
+			if(zf_src_peek(src, 1) == NULL) {
+				return(0);			/* end of input */
+			}
+			if((p = zf_src_peek(src, 8)) == NULL) { goto _zf_lz4r_feed_error; }
+			if((zf_lz4_get_u32(p) & 0xfffffff0) == 0x184d2a50) {
+				/* skippable frame */
+				if(zf_lz4r_copy(src, NULL, 8 + (uint64_t)zf_lz4_get_u32(p + 4)) != 0) {
+					goto _zf_lz4r_feed_error;
+				}
+				continue;
+			}
+
+			size_t hsize;
+			if((p = zf_src_peek(src, 15)) == NULL || (hsize = zf_lz4r_parse_header(lz, p)) == 0) {
+				goto _zf_lz4r_feed_error;
+			}
+			src->curr += hsize;
+			lz->in_frame = 1;
+		}
+
+		/* block size, the most significant bit is set for uncompressed block */
+		if((p = zf_src_peek(src, 4)) == NULL) { goto _zf_lz4r_feed_error; }
+		uint32_t size = zf_lz4_get_u32(p);
+		src->curr += 4;
+		if(size == 0) {
+			/* end mark, followed by content checksum */
+			if(lz->cchk != 0 && (p = zf_src_peek(src, 4)) == NULL) { goto _zf_lz4r_feed_error; }
+			src->curr += 4 * lz->cchk;
+			lz->in_frame = 0;
+			continue;
+		}
+
+		size_t len = size & 0x7fffffff;
+		if(len > lz->bmax || zf_lz4r_copy(src, blk, len) != 0 || zf_lz4r_copy(src, NULL, 4 * lz->bchk) != 0) {
+			goto _zf_lz4r_feed_error;
+		}
+		blk->aux[0] = size>>31;
+		blk->aux[1] = lz->bmax;
+		return(1);
+	}
+
+_zf_lz4r_feed_error:;
+	lz->feed_err = 1;
+	return(-1);
+}
+
+/**
+ * @fn zf_lz4r_work
+ */
+static
+int zf_lz4r_work(
+	void *arg,
+	void *wctx,
+	struct zf_mt_blk_s *blk)
+{
+	if(zf_mt_reserve(&blk->out, &blk->out_size, blk->aux[1]) != 0) {
+		return(-1);
+	}
+	if(blk->aux[0] != 0) {
+		memcpy(blk->out, blk->in, blk->in_len);
+		blk->out_len = blk->in_len;
+		return(0);
+	}
+	int ret = LZ4_decompress_safe((char const *)blk->in, (char *)blk->out, blk->in_len, blk->aux[1]);
+	blk->out_len = (ret > 0) ? ret : 0;
+	return((ret > 0) ? 0 : -1);
+}
+
+/**
+ * @fn zf_lz4r_read_serial
+ */
+static
+size_t zf_lz4r_read_serial(
+	struct zf_lz4r_s *lz,
+	uint8_t *ptr,
+	size_t len)
+{
+	size_t copied_size = 0;
+	while(copied_size < len && lz->err == 0) {
+		/* LZ4F may hold decoded bytes after the input ended */
+		uint8_t const *p = zf_src_peek(&lz->src, 1);
+		size_t dst_size = len - copied_size;
+		size_t src_size = (p != NULL) ? lz->src.end - lz->src.curr : 0;
+		size_t ret = LZ4F_decompress(lz->dctx, ptr + copied_size, &dst_size, p, &src_size, NULL);
+		lz->src.curr += src_size;
+		copied_size += dst_size;
+
+		if(LZ4F_isError(ret)) {
+			lz->err = 1;
+		} else if(p == NULL && dst_size == 0) {
+			lz->err = (ret != 0);	/* truncated in the middle of a frame */
+			break;
+		}
+	}
+	return(copied_size);
+}
+
+/**
+ * @fn zf_lz4r_read
+ */
+static
+size_t zf_lz4r_read(
+	void *fp,
+	void *_ptr,
+	size_t len)
+{
+	struct zf_lz4r_s *lz = (struct zf_lz4r_s *)fp;
+	uint8_t *ptr = (uint8_t *)_ptr;
+	size_t copied_size = 0;
+
+	if(lz->mt == NULL) {
+		return(zf_lz4r_read_serial(lz, ptr, len));
+	}
+
+	while(copied_size < len) {
+		if(lz->blk == NULL || lz->pos == lz->blk->out_len) {
+			/* fetch the next block */
+			if(lz->blk != NULL) {
+				zf_mt_release(lz->mt);
+			}
+			lz->pos = 0;
+			if((lz->blk = zf_mt_drain(lz->mt)) == NULL) {
+				lz->err |= lz->feed_err;
+				break;
+			}
+			if(lz->blk->err != 0) {
+				lz->err = 1;
+				zf_mt_release(lz->mt); lz->blk = NULL;
+				break;
+			}
+			continue;
+		}
+
+		/* copy */
+		size_t rem_size = lz->blk->out_len - lz->pos;
+		size_t copy_size = (len - copied_size < rem_size) ? len - copied_size : rem_size;
+		memcpy(ptr + copied_size, &lz->blk->out[lz->pos], copy_size);
+		lz->pos += copy_size;
+		copied_size += copy_size;
+	}
+	return(copied_size);
+}
+
+/**
+ * @fn zf_lz4r_close
+ */
+static
+int zf_lz4r_close(
+	void *fp)
+{
+	struct zf_lz4r_s *lz = (struct zf_lz4r_s *)fp;
+	zf_mt_destroy(lz->mt);
+	LZ4F_freeDecompressionContext(lz->dctx);
+
+	int ret = close(lz->src.fd);
+	free(lz);
+	return(ret);
+}
+
+/**
+ * @fn zf_lz4r_dopen
+ */
+static
+void *zf_lz4r_dopen(
+	int fd,
+	char const *mode,
+	struct zf_params_s const *params)
+{
+	if(fd < 0) { return(NULL); }
+
+	struct zf_lz4r_s *lz = (struct zf_lz4r_s *)calloc(1, sizeof(struct zf_lz4r_s));
+	if(lz == NULL) { return(NULL); }
+	zf_src_init(&lz->src, fd, params);
+
+	/* parallel if the first frame consists of independent blocks */
+	uint8_t const *p = zf_src_peek(&lz->src, 15);
+	if(params->nth > 0 && p != NULL && zf_lz4r_parse_header(lz, p) != 0) {
+		lz->mt = zf_mt_init(params->nth,
+			ZF_LZ4_BLOCK_SIZE, ZF_LZ4_BLOCK_SIZE,
+			(void *)lz,
+			NULL, NULL, zf_lz4r_work, zf_lz4r_feed, NULL);
+		if(lz->mt == NULL) { goto _zf_lz4r_dopen_error; }
+	} else {
+		if(LZ4F_isError(LZ4F_createDecompressionContext(&lz->dctx, LZ4F_VERSION))) {
+			goto _zf_lz4r_dopen_error;
+		}
+	}
+	return((void *)lz);
+
+_zf_lz4r_dopen_error:;
+	free(lz);
+	return(NULL);
+}
+#endif /* HAVE_LZ4 */
+
+/* lz4 compressor (lz4-dependent) */
+#ifdef HAVE_LZ4
+#define ZF_LZ4_CHUNK_SIZE			( 64 * 1024 )		/* input size for a LZ4F_compressUpdate call */
+
+/**
+ * @struct zf_lz4w_s
+ * @brief lz4 frame writer context; 4MB independent blocks, compressed on the worker threads if
+ * requested (without checksums), otherwise with LZ4F on the caller thread (with content checksum).
+ */
+struct zf_lz4w_s {
+	int fd;
+	int level;
+	int err;
+	LZ4F_cctx *cctx;				/* serial */
+	LZ4F_preferences_t prefs;
+	uint8_t *buf;
+	size_t size;
+	struct zf_mt_s *mt;
+	struct zf_mt_blk_s *blk;		/* block being filled, NULL if not acquired */
+};
+
+/**
+ * @fn zf_lz4w_work
+ * @brief compress a block into [size][data], stored as is if not compressible
+ */
+static
+int zf_lz4w_work(
+	void *arg,
+	void *wctx,
+	struct zf_mt_blk_s *blk)
+{
+	struct zf_lz4w_s *lz = (struct zf_lz4w_s *)arg;
+	char const *src = (char const *)blk->in;
+	char *dst = (char *)blk->out + 4;
+	int cap = blk->out_size - 4;
+	int size = (lz->level < LZ4HC_CLEVEL_MIN)
+		? LZ4_compress_default(src, dst, blk->in_len, cap)
+		: LZ4_compress_HC(src, dst, blk->in_len, cap, lz->level);
+
+	if(size <= 0 || (size_t)size >= blk->in_len) {
+		zf_lz4_put_u32(blk->out, blk->in_len | 0x80000000);
+		memcpy(dst, src, blk->in_len);
+		size = blk->in_len;
+	} else {
+		zf_lz4_put_u32(blk->out, size);
+	}
+	blk->out_len = 4 + size;
+	return(0);
+}
+
+/**
+ * @fn zf_lz4w_emit
+ */
+static
+int zf_lz4w_emit(
+	void *arg,
+	struct zf_mt_blk_s *blk)
+{
+	struct zf_lz4w_s *lz = (struct zf_lz4w_s *)arg;
+	if(lz->err != 0 || blk->err != 0 || zf_write_all(lz->fd, blk->out, blk->out_len) != 0) {
+		zf_mt_flag(lz->mt, &lz->err, 1);
+		return(-1);
+	}
+	return(0);
+}
+
+/**
+ * @fn zf_lz4w_write
+ */
+static
+size_t zf_lz4w_write(
+	void *fp,
+	void *_ptr,
+	size_t len)
+{
+	struct zf_lz4w_s *lz = (struct zf_lz4w_s *)fp;
+	uint8_t const *ptr = (uint8_t const *)_ptr;
+	size_t copied_size = 0;
+
+	while(copied_size < len && zf_mt_flag(lz->mt, &lz->err, 0) == 0) {
+		if(lz->mt == NULL) {
+			size_t copy_size = (len - copied_size < ZF_LZ4_CHUNK_SIZE) ? len - copied_size : ZF_LZ4_CHUNK_SIZE;
+			size_t ret = LZ4F_compressUpdate(lz->cctx, lz->buf, lz->size, ptr + copied_size, copy_size, NULL);
+			if(LZ4F_isError(ret) || zf_write_all(lz->fd, lz->buf, ret) != 0) {
+				lz->err = 1;
+			}
+			copied_size += copy_size;
+			continue;
+		}
+
+		if(lz->blk == NULL && (lz->blk = zf_mt_acquire(lz->mt)) == NULL) {
+			break;
+		}
+
+		/* copy */
+		size_t rem_size = ZF_LZ4_BLOCK_SIZE - lz->blk->in_len;
+		size_t copy_size = (len - copied_size < rem_size) ? len - copied_size : rem_size;
+		memcpy(lz->blk->in + lz->blk->in_len, ptr + copied_size, copy_size);
+		lz->blk->in_len += copy_size;
+		copied_size += copy_size;
+
+		/* flush if full */
+		if(lz->blk->in_len == ZF_LZ4_BLOCK_SIZE) {
+			zf_mt_push(lz->mt);
+			lz->blk = NULL;
+		}
+	}
+	return((zf_mt_flag(lz->mt, &lz->err, 0) == 0) ? copied_size : 0);
+}
+
+/**
+ * @fn zf_lz4w_close
+ */
+static
+int zf_lz4w_close(
+	void *fp)
+{
+	struct zf_lz4w_s *lz = (struct zf_lz4w_s *)fp;
+	size_t size = 4;
+	if(lz->mt != NULL) {
+		if(lz->blk != NULL && lz->blk->in_len != 0) {
+			zf_mt_push(lz->mt);
+		}
+		zf_mt_destroy(lz->mt);		/* drains all the blocks */
+		zf_lz4_put_u32(lz->buf, 0);	/* end mark */
+	} else {
+		size = LZ4F_compressEnd(lz->cctx, lz->buf, lz->size, NULL);
+		lz->err |= LZ4F_isError(size);
+	}
+
+	int ret = (lz->err == 0 && zf_write_all(lz->fd, lz->buf, size) == 0) ? 0 : -1;
+	ret |= close(lz->fd);
+	LZ4F_freeCompressionContext(lz->cctx);
+	free(lz->buf);
+	free(lz);
+	return(ret);
+}
+
+/**
+ * @fn zf_lz4w_dopen
+ * @brief level 3 or larger selects lz4hc
+ */
+static
+void *zf_lz4w_dopen(
+	int fd,
+	char const *mode,
+	struct zf_params_s const *params)
+{
+	if(fd < 0) { return(NULL); }
+
+	struct zf_lz4w_s *lz = (struct zf_lz4w_s *)calloc(1, sizeof(struct zf_lz4w_s));
+	if(lz == NULL) { return(NULL); }
+	lz->fd = fd;
+	lz->level = zf_parse_level(mode, 0, 0, LZ4HC_CLEVEL_MAX);
+	lz->prefs.frameInfo.blockSizeID = LZ4F_max4MB;
+	lz->prefs.frameInfo.blockMode = LZ4F_blockIndependent;
+	lz->prefs.frameInfo.contentChecksumFlag = (params->nth == 0) ? LZ4F_contentChecksumEnabled : LZ4F_noContentChecksum;
+	lz->prefs.compressionLevel = lz->level;
+
+	/* the header is built by LZ4F in both modes */
+	lz->size = LZ4F_compressBound(ZF_LZ4_CHUNK_SIZE, &lz->prefs);
+	lz->size = (lz->size < LZ4F_HEADER_SIZE_MAX) ? LZ4F_HEADER_SIZE_MAX : lz->size;
+	if((lz->buf = (uint8_t *)malloc(lz->size)) == NULL
+	|| LZ4F_isError(LZ4F_createCompressionContext(&lz->cctx, LZ4F_VERSION))) {
+		goto _zf_lz4w_dopen_error;
+	}
+	size_t hsize = LZ4F_compressBegin(lz->cctx, lz->buf, lz->size, &lz->prefs);
+	if(LZ4F_isError(hsize) || zf_write_all(fd, lz->buf, hsize) != 0) {
+		goto _zf_lz4w_dopen_error;
+	}
+
+	if(params->nth > 0) {
+		LZ4F_freeCompressionContext(lz->cctx);
+		lz->cctx = NULL;
+		lz->mt = zf_mt_init(params->nth,
+			ZF_LZ4_BLOCK_SIZE, 4 + LZ4_compressBound(ZF_LZ4_BLOCK_SIZE),
+			(void *)lz,
+			NULL, NULL, zf_lz4w_work, NULL, zf_lz4w_emit);
+		if(lz->mt == NULL) { goto _zf_lz4w_dopen_error; }
+	}
+	return((void *)lz);
+
+_zf_lz4w_dopen_error:;
+	LZ4F_freeCompressionContext(lz->cctx);
+	free(lz->buf);
+	free(lz);
+	return(NULL);
+}
+
+/**
+ * @fn zf_lz4w_open
+ */
+static
+void *zf_lz4w_open(
+	char const *path,
+	char const *mode,
+	struct zf_params_s const *params)
+{
+	int fd = zf_open_fd(path, mode);
+	void *fp = zf_lz4w_dopen(fd, mode, params);
+	if(fp == NULL && fd >= 0) { close(fd); }
+	return(fp);
+}
+#endif /* HAVE_LZ4 */
+
+/* buffers */
+
+/**
+ * @struct zf_buf_s
+ * @brief buffer with the ungetc margin before and ZF_BUF_PADDING bytes after, or a mirrored ring
+ */
+struct zf_buf_s {
+	uint8_t *ptr;
+	int64_t size;
+	void *base;		/* allocation containing ptr */
+	size_t len;		/* length of the mapping at base, 0 if malloc'd */
+	int mirror;		/* mirrored ring: ptr[i] and ptr[i + size] are the same byte */
+};
+
+/**
+ * @fn zf_buf_mirror
+ * @brief map a memfd of size bytes twice back to back (mirrored ring) so that the bytes across the wrap point are seen
+ * contiguous, followed by its head once more for the padding; on hugetlbfs if huge != 0
+ */
+static
+int zf_buf_mirror(
+	struct zf_buf_s *buf,
+	int64_t size,
+	int huge)
+{
+	#if defined(__linux__) && defined(SYS_memfd_create)
+	int64_t unit = (huge != 0) ? ZF_HUGEPAGE_SIZE : sysconf(_SC_PAGESIZE);
+	int64_t rsize = (size + unit - 1) & ~(unit - 1);
+	int fd = syscall(SYS_memfd_create, "zf", (huge != 0) ? ZF_MFD_HUGETLB : 0);
+	uint8_t *p = MAP_FAILED;
+	if(fd >= 0 && ftruncate(fd, rsize) == 0
+	&& (p = (uint8_t *)mmap(NULL, 2 * rsize + unit, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) != MAP_FAILED
+	&& mmap(p, rsize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED
+	&& mmap(p + rsize, rsize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED
+	&& mmap(p + 2 * rsize, unit, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED) {
+		close(fd);
+		buf->ptr = buf->base = p;
+		buf->size = rsize;
+		buf->len = 2 * rsize + unit;
+		buf->mirror = 1;
+		return(0);
+	}
+	if(p != MAP_FAILED) { munmap(p, 2 * rsize + unit); }
+	if(fd >= 0) { close(fd); }
+	#endif
+	return(-1);
+}
+
+/**
+ * @fn zf_buf_alloc
+ * @brief allocate at least size bytes, aligned to params->align. it is a mirrored ring if requested and available,
+ * or a block with the ungetc margin and ZF_BUF_PADDING bytes after the end otherwise. with "huge", hugetlbfs pages are tried first, then transparent hugepages.
+ */
+static
+int zf_buf_alloc(
+	struct zf_buf_s *buf,
+	struct zf_params_s const *params,
+	int64_t size,
+	int mirror)
+{
+	int huge = params->huge;
+	if(mirror != 0) {
+		if(huge != 0 && zf_buf_mirror(buf, size, 1) == 0) {
+			return(0);
+		}
+		if(zf_buf_mirror(buf, size, 0) == 0) {
+			#ifdef MADV_HUGEPAGE
+			if(huge != 0) { madvise(buf->base, buf->len, MADV_HUGEPAGE); }	/* shmem THP if enabled */
+			#endif
+			return(0);
+		}
+	}
+
+	/* the margin is extended to the alignment */
+	int64_t align = params->align;
+	buf->mirror = 0;
+	buf->size = size;
+	if(huge != 0) {
+		size_t len = (align + size + ZF_BUF_PADDING + ZF_HUGEPAGE_SIZE - 1) & ~((size_t)ZF_HUGEPAGE_SIZE - 1);
+		uint8_t *p = MAP_FAILED;
+		#ifdef MAP_HUGETLB
+		p = (uint8_t *)mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		#endif
+		if(p == MAP_FAILED && (p = (uint8_t *)mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) != MAP_FAILED) {
+			#ifdef MADV_HUGEPAGE
+			madvise(p, len, MADV_HUGEPAGE);		/* hint; fails if not supported */
+			#endif
+		}
+		if(p != MAP_FAILED) {
+			buf->base = p;
+			buf->len = len;
+			buf->ptr = p + align;
+			return(0);
+		}
+	}
+
+	void *p = NULL;
+	if(posix_memalign(&p, align, align + size + ZF_BUF_PADDING) != 0) { return(-1); }
+	buf->base = p;
+	buf->len = 0;
+	buf->ptr = (uint8_t *)p + align;
+	return(0);
+}
+
+/**
+ * @fn zf_buf_free
+ */
+static
+void zf_buf_free(
+	struct zf_buf_s *buf)
+{
+	if(buf->ptr == NULL) { return; }
+	if(buf->len != 0) {
+		munmap(buf->base, buf->len);
+	} else {
+		free(buf->base);
+	}
+	buf->ptr = buf->base = NULL;
+	return;
+}
+
+/**
+ * @struct zf_functions_s
+ * @brief function container
+ */
+struct zf_functions_s {
+	char const *ext;
+	int flags;
+	zf_dopen_t dopen;
+	zf_open_t open;
+	zf_init_t init;
+	zf_close_t close;
+	zf_read_t read;
+	zf_write_t write;
+	zf_seek_t seek;		/* move to the offset in the uncompressed stream (read mode), generic fallback if NULL */
+	zf_map_t map;		/* whole uncompressed content in memory, writable at least ZF_UNGETC_MARGIN_SIZE bytes before the head and followed by ZF_BUF_PADDING zeroed bytes (read mode), NULL if not available */
+};
+
+/**
+ * @struct zf_intl_s
+ * @brief context container
+ */
+struct zf_intl_s {
+	char *path;
+	char *mode;
+	int fd;
+	int eof;		/* == 1 if fp reached EOF, == 2 if curr reached the end of buf (read mode), or nonzero if a write failed (write mode) */
+	int err;		/* nonzero if closing a codec replaced by zf_rewind failed (read mode), reported by zfclose */
+	void *ko;
+	void *fp;		/* BZFILE * (serial bzip2 writer) or a context of the internal codecs */
+	struct zf_functions_s fn;
+	struct zf_params_s params;
+	uint8_t *buf;
+	int64_t size;
+	int64_t curr, end;
+	int64_t pos;	/* offset of buf[end] in the uncompressed stream (read mode), or the number of bytes flushed (write mode) */
+	int64_t valid;	/* buf[valid..end) is the stream just before pos (read mode); bytes before are stale or pushed back */
+	struct zf_ra_s *ra;	/* read-ahead thread, NULL if disabled */
+	struct zf_wb_s *wb;	/* write-behind thread, NULL if disabled */
+	struct zf_aio_s *aio;	/* thread running zfread_async / zfwrite_async, NULL until the first request */
+	struct zf_buf_s mem;	/* own buffer, which buf points at unless the codec maps the whole content */
+};
+_static_assert(sizeof(struct zf_intl_s) == sizeof(struct zf_s));
+_static_assert_offset(struct zf_intl_s, path, struct zf_s, path, 0);
+_static_assert_offset(struct zf_intl_s, mode, struct zf_s, mode, 0);
+
+/**
+ * @val fn_table
+ * @brief extension and function table
+ */
+static
+struct zf_functions_s const fn_table[] = {
+	/* gzip */
+	{
+		.ext = ".gz",
+		#ifdef HAVE_Z
+		.flags = ZF_FN_WR | ZF_FN_MT,
+		.dopen = (zf_dopen_t)zf_pgzw_dopen,
+		.open = (zf_open_t)zf_pgzw_open,
+		.init = (zf_init_t)NULL,
+		.close = (zf_close_t)zf_pgzw_close,
+		.read = (zf_read_t)NULL,
+		.write = (zf_write_t)zf_pgzw_write,
+		.seek = (zf_seek_t)NULL
+		#endif
+	},
+	{
+		.ext = ".gz",
+		.flags = ZF_FN_RD,
+		#ifdef HAVE_Z
+		.dopen = (zf_dopen_t)zf_gzr_dopen,
+		.open = (zf_open_t)NULL,
+		.init = (zf_init_t)NULL,
+		.close = (zf_close_t)zf_gzr_close,
+		.read = (zf_read_t)zf_gzr_read,
+		.write = (zf_write_t)NULL,
+		.seek = (zf_seek_t)zf_gzr_seek,
+		.map = (zf_map_t)zf_gzr_map
+		#endif
+	},
+	{
+		.ext = ".gz",
+		.flags = ZF_FN_WR,
+		#ifdef HAVE_Z
+		.dopen = (zf_dopen_t)zf_gzw_dopen,
+		.open = (zf_open_t)zf_gzw_open,
+		.init = (zf_init_t)NULL,
+		.close = (zf_close_t)zf_gzw_close,
+		.read = (zf_read_t)NULL,
+		.write = (zf_write_t)zf_gzw_write,
+		.seek = (zf_seek_t)NULL
+		#endif
+	},
+	/* BGZF */
+	{
+		.ext = ".bgz",
+		.flags = ZF_FN_WR,
+		#ifdef HAVE_Z
+		.dopen = (zf_dopen_t)zf_bgzfw_dopen,
+		.open = (zf_open_t)zf_bgzfw_open,
+		.init = (zf_init_t)NULL,
+		.close = (zf_close_t)zf_bgzfw_close,
+		.read = (zf_read_t)NULL,
+		.write = (zf_write_t)zf_bgzfw_write,
+		.seek = (zf_seek_t)NULL
+		#endif
+	},
+	{
+		.ext = ".bgz",
+		.flags = ZF_FN_RD,
+		#ifdef HAVE_Z
+		.dopen = (zf_dopen_t)zf_gzr_dopen,
+		.open = (zf_open_t)NULL,
+		.init = (zf_init_t)NULL,
+		.close = (zf_close_t)zf_gzr_close,
+		.read = (zf_read_t)zf_gzr_read,
+		.write = (zf_write_t)NULL,
+		.seek = (zf_seek_t)zf_gzr_seek,
+		.map = (zf_map_t)zf_gzr_map
+		#endif
+	},
+	/* bzip2 */
+	{
+		.ext = ".bz2",
+		#ifdef HAVE_BZ2
+		.flags = ZF_FN_WR | ZF_FN_MT,
+		.dopen = (zf_dopen_t)zf_pbz2w_dopen,
+		.open = (zf_open_t)zf_pbz2w_open,
+		.init = (zf_init_t)NULL,
+		.close = (zf_close_t)zf_pbz2w_close,
+		.read = (zf_read_t)NULL,
+		.write = (zf_write_t)zf_pbz2w_write,
+		.seek = (zf_seek_t)NULL
+		#endif
+	},
+	{
+		.ext = ".bz2",
+		.flags = ZF_FN_RD,
+		#ifdef HAVE_BZ2
+		.dopen = (zf_dopen_t)zf_bz2r_dopen,
+		.open = (zf_open_t)NULL,
+		.init = (zf_init_t)NULL,
+		.close = (zf_close_t)zf_bz2r_close,
+		.read = (zf_read_t)zf_bz2r_read,
+		.write = (zf_write_t)NULL,
+		.seek = (zf_seek_t)NULL
+		#endif
+	},
+	{
+		.ext = ".bz2",
+		.flags = ZF_FN_WR,
+		#ifdef HAVE_BZ2
+		.dopen = (zf_dopen_t)BZ2_bzdopen,
+		.open = (zf_open_t)BZ2_bzopen,
+		.init = (zf_init_t)NULL,
+		.close = (zf_close_t)zf_bz2w_close,
+		.read = (zf_read_t)BZ2_bzread,
+		.write = (zf_write_t)BZ2_bzwrite,
+		.seek = (zf_seek_t)NULL
+		#endif
+	},
+	/* zstd */
+	{
+		.ext = ".zst",
+		.flags = ZF_FN_WR,
+		#ifdef HAVE_ZSTD
+		.dopen = (zf_dopen_t)zf_zstw_dopen,
+		.open = (zf_open_t)zf_zstw_open,
+		.init = (zf_init_t)NULL,
+		.close = (zf_close_t)zf_zstw_close,
+		.read = (zf_read_t)NULL,
+		.write = (zf_write_t)zf_zstw_write,
+		.seek = (zf_seek_t)NULL
+		#endif
+	},
+	{
+		.ext = ".zst",
+		.flags = ZF_FN_RD,
+		#ifdef HAVE_ZSTD
+		.dopen = (zf_dopen_t)zf_zstr_dopen,
+		.open = (zf_open_t)NULL,
+		.init = (zf_init_t)NULL,
+		.close = (zf_close_t)zf_zstr_close,
+		.read = (zf_read_t)zf_zstr_read,
+		.write = (zf_write_t)NULL,
+		.seek = (zf_seek_t)zf_zstr_seek
+		#endif
+	},
+	/* xz / lzma */
+	{
+		.ext = ".xz",
+		.flags = ZF_FN_WR,
+		#ifdef HAVE_LZMA
+		.dopen = (zf_dopen_t)zf_xzw_dopen,
+		.open = (zf_open_t)zf_xzw_open,
+		.init = (zf_init_t)NULL,
+		.close = (zf_close_t)zf_xzw_close,
+		.read = (zf_read_t)NULL,
+		.write = (zf_write_t)zf_xzw_write,
+		.seek = (zf_seek_t)NULL
+		#endif
+	},
+	{
+		.ext = ".xz",
+		.flags = ZF_FN_RD,
+		#ifdef HAVE_LZMA
+		.dopen = (zf_dopen_t)zf_xzr_dopen,
+		.open = (zf_open_t)NULL,
+		.init = (zf_init_t)NULL,
+		.close = (zf_close_t)zf_xzr_close,
+		.read = (zf_read_t)zf_xzr_read,
+		.write = (zf_write_t)NULL,
+		.seek = (zf_seek_t)NULL
+		#endif
+	},
+	{
+		.ext = ".lzma",
+		.flags = ZF_FN_WR,
+		#ifdef HAVE_LZMA
+		.dopen = (zf_dopen_t)zf_lzmaw_dopen,
+		.open = (zf_open_t)zf_lzmaw_open,
+		.init = (zf_init_t)NULL,
+		.close = (zf_close_t)zf_xzw_close,
+		.read = (zf_read_t)NULL,
+		.write = (zf_write_t)zf_xzw_write,
+		.seek = (zf_seek_t)NULL
+		#endif
+	},
+	{
+		.ext = ".lzma",
+		.flags = ZF_FN_RD,
+		#ifdef HAVE_LZMA
+		.dopen = (zf_dopen_t)zf_xzr_dopen,
+		.open = (zf_open_t)NULL,
+		.init = (zf_init_t)NULL,
+		.close = (zf_close_t)zf_xzr_close,
+		.read = (zf_read_t)zf_xzr_read,
+		.write = (zf_write_t)NULL,
+		.seek = (zf_seek_t)NULL
+		#endif
+	},
+	/* lz4 */
+	{
+		.ext = ".lz4",
+		.flags = ZF_FN_WR,
+		#ifdef HAVE_LZ4
+		.dopen = (zf_dopen_t)zf_lz4w_dopen,
+		.open = (zf_open_t)zf_lz4w_open,
+		.init = (zf_init_t)NULL,
+		.close = (zf_close_t)zf_lz4w_close,
+		.read = (zf_read_t)NULL,
+		.write = (zf_write_t)zf_lz4w_write,
+		.seek = (zf_seek_t)NULL
+		#endif
+	},
+	{
+		.ext = ".lz4",
+		.flags = ZF_FN_RD,
+		#ifdef HAVE_LZ4
+		.dopen = (zf_dopen_t)zf_lz4r_dopen,
+		.open = (zf_open_t)NULL,
+		.init = (zf_init_t)NULL,
+		.close = (zf_close_t)zf_lz4r_close,
+		.read = (zf_read_t)zf_lz4r_read,
+		.write = (zf_write_t)NULL,
+		.seek = (zf_seek_t)NULL
+		#endif
+	},
+	/* other unsupported formats */
+	{ .ext = ".lz", .flags = ZF_FN_RD | ZF_FN_WR },
+	{ .ext = ".z", .flags = ZF_FN_RD | ZF_FN_WR },
+	/* default (must be the last, matches any path) */
+	{
+		.ext = "",
+		.flags = ZF_FN_RD | ZF_FN_WR,
+		.dopen = (zf_dopen_t)zf_raw_dopen,
+		.open = (zf_open_t)zf_raw_open,
+		.init = (zf_init_t)NULL,
+		.close = (zf_close_t)zf_raw_close,
+		.read = (zf_read_t)zf_raw_read,
+		.write = (zf_write_t)zf_raw_write,
+		.seek = (zf_seek_t)zf_raw_seek,
+		.map = (zf_map_t)zf_raw_map
+	}
+};
+
+/**
+ * @fn zf_strndup
+ */
+static
+char *zf_strndup(
+	char const *str,
+	uint64_t len)
+{
+	char *s = (char *)malloc(len + 1);
+	if(s == NULL) { return(NULL); }
+	memcpy(s, str, len);
+	s[len] = '\0';
+	return(s);
+}
+
+/**
+ * @fn zf_parse_size
+ * @brief parse number with an optional K / M / G suffix
+ */
+static
+uint64_t zf_parse_size(
+	char const *str)
+{
+	char *p;
+	uint64_t size = strtoull(str, &p, 10);
+	switch(*p) {
+		case 'G': case 'g': size <<= 10;
+		case 'M': case 'm': size <<= 10;
+		case 'K': case 'k': size <<= 10;
+		default: break;
+	}
+	return(size);
+}
+
+/**
+ * @fn zf_parse_engine
+ * @brief deflate engine name to ZF_GZENG_*, -1 if unknown
+ */
+static
+int zf_parse_engine(
+	char const *str,
+	uint64_t len)
+{
+	char const *names[ZF_GZENG_CNT] = { "auto", "zlib", "libdeflate", "isal", "zlib-ng" };
+	for(int i = 0; i < ZF_GZENG_CNT; i++) {
+		if(strlen(names[i]) == len && strncmp(str, names[i], len) == 0) {
+			return(i);
+		}
+	}
+	return(-1);
+}
+
+/**
+ * @fn zf_gzeng_avail
+ * @brief nonzero if the deflate engine was found at configure time (ZF_GZENG_AUTO always is)
+ */
+static
+int zf_gzeng_avail(
+	int eng)
+{
+#ifdef HAVE_Z
+	return(eng == ZF_GZENG_AUTO || (eng > ZF_GZENG_AUTO && eng < ZF_GZENG_CNT && zf_gzeng_table[eng].inflate != NULL));
+#else
+	return(eng == ZF_GZENG_AUTO);
+#endif
+}
+
+/**
+ * @fn zf_parse_params
+ * @brief parse comma-separated options after `@' in the mode string;
+ * a number for the number of threads (all the cores if nothing follows `@'),
+ * "gzi" for BGZF index, "idx" / "idx=<span>" for gzip random access index,
+ * "long" / "long=<window log>" for zstd long distance matching,
+ * "eng=<name>" for deflate engine, "ra" / "wb" for background read-ahead / write-behind,
+ * and "mmap" for mapping uncompressed files
+ */
+static
+struct zf_params_s zf_parse_params(
+	char const *str)
+{
+	struct zf_params_s params = { 0 };
+	params.bufsize = ZF_BUF_SIZE;
+	params.align = ZF_BUF_ALIGN;
+	char const *eng = getenv("ZF_GZ_ENGINE");
+	params.eng = (eng != NULL) ? zf_parse_engine(eng, strlen(eng)) : ZF_GZENG_AUTO;
+	if(str == NULL) {
+		return(params);			/* `@' not found */
+	}
+
+	for(char const *p = str + 1; *p != '\0'; p += (*p == ',')) {
+		char const *q = p;
+		while(*q != '\0' && *q != ',') { q++; }
+
+		if(*p >= '0' && *p <= '9') {
+			params.nth = atoi(p);
+		} else if(q - p == 3 && strncmp(p, "gzi", 3) == 0) {
+			params.gzi = 1;
+		} else if(q - p == 3 && strncmp(p, "idx", 3) == 0) {
+			params.span = ZF_GZIDX_SPAN;
+		} else if(strncmp(p, "idx=", 4) == 0) {
+			params.span = zf_parse_size(p + 4);
+		} else if(q - p == 4 && strncmp(p, "long", 4) == 0) {
+			params.wlog = ZF_ZST_LONG_WLOG;
+		} else if(strncmp(p, "long=", 5) == 0) {
+			params.wlog = atoi(p + 5);
+		} else if(strncmp(p, "eng=", 4) == 0) {
+			params.eng = zf_parse_engine(p + 4, q - p - 4);
+		} else if(q - p == 2 && strncmp(p, "ra", 2) == 0) {
+			params.ra = ZF_RA_DEPTH;
+		} else if(strncmp(p, "ra=", 3) == 0) {
+			params.ra = atoi(p + 3);
+		} else if(q - p == 4 && strncmp(p, "mmap", 4) == 0) {
+			params.mmap = 1;
+		} else if(q - p == 4 && strncmp(p, "huge", 4) == 0) {
+			params.huge = 1;
+		} else if(strncmp(p, "buf=", 4) == 0) {
+			params.bufsize = zf_parse_size(p + 4);
+		} else if(strncmp(p, "align=", 6) == 0) {
+			params.align = zf_parse_size(p + 6);
+		} else if(q - p == 2 && strncmp(p, "wb", 2) == 0) {
+			params.wb = ZF_WB_SIZE;
+		} else if(strncmp(p, "wb=", 3) == 0) {
+			params.wb = zf_parse_size(p + 3);
+		} else if(q - p == 5 && strncmp(p, "uring", 5) == 0) {
+			params.uring = ZF_URING_DEPTH;
+		} else if(strncmp(p, "uring=", 6) == 0) {
+			params.uring = atoi(p + 6);
+		}
+		p = q;
+	}
+
+	if(str[1] == '\0') {
+		long ncores = sysconf(_SC_NPROCESSORS_ONLN);
+		params.nth = (ncores > 0) ? (int)ncores : 1;
+	}
+
+	/* buffer size in range, alignment to power of two */
+	params.bufsize = (params.bufsize < ZF_BUF_SIZE_MIN) ? ZF_BUF_SIZE_MIN
+		: (params.bufsize > ZF_BUF_SIZE_MAX) ? ZF_BUF_SIZE_MAX
+		: params.bufsize;
+	uint64_t page = sysconf(_SC_PAGESIZE), align = ZF_BUF_ALIGN;
+	while(align < params.align && align < page) { align *= 2; }
+	params.align = align;
+	return(params);
+}
+
+/* read-ahead */
+
+/**
+ * @struct zf_ra_s
+ * @brief ring of buffers filled by a background thread with the output of the codec; the thread is
+ * halted (with the ring kept) while the caller touches the codec, e.g. on seek.
+ */
+struct zf_ra_s {
+	pthread_mutex_t lock;
+	pthread_cond_t cv;
+	pthread_t th;
+	int running, stop;
+	int fin;						/* the codec reached the end */
+	uint64_t head, tail;			/* filled and consumed counts */
+	uint64_t nslots;
+	size_t pos;						/* consumed bytes in the slot at tail */
+	size_t *lens;
+	struct zf_buf_s *bufs;			/* allocated the same way as the handle's buffer */
+	struct zf_intl_s *fio;
+};
+
+/**
+ * @fn zf_ra_fill
+ */
+static
+void *zf_ra_fill(
+	void *_ra)
+{
+	struct zf_ra_s *ra = (struct zf_ra_s *)_ra;
+	struct zf_intl_s *fio = ra->fio;
+
+	pthread_mutex_lock(&ra->lock);
+	while(ra->fin == 0) {
+		while(ra->head - ra->tail == ra->nslots && ra->stop == 0) {
+			pthread_cond_wait(&ra->cv, &ra->lock);
+		}
+		if(ra->stop != 0) { break; }
+		uint64_t i = ra->head % ra->nslots;
+		pthread_mutex_unlock(&ra->lock);
+
+		size_t len = fio->fn.read(fio->fp, ra->bufs[i].ptr, ra->bufs[i].size);
+
+		pthread_mutex_lock(&ra->lock);
+		ra->lens[i] = len;
+		ra->head++;
+		ra->fin = (len < (uint64_t)ra->bufs[i].size);
+		pthread_cond_broadcast(&ra->cv);
+	}
+	pthread_mutex_unlock(&ra->lock);
+	return(NULL);
+}
+
+/**
+ * @fn zf_ra_resume
+ */
+static
+int zf_ra_resume(
+	struct zf_ra_s *ra)
+{
+	if(ra == NULL || ra->running != 0) { return(0); }
+	ra->stop = 0;
+	ra->running = (pthread_create(&ra->th, NULL, zf_ra_fill, (void *)ra) == 0);
+	return(ra->running ? 0 : -1);
+}
+
+/**
+ * @fn zf_ra_halt
+ * @brief stop the thread after the current buffer, the filled ones are kept
+ */
+static
+void zf_ra_halt(
+	struct zf_ra_s *ra)
+{
+	if(ra == NULL || ra->running == 0) { return; }
+	pthread_mutex_lock(&ra->lock);
+	ra->stop = 1;
+	pthread_cond_broadcast(&ra->cv);
+	pthread_mutex_unlock(&ra->lock);
+	pthread_join(ra->th, NULL);
+	ra->running = 0;
+	return;
+}
+
+/**
+ * @fn zf_ra_clear
+ * @brief discard the filled buffers; the thread must be halted
+ */
+static
+void zf_ra_clear(
+	struct zf_ra_s *ra)
+{
+	if(ra == NULL) { return; }
+	ra->head = ra->tail = 0;
+	ra->pos = 0;
+	ra->fin = 0;
+	return;
+}
+
+/**
+ * @fn zf_ra_destroy
+ */
+static
+void zf_ra_destroy(
+	struct zf_ra_s *ra)
+{
+	if(ra == NULL) { return; }
+	zf_ra_halt(ra);
+	for(uint64_t i = 0; ra->bufs != NULL && i < ra->nslots; i++) {
+		zf_buf_free(&ra->bufs[i]);
+	}
+	pthread_cond_destroy(&ra->cv);
+	pthread_mutex_destroy(&ra->lock);
+	free(ra->bufs);
+	free(ra->lens);
+	free(ra);
+	return;
+}
+
+/**
+ * @fn zf_ra_init
+ * @brief start reading ahead depth buffers of the handle's buffer size
+ */
+static
+struct zf_ra_s *zf_ra_init(
+	struct zf_intl_s *fio,
+	int depth)
+{
+	struct zf_ra_s *ra = (struct zf_ra_s *)calloc(1, sizeof(struct zf_ra_s));
+	if(ra == NULL) { return(NULL); }
+	ra->fio = fio;
+	ra->nslots = (depth < 2) ? 2 : depth;
+	ra->lens = (size_t *)calloc(ra->nslots, sizeof(size_t));
+	ra->bufs = (struct zf_buf_s *)calloc(ra->nslots, sizeof(struct zf_buf_s));
+	pthread_mutex_init(&ra->lock, NULL);
+	pthread_cond_init(&ra->cv, NULL);
+	if(ra->lens == NULL || ra->bufs == NULL) {
+		zf_ra_destroy(ra);
+		return(NULL);
+	}
+	for(uint64_t i = 0; i < ra->nslots; i++) {
+		if(zf_buf_alloc(&ra->bufs[i], &fio->params, fio->params.bufsize, 0) != 0) {
+			zf_ra_destroy(ra);
+			return(NULL);
+		}
+	}
+	if(zf_ra_resume(ra) != 0) {
+		zf_ra_destroy(ra);
+		return(NULL);
+	}
+	return(ra);
+}
+
+/**
+ * @fn zf_ra_read
+ * @brief copy out of the ring, short only at the end of the stream (same as the codecs)
+ */
+static
+size_t zf_ra_read(
+	struct zf_ra_s *ra,
+	uint8_t *ptr,
+	size_t len)
+{
+	size_t copied_size = 0;
+	while(copied_size < len) {
+		pthread_mutex_lock(&ra->lock);
+		while(ra->tail == ra->head && ra->fin == 0 && ra->running != 0) {
+			pthread_cond_wait(&ra->cv, &ra->lock);
+		}
+		int empty = (ra->tail == ra->head);
+		pthread_mutex_unlock(&ra->lock);
+		if(empty) { break; }
+
+		uint64_t i = ra->tail % ra->nslots;
+		size_t copy_size = (len - copied_size < ra->lens[i] - ra->pos) ? len - copied_size : ra->lens[i] - ra->pos;
+		memcpy(ptr + copied_size, &ra->bufs[i].ptr[ra->pos], copy_size);
+		copied_size += copy_size;
+		ra->pos += copy_size;
+
+		if(ra->pos == ra->lens[i]) {
+			pthread_mutex_lock(&ra->lock);
+			ra->tail++;
+			ra->pos = 0;
+			pthread_cond_broadcast(&ra->cv);
+			pthread_mutex_unlock(&ra->lock);
+		}
+	}
+	return(copied_size);
+}
+
+/**
+ * @fn zf_ra_swap
+ * @brief exchange buf with the filled slot at tail instead of copying it out; returns the number of bytes in buf,
+ * or -1 if the slot is not interchangeable (partially consumed or of another size) or the ring ended
+ */
+static
+int64_t zf_ra_swap(
+	struct zf_ra_s *ra,
+	struct zf_buf_s *buf)
+{
+	pthread_mutex_lock(&ra->lock);
+	while(ra->tail == ra->head && ra->fin == 0 && ra->running != 0) {
+		pthread_cond_wait(&ra->cv, &ra->lock);
+	}
+	uint64_t i = ra->tail % ra->nslots;
+	if(ra->tail == ra->head || ra->pos != 0 || ra->bufs[i].size != buf->size) {
+		pthread_mutex_unlock(&ra->lock);
+		return(-1);
+	}
+	struct zf_buf_s tmp = ra->bufs[i];
+	ra->bufs[i] = *buf;
+	*buf = tmp;
+	int64_t len = ra->lens[i];
+	ra->tail++;
+	pthread_cond_broadcast(&ra->cv);
+	pthread_mutex_unlock(&ra->lock);
+	return(len);
+}
+
+/**
+ * @fn zf_fill
+ * @brief read from the codec, or from the read-ahead ring if enabled
+ */
+static inline
+size_t zf_fill(
+	struct zf_intl_s *fio,
+	void *ptr,
+	size_t len)
+{
+	return((fio->ra != NULL)
+		? zf_ra_read(fio->ra, (uint8_t *)ptr, len)
+		: fio->fn.read(fio->fp, ptr, len));
+}
+
+/* write-behind */
+
+/**
+ * @struct zf_wb_s
+ * @brief ring of buffers passed to the codec on a background thread; the producer is blocked while
+ * all the slots are queued, which bounds the memory. errors are reported on zfclose.
+ */
+struct zf_wb_s {
+	pthread_mutex_t lock;
+	pthread_cond_t cv;
+	pthread_t th;
+	int running;
+	int fin;						/* no more buffers will be queued */
+	int err;
+	uint64_t head, tail;			/* queued and written counts */
+	uint64_t nslots;
+	size_t *lens;
+	struct zf_buf_s *bufs;			/* allocated the same way as the handle's buffer */
+	struct zf_intl_s *fio;
+};
+
+/**
+ * @fn zf_wb_flush
+ */
+static
+void *zf_wb_flush(
+	void *_wb)
+{
+	struct zf_wb_s *wb = (struct zf_wb_s *)_wb;
+	struct zf_intl_s *fio = wb->fio;
+
+	pthread_mutex_lock(&wb->lock);
+	while(1) {
+		while(wb->tail == wb->head && wb->fin == 0) {
+			pthread_cond_wait(&wb->cv, &wb->lock);
+		}
+		if(wb->tail == wb->head) { break; }
+		uint64_t i = wb->tail % wb->nslots;
+		int err = wb->err;
+		pthread_mutex_unlock(&wb->lock);
+
+		/* the rest is discarded after an error */
+		err = err || fio->fn.write(fio->fp, wb->bufs[i].ptr, wb->lens[i]) != wb->lens[i];
+
+		pthread_mutex_lock(&wb->lock);
+		wb->err = err;
+		wb->tail++;
+		pthread_cond_broadcast(&wb->cv);
+	}
+	pthread_mutex_unlock(&wb->lock);
+	return(NULL);
+}
+
+/**
+ * @fn zf_wb_destroy
+ * @brief write out the queued buffers, returns nonzero if any of them failed
+ */
+static
+int zf_wb_destroy(
+	struct zf_wb_s *wb)
+{
+	if(wb == NULL) { return(0); }
+	pthread_mutex_lock(&wb->lock);
+	wb->fin = 1;
+	pthread_cond_broadcast(&wb->cv);
+	pthread_mutex_unlock(&wb->lock);
+	if(wb->running != 0) {
+		pthread_join(wb->th, NULL);
+	}
+
+	int err = wb->err;
+	for(uint64_t i = 0; wb->bufs != NULL && i < wb->nslots; i++) {
+		zf_buf_free(&wb->bufs[i]);
+	}
+	pthread_cond_destroy(&wb->cv);
+	pthread_mutex_destroy(&wb->lock);
+	free(wb->bufs);
+	free(wb->lens);
+	free(wb);
+	return(err);
+}
+
+/**
+ * @fn zf_wb_init
+ * @brief start the thread with slots of the handle's buffer size, up to size bytes in total
+ */
+static
+struct zf_wb_s *zf_wb_init(
+	struct zf_intl_s *fio,
+	uint64_t size)
+{
+	struct zf_wb_s *wb = (struct zf_wb_s *)calloc(1, sizeof(struct zf_wb_s));
+	if(wb == NULL) { return(NULL); }
+	wb->fio = fio;
+	wb->nslots = (size < 2 * fio->params.bufsize) ? 2 : size / fio->params.bufsize;
+	wb->lens = (size_t *)calloc(wb->nslots, sizeof(size_t));
+	wb->bufs = (struct zf_buf_s *)calloc(wb->nslots, sizeof(struct zf_buf_s));
+	pthread_mutex_init(&wb->lock, NULL);
+	pthread_cond_init(&wb->cv, NULL);
+	if(wb->lens == NULL || wb->bufs == NULL) {
+		zf_wb_destroy(wb);
+		return(NULL);
+	}
+	for(uint64_t i = 0; i < wb->nslots; i++) {
+		if(zf_buf_alloc(&wb->bufs[i], &fio->params, fio->params.bufsize, 0) != 0) {
+			zf_wb_destroy(wb);
+			return(NULL);
+		}
+	}
+	if((wb->running = (pthread_create(&wb->th, NULL, zf_wb_flush, (void *)wb) == 0)) == 0) {
+		zf_wb_destroy(wb);
+		return(NULL);
+	}
+	return(wb);
+}
+
+/**
+ * @fn zf_wb_write
+ * @brief copy to the free slots, blocks while all of them are queued.
+ * returns short if a preceding write failed.
+ */
+static
+size_t zf_wb_write(
+	struct zf_wb_s *wb,
+	uint8_t const *ptr,
+	size_t len)
+{
+	size_t copied_size = 0;
+	while(copied_size < len) {
+		pthread_mutex_lock(&wb->lock);
+		while(wb->head - wb->tail == wb->nslots && wb->err == 0) {
+			pthread_cond_wait(&wb->cv, &wb->lock);
+		}
+		int err = wb->err;
+		pthread_mutex_unlock(&wb->lock);
+		if(err != 0) { break; }
+
+		uint64_t i = wb->head % wb->nslots;
+		size_t copy_size = (len - copied_size < (uint64_t)wb->bufs[i].size) ? len - copied_size : (uint64_t)wb->bufs[i].size;
+		memcpy(wb->bufs[i].ptr, ptr + copied_size, copy_size);
+		wb->lens[i] = copy_size;
+		copied_size += copy_size;
+
+		pthread_mutex_lock(&wb->lock);
+		wb->head++;
+		pthread_cond_broadcast(&wb->cv);
+		pthread_mutex_unlock(&wb->lock);
+	}
+	return(copied_size);
+}
+
+/**
+ * @fn zf_wb_swap
+ * @brief queue buf by exchanging it with a free slot instead of copying; returns len, 0 if a preceding write failed,
+ * or -1 if the slots are not interchangeable with buf
+ */
+static
+int64_t zf_wb_swap(
+	struct zf_wb_s *wb,
+	struct zf_buf_s *buf,
+	size_t len)
+{
+	if(wb->bufs[0].size != buf->size) { return(-1); }
+	pthread_mutex_lock(&wb->lock);
+	while(wb->head - wb->tail == wb->nslots && wb->err == 0) {
+		pthread_cond_wait(&wb->cv, &wb->lock);
+	}
+	if(wb->err != 0) {
+		pthread_mutex_unlock(&wb->lock);
+		return(0);
+	}
+	uint64_t i = wb->head % wb->nslots;
+	struct zf_buf_s tmp = wb->bufs[i];
+	wb->bufs[i] = *buf;
+	*buf = tmp;
+	wb->lens[i] = len;
+	wb->head++;
+	pthread_cond_broadcast(&wb->cv);
+	pthread_mutex_unlock(&wb->lock);
+	return(len);
+}
+
+/**
+ * @fn zf_flush
+ * @brief write to the codec, or queue to the write-behind thread if enabled; failure is kept for zfclose.
+ * the buffer of the handle is queued as is and replaced with a free one, so callers reload fio->buf.
+ */
+static inline
+size_t zf_flush(
+	struct zf_intl_s *fio,
+	void *ptr,
+	size_t len)
+{
+	if(fio->wb != NULL && ptr == (void *)fio->buf && fio->buf == fio->mem.ptr && len != 0) {
+		int64_t written = zf_wb_swap(fio->wb, &fio->mem, len);
+		if(written >= 0) {
+			fio->buf = fio->mem.ptr;
+			fio->eof |= ((size_t)written != len);
+			return(written);
+		}
+	}
+	size_t written = (fio->wb != NULL)
+		? zf_wb_write(fio->wb, (uint8_t const *)ptr, len)
+		: fio->fn.write(fio->fp, ptr, len);
+	fio->eof |= (written != len);
+	return(written);
+}
+
+/* asynchronous requests */
+
+/**
+ * @struct zf_aio_req_s
+ */
+struct zf_aio_req_s {
+	int write;
+	int state;						/* 0: queued, 1: completed, 2: collected */
+	void *ptr;
+	size_t len;						/* requested, then transferred */
+};
+
+/**
+ * @struct zf_aio_s
+ * @brief requests of zfread_async / zfwrite_async, run in the order of submission on a background thread with
+ * zfread / zfwrite; reqs[i] has the token base + i, and the collected ones at the head are dropped on submission
+ */
+struct zf_aio_s {
+	pthread_mutex_t lock;
+	pthread_cond_t cv;				/* signaled on submission and completion */
+	pthread_t th;
+	int running, stop;
+	int efd;						/* eventfd counting the completions, -1 if not available */
+	int64_t base;
+	uint64_t cnt, max;
+	uint64_t next;					/* index of the request to run next */
+	struct zf_aio_req_s *reqs;
+	zf_t *fp;
+};
+
+/**
+ * @fn zf_aio_run
+ */
+static
+void *zf_aio_run(
+	void *_aio)
+{
+	struct zf_aio_s *aio = (struct zf_aio_s *)_aio;
+
+	pthread_mutex_lock(&aio->lock);
+	while(1) {
+		while(aio->next == aio->cnt && aio->stop == 0) {
+			pthread_cond_wait(&aio->cv, &aio->lock);
+		}
+		if(aio->next == aio->cnt) { break; }
+		struct zf_aio_req_s req = aio->reqs[aio->next];
+		pthread_mutex_unlock(&aio->lock);
+
+		size_t len = (req.write != 0) ? zfwrite(aio->fp, req.ptr, req.len) : zfread(aio->fp, req.ptr, req.len);
+
+		pthread_mutex_lock(&aio->lock);
+		aio->reqs[aio->next].len = len;
+		aio->reqs[aio->next].state = 1;
+		aio->next++;
+		pthread_cond_broadcast(&aio->cv);
+		if(aio->efd >= 0) {
+			uint64_t one = 1;
+			ssize_t written = write(aio->efd, &one, sizeof(uint64_t));
+			(void)written;			/* the counter does not overflow in practice */
+		}
+	}
+	pthread_mutex_unlock(&aio->lock);
+	return(NULL);
+}
+
+/**
+ * @fn zf_aio_destroy
+ * @brief run the requests left, then stop the thread
+ */
+static
+void zf_aio_destroy(
+	struct zf_aio_s *aio)
+{
+	if(aio == NULL) { return; }
+	pthread_mutex_lock(&aio->lock);
+	aio->stop = 1;
+	pthread_cond_broadcast(&aio->cv);
+	pthread_mutex_unlock(&aio->lock);
+	if(aio->running != 0) {
+		pthread_join(aio->th, NULL);
+	}
+
+	if(aio->efd >= 0) { close(aio->efd); }
+	pthread_cond_destroy(&aio->cv);
+	pthread_mutex_destroy(&aio->lock);
+	free(aio->reqs);
+	free(aio);
+	return;
+}
+
+/**
+ * @fn zf_aio_init
+ */
+static
+struct zf_aio_s *zf_aio_init(
+	zf_t *fp)
+{
+	struct zf_aio_s *aio = (struct zf_aio_s *)calloc(1, sizeof(struct zf_aio_s));
+	if(aio == NULL) { return(NULL); }
+	aio->fp = fp;
+	aio->base = 1;					/* tokens are positive */
+	#ifdef __linux__
+	aio->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	#else
+	aio->efd = -1;
+	#endif
+	pthread_mutex_init(&aio->lock, NULL);
+	pthread_cond_init(&aio->cv, NULL);
+	if((aio->running = (pthread_create(&aio->th, NULL, zf_aio_run, (void *)aio) == 0)) == 0) {
+		zf_aio_destroy(aio);
+		return(NULL);
+	}
+	return(aio);
+}
+
+/**
+ * @fn zf_aio_submit
+ * @brief returns the token, -1 if failed
+ */
+static
+int64_t zf_aio_submit(
+	struct zf_aio_s *aio,
+	int write,
+	void *ptr,
+	size_t len)
+{
+	pthread_mutex_lock(&aio->lock);
+	uint64_t drop = 0;
+	while(drop < aio->next && aio->reqs[drop].state == 2) { drop++; }
+	if(drop > 0) {
+		memmove(aio->reqs, &aio->reqs[drop], (aio->cnt - drop) * sizeof(struct zf_aio_req_s));
+		aio->cnt -= drop;
+		aio->next -= drop;
+		aio->base += drop;
+	}
+	if(aio->cnt == aio->max) {
+		uint64_t max = (aio->max < 16) ? 16 : 2 * aio->max;
+		struct zf_aio_req_s *reqs = (struct zf_aio_req_s *)realloc(aio->reqs, max * sizeof(struct zf_aio_req_s));
+		if(reqs == NULL) {
+			pthread_mutex_unlock(&aio->lock);
+			return(-1);
+		}
+		aio->reqs = reqs;
+		aio->max = max;
+	}
+
+	struct zf_aio_req_s *req = &aio->reqs[aio->cnt++];
+	req->write = write;
+	req->state = 0;
+	req->ptr = ptr;
+	req->len = len;
+	int64_t token = aio->base + aio->cnt - 1;
+	pthread_cond_broadcast(&aio->cv);
+	pthread_mutex_unlock(&aio->lock);
+	return(token);
+}
+
+/**
+ * @fn zf_aio_collect
+ * @brief 1 if completed (the result is collected), 0 if not yet, and -1 if the token is unknown or already collected
+ */
+static
+int zf_aio_collect(
+	struct zf_aio_s *aio,
+	int64_t token,
+	size_t *len,
+	int wait)
+{
+	if(aio == NULL) { return(-1); }
+
+	int ret = -1;
+	pthread_mutex_lock(&aio->lock);
+	if(token >= aio->base && token < aio->base + (int64_t)aio->cnt) {
+		while(wait != 0 && aio->reqs[token - aio->base].state == 0) {
+			pthread_cond_wait(&aio->cv, &aio->lock);
+		}
+		struct zf_aio_req_s *req = &aio->reqs[token - aio->base];
+		ret = (req->state == 0) ? 0 : ((req->state == 1) ? 1 : -1);
+		if(ret == 1) {
+			req->state = 2;
+			if(len != NULL) { *len = req->len; }
+		}
+	}
+	pthread_mutex_unlock(&aio->lock);
+	return(ret);
+}
+
+/**
+ * @fn zf_sniff_lzma
+ * @brief .lzma has no magic; the 13-byte header is checked as strictly as xz does for auto-detection:
+ * a valid properties byte, a dictionary size of 2^n or 2^n + 2^(n-1) (or UINT32_MAX),
+ * and the uncompressed size below 256 GB (or unknown)
+ */
+static
+int zf_sniff_lzma(
+	uint8_t const *p,
+	size_t len)
+{
+	if(len < 13 || p[0] >= 9 * 5 * 5) { return(0); }
+
+	uint32_t dict = p[1] | (p[2]<<8) | (p[3]<<16) | ((uint32_t)p[4]<<24);
+	uint32_t d = dict - 1;
+	d |= d>>2; d |= d>>3; d |= d>>4; d |= d>>8; d |= d>>16;
+	if(dict != UINT32_MAX && d + 1 != dict) { return(0); }
+
+	uint64_t usize = 0;
+	for(int i = 0; i < 8; i++) { usize |= (uint64_t)p[5 + i]<<(8 * i); }
+	return(usize == UINT64_MAX || usize < (1ULL<<38));
+}
+
+/**
+ * @fn zf_sniff_ext
+ * @brief determine format from the magic bytes, returns NULL if not compressed (or unknown);
+ * *more is set nonzero if p is shorter than a magic it begins with
+ */
+static
+char const *zf_sniff_ext(
+	uint8_t const *p,
+	size_t len,
+	int *more)
+{
+	static struct { char const *ext; size_t len; uint8_t magic[6]; } const magics[] = {
+		{ ".gz",   3, { 0x1f, 0x8b, 0x08 } },		/* including BGZF */
+		{ ".bz2",  3, { 'B', 'Z', 'h' } },
+		{ ".xz",   6, { 0xfd, '7', 'z', 'X', 'Z', 0x00 } },
+		{ ".zst",  4, { 0x28, 0xb5, 0x2f, 0xfd } },
+		{ ".lz4",  4, { 0x04, 0x22, 0x4d, 0x18 } }
+	};
+	*more = 0;
+	for(uint64_t i = 0; i < sizeof(magics) / sizeof(magics[0]); i++) {
+		size_t cmp_len = (len < magics[i].len) ? len : magics[i].len;
+		if(memcmp(p, magics[i].magic, cmp_len) != 0) { continue; }
+		if(cmp_len == magics[i].len) {
+			return(magics[i].ext);
+		}
+		*more |= (len > 0);
+	}
+	return(zf_sniff_lzma(p, len) ? ".lzma" : NULL);
+}
+
+/* buffer */
+
+/**
+ * @fn zf_buf_grow
+ * @brief enlarge the buffer to keep at least len bytes (read mode); the bytes left are moved to the head.
+ * the new one is a mirrored ring if available, as peeks and pushbacks this long are likely to continue.
+ */
+static
+int zf_buf_grow(
+	struct zf_intl_s *fio,
+	uint64_t len)
+{
+	int64_t size = fio->size;
+	while((uint64_t)size < len + ZF_BUF_SLACK) { size *= 2; }
+
+	struct zf_buf_s prev = fio->mem;
+	if(zf_buf_alloc(&fio->mem, &fio->params, size, 1) != 0) {
+		return(-1);
+	}
+	memcpy(fio->mem.ptr, &fio->buf[fio->curr], fio->end - fio->curr);
+	zf_buf_free(&prev);
+	fio->buf = fio->mem.ptr;
+	fio->size = fio->mem.size;
+	fio->valid = (fio->valid > fio->curr) ? fio->valid - fio->curr : 0;
+	fio->end -= fio->curr;
+	fio->curr = 0;
+	memset((void *)&fio->buf[fio->end], 0, ZF_BUF_PADDING);
+	return(0);
+}
+
+/**
+ * @fn zf_refill
+ * @brief append to the bytes left in buf (read mode), with ZF_BUF_SLACK bytes kept free in the ring; returns
+ * the number of bytes read. the bytes left are moved to the head if buf is not mirrored. ZF_BUF_PADDING bytes after the end are zeroed.
+ */
+static
+size_t zf_refill(
+	struct zf_intl_s *fio)
+{
+	if(fio->mem.mirror != 0) {
+		/* the same bytes appear size bytes ahead */
+		if(fio->curr >= fio->size) {
+			fio->curr -= fio->size;
+			fio->end -= fio->size;
+			fio->valid -= fio->size;
+		}
+	} else if(fio->curr > 0) {
+		/* move existing elements to the head of the buffer */
+		memmove((void *)fio->buf, (void *)&fio->buf[fio->curr], fio->end - fio->curr);
+		fio->valid = (fio->valid > fio->curr) ? fio->valid - fio->curr : 0;
+		fio->end -= fio->curr;
+		fio->curr = 0;
+	}
+
+	/* take the next read-ahead buffer as is if nothing is left */
+	if(fio->ra != NULL && fio->mem.mirror == 0 && fio->buf == fio->mem.ptr && fio->end == 0) {
+		int64_t read_size = zf_ra_swap(fio->ra, &fio->mem);
+		if(read_size >= 0) {
+			fio->buf = fio->mem.ptr;
+			fio->eof = (read_size < fio->size);
+			fio->valid = 0;
+			fio->end = read_size;
+			fio->pos += read_size;
+			memset((void *)&fio->buf[fio->end], 0, ZF_BUF_PADDING);
+			return(read_size);
+		}
+	}
+
+	int64_t len = (fio->mem.mirror != 0)
+		? fio->size - ZF_BUF_SLACK - (fio->end - fio->curr)
+		: fio->size - fio->end;
+	size_t read_size = 0;
+	if(len > 0) {
+		read_size = zf_fill(fio, (void *)&fio->buf[fio->end], len);
+		fio->eof = (read_size < (uint64_t)len);
+		fio->end += read_size;
+		fio->pos += read_size;
+	}
+	memset((void *)&fio->buf[fio->end], 0, ZF_BUF_PADDING);
+
+	/* the ring holds the last size bytes, less the padding zeroed after the end */
+	if(fio->mem.mirror != 0 && fio->valid < fio->end + ZF_BUF_PADDING - fio->size) {
+		fio->valid = fio->end + ZF_BUF_PADDING - fio->size;
+	}
+	return(read_size);
+}
+
+/**
+ * @fn zf_reserve
+ * @brief make at least len bytes available at buf[curr] unless the input ends (read mode), enlarging the buffer if needed;
+ * returns the number of bytes available
+ */
+static
+size_t zf_reserve(
+	struct zf_intl_s *fio,
+	size_t len)
+{
+	if(fio->eof == 0 && (fio->curr >= fio->end || (uint64_t)(fio->end - fio->curr) < len)) {
+		if(len + ZF_BUF_SLACK > (uint64_t)fio->size) {
+			zf_buf_grow(fio, len);		/* fill as much as possible if failed */
+		}
+		zf_refill(fio);
+	}
+	return((fio->curr < fio->end) ? fio->end - fio->curr : 0);
+}
+
+/**
+ * @fn zf_sniff
+ * @brief examine the head of the input to choose the reader regardless of the extension; regular files are
+ * examined with pread, others (stdin, pipes, and sockets) are read into fio->buf, which the reader takes over in dopen.
+ * the latter are not waited for more than the first read returns, unless it ends in the middle of a magic
+ * (a .lzma header is detected only if it came in whole). returns fn (chosen from the extension) as is
+ * if the format is not known or not supported.
+ */
+static
+struct zf_functions_s const *zf_sniff(
+	struct zf_intl_s *fio,
+	struct zf_functions_s const *fn)
+{
+	off_t base = lseek(fio->fd, 0, SEEK_CUR);
+	size_t len = 0;
+	int more = 1;
+	while(len < ZF_SNIFF_SIZE && more != 0) {
+		ssize_t read_size = (base >= 0)
+			? pread(fio->fd, &fio->buf[len], ZF_SNIFF_SIZE - len, base + len)
+			: read(fio->fd, &fio->buf[len], ZF_SNIFF_SIZE - len);
+		if(read_size < 0 && errno == EINTR) { continue; }
+		if(read_size <= 0) { break; }
+		len += read_size;
+		if(base < 0) { zf_sniff_ext(fio->buf, len, &more); }
+	}
+	if(base < 0) {
+		fio->params.head = fio->buf;
+		fio->params.head_len = len;
+	}
+
+	char const *ext = zf_sniff_ext(fio->buf, len, &more);
+	if(ext == NULL) {
+		return(fn);
+	}
+	for(uint64_t i = 0; i < sizeof(fn_table) / sizeof(struct zf_functions_s); i++) {
+		if((fn_table[i].flags & ZF_FN_RD) == 0 || fn_table[i].dopen == NULL) { continue; }
+		if(strcmp(fn_table[i].ext, ext) == 0) {
+			return(&fn_table[i]);
+		}
+	}
+	return(fn);
+}
+
+/**
+ * @fn zf_map
+ * @brief point buf at the whole content if the codec has it in memory (as if fp reached EOF after filling buf),
+ * or at the internal buffer otherwise; pos is the offset in the uncompressed stream to start from.
+ * the internal buffer is released while mapped, and allocated again if the codec is reopened without the content;
+ * returns -1 if that failed (the handle is left at the end of the file)
+ */
+static
+int zf_map(
+	struct zf_intl_s *fio,
+	int64_t pos)
+{
+	size_t len = 0;
+	uint8_t *map = (fio->fp != NULL && fio->fn.map != NULL) ? fio->fn.map(fio->fp, &len) : NULL;
+	if(map != NULL) {
+		zf_buf_free(&fio->mem);
+		fio->buf = map;
+		fio->size = fio->end = fio->pos = len;
+		fio->curr = pos;
+		fio->valid = 0;
+		fio->eof = 1;
+		return(0);
+	}
+
+	fio->curr = fio->end = fio->valid = 0;
+	fio->pos = pos;
+	fio->eof = 0;
+	if(fio->mem.ptr == NULL && zf_buf_alloc(&fio->mem, &fio->params, fio->params.bufsize, 0) != 0) {
+		fio->buf = NULL;
+		fio->size = 0;
+		fio->eof = 2;
+		return(-1);
+	}
+	fio->buf = fio->mem.ptr;
+	fio->size = fio->mem.size;
+	return(0);
+}
+
+/**
+ * @fn zfopen
+ * @brief open file, similar to fopen / gzopen,
+ * compression format can be explicitly specified adding an extension to `mode', e.g. "w+.bz2".
+ * the number of threads for the parallel codecs can be appended after `@', e.g. "w.gz@8".
+ */
+zf_t *zfopen(
+	char const *path,
+	char const *mode)
+{
+	if(path == NULL || mode == NULL) {
+		return(NULL);
+	}
+
+	/* split mode into "<mode><ext>" and "@<params>" */
+	char const *params_head = strchr(mode, '@');
+	struct zf_params_s params = zf_parse_params(params_head);
+	if(zf_gzeng_avail(params.eng) == 0) {
+		return(NULL);			/* unknown or unavailable deflate engine */
+	}
+
+	/* check length */
+	uint64_t path_len = strlen(path);
+	uint64_t mode_len = (params_head != NULL) ? (uint64_t)(params_head - mode) : strlen(mode);
+	if(path_len == 0 || mode_len == 0) {
+		return(NULL);
+	}
+
+	char *path_dup = strdup(path);
+	char *mode_dup = zf_strndup(mode, mode_len);
+	if(path_dup == NULL || mode_dup == NULL) {
+		goto _zfopen_fail;
+	}
+
+	/* determine format */
+	int req = (mode[0] == 'r') ? ZF_FN_RD : ZF_FN_WR;
+	struct zf_functions_s const *fn = NULL;
+	for(uint64_t i = 0; i < sizeof(fn_table) / sizeof(struct zf_functions_s); i++) {
+		/* skip if the entry does not support the mode */
+		if((fn_table[i].flags & req) == 0) { continue; }
+		if((fn_table[i].flags & ZF_FN_MT) != 0 && params.nth == 0) { continue; }
+
+		uint64_t ext_len = strlen(fn_table[i].ext);
+
+		/* check path */
+		if(path_len >= ext_len && strcmp(path_dup + path_len - ext_len, fn_table[i].ext) == 0) {
+			/* hit */
+			fn = &fn_table[i];
+			path_dup[path_len - ext_len] = '\0';
+			break;
+		}
+
+		/* check mode */
+		if(mode_len >= ext_len && strcmp(mode_dup + mode_len - ext_len, fn_table[i].ext) == 0) {
+			/* hit */
+			fn = &fn_table[i];
+			mode_dup[mode_len - ext_len] = '\0';
+			break;
+		}
+	}
+
+	/* an extension without a reader is left to the default one in read mode, where zf_sniff finds the format from the content */
+	if(fn != NULL && fn->dopen == NULL && req == ZF_FN_RD) {
+		fn = &fn_table[sizeof(fn_table) / sizeof(struct zf_functions_s) - 1];
+		strcpy(path_dup, path);
+		memcpy(mode_dup, mode, mode_len);
+	}
+
+	/* check if functions are available (dopen for read mode and stdout, open for write mode) */
+	if(fn == NULL || fn->dopen == NULL || (req == ZF_FN_WR && fn->open == NULL)) {
+		goto _zfopen_fail;
+	}
+
+	/* malloc context and buffer */
+	struct zf_intl_s *fio = (struct zf_intl_s *)malloc(sizeof(struct zf_intl_s));
+	if(fio == NULL) {
+		goto _zfopen_fail;
+	}
+	memset(fio, 0, sizeof(struct zf_intl_s));
+	fio->fn = *fn;
+	fio->params = params;
+	if(zf_buf_alloc(&fio->mem, &fio->params, fio->params.bufsize, 0) != 0) {
+		free(fio);
+		goto _zfopen_fail;
+	}
+	fio->buf = fio->mem.ptr;
+	fio->size = fio->mem.size;
+	fio->params.path = (strcmp(path, "-") == 0) ? NULL : strdup(path);
+
+	/* open file */
+	if(mode[0] == 'r') {
+		/* read mode, open file with kopen */
+		fio->ko = kopen(path, &fio->fd);
+		if(fio->ko == NULL) {
+			goto _zfopen_finish;
+		}
+		fio->fn = *zf_sniff(fio, fn);
+		fio->fp = fio->fn.dopen(fio->fd, mode_dup, &fio->params);
+	} else {
+		/* write mode, check if stdout is specified */
+		if(strcmp(path, "-") == 0) {
+			fflush(stdout);
+			fio->fd = dup(STDOUT_FILENO);
+			fio->ko = NULL;
+			fio->fp = (fio->fd >= 0) ? fio->fn.dopen(fio->fd, mode_dup, &fio->params) : NULL;
+			if(fio->fp == NULL && fio->fd >= 0) {
+				close(fio->fd);
+			}
+			goto _zfopen_finish;
+		}
+
+		/* open file */
+		fio->fp = fio->fn.open(path, mode_dup, &fio->params);
+		fio->fd = -1;		/* fd is invalid in write mode */
+		fio->ko = NULL;		/* ko is also invalid */
+		goto _zfopen_finish;
+	}
+
+_zfopen_finish:;
+	if(fio->fp == NULL) {
+		/* something wrong occurred */
+		if(fio->ko != NULL) {
+			kclose(fio->ko); fio->ko = NULL;
+		}
+		free((void *)fio->params.path);
+		zf_buf_free(&fio->mem);
+		free(fio); fio = NULL;
+		goto _zfopen_fail;
+	}
+
+	/* everything is going right */
+	fio->path = path_dup;
+	fio->mode = mode_dup;
+	fio->curr = fio->end = fio->pos = fio->valid = 0;
+	if(fio->fn.init != NULL) {
+		if(fio->fn.init(fio->fp) != 0) {
+			zfclose((zf_t *)fio);
+			return(NULL);
+		}
+	}
+
+	if(mode[0] == 'r' && zf_map(fio, 0) != 0) {
+		zfclose((zf_t *)fio);
+		return(NULL);
+	}
+
+	/* decode ahead / compress behind on a background thread if requested (synchronous if the thread is not available) */
+	if(mode[0] == 'r' && fio->params.ra > 0 && fio->eof == 0) {
+		fio->ra = zf_ra_init(fio, fio->params.ra);
+	}
+	if(mode[0] != 'r' && fio->params.wb > 0) {
+		fio->wb = zf_wb_init(fio, fio->params.wb);
+	}
+
+	return((zf_t *)fio);
+
+_zfopen_fail:;
+	free(path_dup);
+	free(mode_dup);
+	return(NULL);
+}
+
+/**
+ * @fn zfclose
+ * @brief close file, similar to fclose / gzclose
+ */
+int zfclose(
+	zf_t *fp)
+{
+	struct zf_intl_s *fio = (struct zf_intl_s *)fp;
+
+	if(fio == NULL) {
+		return(1);
+	}
+
+	/* run the asynchronous requests left */
+	zf_aio_destroy(fio->aio); fio->aio = NULL;
+
+	/* flush if write mode, then wait for the queued buffers */
+	int ret = 0;
+	if(fio->mode[0] != 'r') {
+		zf_flush(fio, (void *)fio->buf, fio->curr);
+		ret |= zf_wb_destroy(fio->wb); fio->wb = NULL;
+		ret |= fio->eof;
+	}
+
+	/* close file */
+	zf_ra_destroy(fio->ra); fio->ra = NULL;
+	ret |= fio->err;
+	if(fio->fp != NULL) {
+		ret |= (fio->fn.close(fio->fp) != 0); fio->fp = NULL;
+	}
+	if(fio->ko != NULL) {
+		kclose(fio->ko); fio->ko = NULL;
+	}
+	free(fio->path); fio->path = NULL;
+	free(fio->mode); fio->mode = NULL;
+	free((void *)fio->params.path); fio->params.path = NULL;
+	zf_buf_free(&fio->mem);
+	free(fio); fio = NULL;
+	return(ret);
+}
+
+/**
+ * @fn zfread
+ * @brief read from file, similar to gzread
+ */
+size_t zfread(
+	zf_t *fp,
+	void *_ptr,
+	size_t len)
+{
+	struct zf_intl_s *fio = (struct zf_intl_s *)fp;
+	uint8_t *ptr = (uint8_t *)_ptr;
+	size_t copied_size = 0;
+
+	/* check eof */
+	if(fio->eof == 2) {
+		return(0);
+	}
+
+	/* if buffer is not empty, copy from buffer */
+	if(fio->curr < fio->end) {
+		uint64_t rem_size = fio->end - fio->curr;
+		uint64_t buf_copy_size = (rem_size < len) ? rem_size : len;
+		memcpy(ptr, (void *)&fio->buf[fio->curr], buf_copy_size);
+
+		/* update */
+		len -= buf_copy_size;
+		ptr += buf_copy_size;
+		fio->curr += buf_copy_size;
+		copied_size += buf_copy_size;
+	}
+
+	/* if fp already reached EOF */
+	if(fio->eof == 1) {
+		fio->eof += (fio->curr == fio->end);
+		return(copied_size);
+	}
+
+	/* issue fread (the buffer is invalidated) */
+	if(len > 0) {
+		uint64_t read_size = zf_fill(fio, ptr, len);
+		fio->eof = 2 * (read_size < len);
+		fio->curr = fio->end = fio->valid = 0;
+		fio->pos += read_size;
+		copied_size += read_size;
+	}
+	return(copied_size);
+}
+
+/**
+ * @fn zfpeek
+ * @brief read len without advancing pointer
+ */
+size_t zfpeek(
+	zf_t *fp,
+	void *_ptr,
+	size_t len)
+{
+	struct zf_intl_s *fio = (struct zf_intl_s *)fp;
+	uint8_t *ptr = (uint8_t *)_ptr;
+
+	/* check eof */
+	if(fio->eof == 2) {
+		return(0);
+	}
+
+	/* make len bytes contiguous at curr (the buffer is enlarged if needed), then copy */
+	size_t avail = zf_reserve(fio, len);
+	size_t copy_size = (avail < len) ? avail : len;
+	memcpy(ptr, (void *)&fio->buf[fio->curr], copy_size);
+	fio->eof += (fio->eof == 1 && copy_size == 0);
+	return(copy_size);
+}
+
+/**
+ * @fn zfreadbuf
+ * @brief make at least min_len bytes available in the buffer unless the file ends, then set *ptr to the
+ * head of them without advancing pointer; returns the number of bytes available, 0 at the end of the file.
+ */
+size_t zfreadbuf(
+	zf_t *fp,
+	uint8_t const **ptr,
+	size_t min_len)
+{
+	struct zf_intl_s *fio = (struct zf_intl_s *)fp;
+	size_t len = zf_reserve(fio, min_len);
+	*ptr = &fio->buf[fio->curr];
+	fio->eof += (fio->eof == 1 && len == 0);
+	return(len);
+}
+
+/**
+ * @fn zfconsume
+ * @brief advance pointer by len (bounded by the bytes available in the buffer), returns the number of bytes skipped
+ */
+size_t zfconsume(
+	zf_t *fp,
+	size_t len)
+{
+	struct zf_intl_s *fio = (struct zf_intl_s *)fp;
+	if(fio->curr >= fio->end) {
+		return(0);
+	}
+
+	uint64_t rem_size = fio->end - fio->curr;
+	uint64_t skip_size = (rem_size < len) ? rem_size : len;
+	fio->curr += skip_size;
+	fio->eof += (fio->eof == 1 && fio->curr == fio->end);
+	return(skip_size);
+}
+
+/**
+ * @fn zfwrite
+ * @brief write to file, similar to gzwrite
+ */
+size_t zfwrite(
+	zf_t *fp,
+	void *ptr,
+	size_t len)
+{
+	struct zf_intl_s *fio = (struct zf_intl_s *)fp;
+
+	/* small ones are gathered in the buffer */
+	if((int64_t)len < fio->size - fio->curr) {
+		memcpy(&fio->buf[fio->curr], ptr, len);
+		fio->curr += len;
+		return(len);
+	}
+
+	/* flush the buffer, then write the large one directly */
+	if(fio->curr != 0) {
+		uint64_t flush = zf_flush(fio, fio->buf, fio->curr);
+		fio->pos += flush;
+		if((int64_t)flush != fio->curr) {
+			return(0);
+		}
+		fio->curr = 0;
+	}
+	size_t written = zf_flush(fio, ptr, len);
+	fio->pos += written;
+	return(written);
+}
+
+/**
+ * @fn zfgetc
+ */
+int zfgetc(
+	zf_t *fp)
+{
+	struct zf_intl_s *fio = (struct zf_intl_s *)fp;
+
+	/* if the pointer reached the end, refill the buffer */
+	if(fio->curr >= fio->end) {
+		if(fio->eof == 0) {
+			zf_refill(fio);
+		}
+		fio->eof += (fio->eof == 1 && fio->curr >= fio->end);
+	}
+	if(fio->eof == 2) {
+		return(EOF);
+	}
+	return((int)fio->buf[fio->curr++]);
+}
+
+/**
+ * @fn zfungetc
+ */
+int zfungetc(
+	zf_t *fp,
+	int c)
+{
+	struct zf_intl_s *fio = (struct zf_intl_s *)fp;
+	if(fio->buf == NULL) {
+		return(-1);
+	}
+	fio->eof -= (fio->eof == 2);
+
+	/* no room before curr in the own buffer; enlarged if full */
+	if(fio->buf == fio->mem.ptr && (fio->mem.mirror != 0 || fio->curr <= -ZF_UNGETC_MARGIN_SIZE)) {
+		int full = (fio->mem.mirror != 0) ? (fio->end - fio->curr + ZF_BUF_PADDING >= fio->size) : (fio->end >= fio->size);
+		if(full && zf_buf_grow(fio, fio->size) != 0) {
+			return(-1);
+		}
+
+		/* the same bytes appear size bytes ahead in the ring, or the bytes left are moved to the tail */
+		if(fio->mem.mirror != 0 && fio->curr <= 0) {
+			fio->curr += fio->size;
+			fio->end += fio->size;
+			fio->valid += fio->size;
+		} else if(fio->mem.mirror == 0) {
+			int64_t shift = fio->size - fio->end;
+			memmove((void *)&fio->buf[fio->curr + shift], (void *)&fio->buf[fio->curr], fio->end - fio->curr);
+			fio->valid = ((fio->valid > fio->curr) ? fio->valid : fio->curr) + shift;
+			fio->curr += shift;
+			fio->end += shift;
+			memset((void *)&fio->buf[fio->end], 0, ZF_BUF_PADDING);
+		}
+	}
+
+	if(fio->curr <= -ZF_UNGETC_MARGIN_SIZE) {
+		return(-1);
+	}
+
+	/* pushing back the byte read keeps the stream in the buffer */
+	if(fio->buf[fio->curr - 1] != (uint8_t)c && fio->valid < fio->curr) {
+		fio->valid = fio->curr;
+	}
+	return(fio->buf[--fio->curr] = c);
+}
+
+/**
+ * @fn zfeof
+ */
+int zfeof(
+	zf_t *fp)
+{
+	struct zf_intl_s *fio = (struct zf_intl_s *)fp;
+	return((int)(fio->eof == 2));
+}
+
+/**
+ * @fn zfputc
+ */
+int zfputc(
+	zf_t *fp,
+	int c)
+{
+	struct zf_intl_s *fio = (struct zf_intl_s *)fp;
+	fio->buf[fio->curr++] = (uint8_t)c;
+	
+	/* flush if buffer is full */
+	if(fio->curr == fio->size) {
+		fio->curr = 0;
+		uint64_t written = zf_flush(fio, fio->buf, fio->size);
+		fio->pos += written;
+		if((int64_t)written != fio->size) {
+			return(-1);
+		}
+	}
+	return(c);
+}
+
+/**
+ * @fn zfputs
+ */
+int zfputs(
+	zf_t *fp,
+	char const *s)
+{
+	while(*s != '\0') {
+		zfputc(fp, (int)*s++);
+	}
+	zfputc(fp, '\n');
+	return(0);
+}
+
+/**
+ * @fn zfprintf
+ */
+int zfprintf(
+	zf_t *fp,
+	char const *format,
+	...)
+{
+	struct zf_intl_s *fio = (struct zf_intl_s *)fp;
+	va_list l, m;
+	va_start(l, format);
+	va_copy(m, l);
+
+	/* append to the buffer if it fits */
+	int64_t rem = fio->size - fio->curr;
+	int size = vsnprintf((char *)&fio->buf[fio->curr], rem, format, l);
+	va_end(l);
+	if(size < 0 || size < rem) {
+		fio->curr += (size < 0) ? 0 : size;
+		va_end(m);
+		return((size < 0) ? 0 : size);
+	}
+
+	/* flush */
+	uint64_t flush = zf_flush(fio, fio->buf, fio->curr);
+	fio->pos += flush;
+	/* something is wrong */
+	if((int64_t)flush != fio->curr) {
+		va_end(m);
+		return(0);
+	}
+	fio->curr = 0;
+
+	/* format again at the head, or out of the buffer if longer than it */
+	if(size < fio->size) {
+		vsnprintf((char *)fio->buf, fio->size, format, m);
+		fio->curr = size;
+		va_end(m);
+		return(size);
+	}
+	char *tmp = (char *)malloc(size + 1);
+	size_t written = 0;
+	if(tmp != NULL) {
+		vsnprintf(tmp, size + 1, format, m);
+		written = zf_flush(fio, tmp, size);
+		fio->pos += written;
+		free(tmp);
+	}
+	va_end(m);
+	return((int)written);
+}
+
+/**
+ * @fn zftell
+ * @brief offset in the uncompressed stream
+ */
+int64_t zftell(
+	zf_t *fp)
+{
+	struct zf_intl_s *fio = (struct zf_intl_s *)fp;
+	if(fio->mode[0] != 'r') {
+		return(fio->pos + fio->curr);
+	}
+	return(fio->pos - (fio->end - fio->curr));
+}
+
+/**
+ * @fn zf_rewind
+ * @brief reopen codec on the head of the file; fails if the input is not a regular file
+ */
+static
+int zf_rewind(
+	struct zf_intl_s *fio)
+{
+	if(fio->ko == NULL || fio->fd < 0) {
+		return(-1);
+	}
+
+	/* the file offset is shared with the duplicated one; rewound after the read-ahead and the codec (and its workers) are stopped */
+	int fd = dup(fio->fd);
+	if(fd < 0) {
+		return(-1);
+	}
+	zf_ra_destroy(fio->ra);
+	fio->ra = NULL;
+	fio->err |= (fio->fn.close(fio->fp) != 0);
+	fio->fp = NULL;
+	fio->fd = fd;
+	if(lseek(fd, 0, SEEK_SET) == 0) {
+		fio->fp = fio->fn.dopen(fd, fio->mode, &fio->params);
+	} else {
+		close(fd);
+		fio->fd = -1;
+	}
+	if(fio->fp == NULL || (fio->fn.init != NULL && fio->fn.init(fio->fp) != 0)) {
+		zf_map(fio, 0);
+		fio->eof = 2;
+		return(-1);			/* the handle is no longer readable */
+	}
+	if(zf_map(fio, 0) != 0) {
+		return(-1);
+	}
+	fio->ra = (fio->params.ra > 0 && fio->eof == 0) ? zf_ra_init(fio, fio->params.ra) : NULL;
+	return(0);
+}
+
+/**
+ * @fn zfseek
+ * @brief set offset in the uncompressed stream (read mode only), whence is SEEK_SET or SEEK_CUR.
+ * returns 0 on success. random access to gzip is accelerated with the index enabled by "@idx".
+ */
+int zfseek(
+	zf_t *fp,
+	int64_t offset,
+	int whence)
+{
+	struct zf_intl_s *fio = (struct zf_intl_s *)fp;
+	if(fio->mode[0] != 'r' || fio->fp == NULL) {
+		return(-1);
+	}
+
+	int64_t target = (whence == SEEK_SET) ? offset
+		: (whence == SEEK_CUR) ? zftell(fp) + offset
+		: -1;
+	if(target < 0) {
+		return(-1);
+	}
+
+	/* in the buffer */
+	int64_t held = fio->end - fio->valid;
+	if(fio->pos - held <= target && target <= fio->pos) {
+		fio->curr = target - (fio->pos - fio->end);
+		fio->eof -= (fio->eof == 2 && fio->curr < fio->end);
+		return(0);
+	}
+
+	/* let the codec seek; the read-ahead is discarded on success */
+	if(fio->fn.seek != NULL) {
+		zf_ra_halt(fio->ra);
+		int ret = fio->fn.seek(fio->fp, target);
+		if(ret == 0) { zf_ra_clear(fio->ra); }
+		zf_ra_resume(fio->ra);
+		if(ret == 0) {
+			return(zf_map(fio, target));
+		}
+	}
+
+	/* reopen if the target is behind, then skip to the target */
+	if(target < zftell(fp) && zf_rewind(fio) != 0) {
+		return(-1);
+	}
+	fio->curr = fio->end;
+	while(fio->pos < target && fio->eof == 0) {
+		fio->curr = fio->end;
+		zf_refill(fio);
+	}
+	if(fio->pos < target) {
+		fio->curr = fio->end;
+		fio->eof = 2;
+		return(-1);
+	}
+	fio->curr = fio->end - (fio->pos - target);
+	return(0);
+}
+
+/**
+ * @fn zfread_async
+ * @brief queue zfread(fp, ptr, len) to the background thread; returns the token, -1 if failed
+ */
+int64_t zfread_async(
+	zf_t *fp,
+	void *ptr,
+	size_t len)
+{
+	struct zf_intl_s *fio = (struct zf_intl_s *)fp;
+	if(fio == NULL || fio->mode[0] != 'r') { return(-1); }
+	if(fio->aio == NULL && (fio->aio = zf_aio_init(fp)) == NULL) { return(-1); }
+	return(zf_aio_submit(fio->aio, 0, ptr, len));
+}
+
+/**
+ * @fn zfwrite_async
+ * @brief queue zfwrite(fp, ptr, len) to the background thread; returns the token, -1 if failed
+ */
+int64_t zfwrite_async(
+	zf_t *fp,
+	void *ptr,
+	size_t len)
+{
+	struct zf_intl_s *fio = (struct zf_intl_s *)fp;
+	if(fio == NULL || fio->mode[0] == 'r') { return(-1); }
+	if(fio->aio == NULL && (fio->aio = zf_aio_init(fp)) == NULL) { return(-1); }
+	return(zf_aio_submit(fio->aio, 1, ptr, len));
+}
+
+/**
+ * @fn zfpoll
+ * @brief 1 if the request is completed (the transferred length to len), 0 if not yet, -1 if unknown or already collected
+ */
+int zfpoll(
+	zf_t *fp,
+	int64_t token,
+	size_t *len)
+{
+	struct zf_intl_s *fio = (struct zf_intl_s *)fp;
+	if(fio == NULL) { return(-1); }
+	return(zf_aio_collect(fio->aio, token, len, 0));
+}
+
+/**
+ * @fn zfwait
+ * @brief wait for the request; 0 on completion (the transferred length to len), -1 if unknown or already collected
+ */
+int zfwait(
+	zf_t *fp,
+	int64_t token,
+	size_t *len)
+{
+	struct zf_intl_s *fio = (struct zf_intl_s *)fp;
+	if(fio == NULL) { return(-1); }
+	return((zf_aio_collect(fio->aio, token, len, 1) == 1) ? 0 : -1);
+}
+
+/**
+ * @fn zfeventfd
+ * @brief eventfd incremented on each completion of the asynchronous requests, -1 if not available
+ */
+int zfeventfd(
+	zf_t *fp)
+{
+	struct zf_intl_s *fio = (struct zf_intl_s *)fp;
+	if(fio == NULL) { return(-1); }
+	if(fio->aio == NULL && (fio->aio = zf_aio_init(fp)) == NULL) { return(-1); }
+	return(fio->aio->efd);
+}
+
+/* unittests */
+#include <time.h>
+#include <utime.h>
+
+/**
+ * @fn init_rand
+ */
+void *init_rand(
+	void *params)
+{
+	srand(time(NULL));
+	return(NULL);
+}
+void clean_rand(
+	void *gctx)
+{
+	return;		/* nothing to do */
+}
+
+unittest_config(
+	.name = "zf",
+	.init = init_rand,
+	.clean = clean_rand
+);
+
+/**
+ * @val ascii_table
+ */
+static
+char const *ascii_table =
+	" !\"#$%&\'()*+,-./"
+	"0123456789:;<=>?"
+	"@ABCDEFGHIJKLMNO"
+	"PQRSTUVWXYZ[\\]^_"
+	"`abcdefghijklmno"
+	"pqrstuvwxyz{|}~\n";
+
+/**
+ * @fn make_random_array
+ */
+static inline
+void *make_random_array(
+	void *params)
+{
+	uint64_t len = (uint64_t)params;
+	char *arr = (char *)malloc(len);
+	for(uint64_t i = 0; i < len; i++) {
+		arr[i] = ascii_table[rand() % strlen(ascii_table)];
+	}
+	return((void *)arr);
+}
+
+#define with(_len) \
+	.init = make_random_array, \
+	.clean = free, \
+	.params = (void *)((uint64_t)(_len))
+
+#define omajinai() \
+	char *arr = (char *)ctx;
+
+/* return NULL when failed to open */
+unittest()
+{
+	char const *filename = "test.txt";
+
+	remove(filename);
+	zf_t *zf = zfopen(filename, "r");
+	assert(zf == NULL);
+}
+
+/* redirect to stdout */
 unittest()
 {
-	char const *filename = "test.txt";
+	zf_t *zf = zfopen("-", "w");
+	assert(zf != NULL);
+	zfclose(zf);
+}
+
+/* test zfopen / zfclose with len 100M */
+#define TEST_ARR_LEN 		1000000
+unittest(with(TEST_ARR_LEN))
+{
+	omajinai();
+
+	/* write */
+	zf_t *wfp = zfopen("tmp.txt", "w");
+	assert(wfp != NULL, "%p", wfp);
+
+	size_t written = zfwrite(wfp, arr, TEST_ARR_LEN);
+	assert(written == TEST_ARR_LEN, "%llu", written);
+
+	zfclose(wfp);
+
+	/* read */
+	zf_t *rfp = zfopen("tmp.txt", "r");
+	assert(rfp != NULL, "%p", rfp);
+	assert(strcmp(rfp->path, "tmp.txt") == 0, "%s", rfp->path);
+
+	char *rarr = (char *)malloc(TEST_ARR_LEN);
+	size_t read = zfread(rfp, rarr, TEST_ARR_LEN);
+	assert(read == TEST_ARR_LEN, "%llu", read);
+
+	/* EOF */
+	assert(zfgetc(rfp) == EOF, "%d", zfgetc(rfp));
+	assert(zfeof(rfp) != 0, "%d", zfeof(rfp));
+
+	zfclose(rfp);
+
+	/* compare */
+	assert(memcmp(arr, rarr, TEST_ARR_LEN) == 0);
+
+	/* cleanup */
+	free(rarr);
+	remove("tmp.txt");
+}
+
+/* getc / putc */
+unittest(with(TEST_ARR_LEN))
+{
+	omajinai();
+
+	/* write with zfputc */
+	zf_t *wfp = zfopen("tmp.txt", "w");
+
+	for(int64_t i = 0; i < TEST_ARR_LEN; i++) {
+		zfputc(wfp, arr[i]);
+	}
+
+	zfclose(wfp);
+
+	/* read with zfgetc */
+	zf_t *rfp = zfopen("tmp.txt", "r");
+
+	char *rarr = (char *)malloc(TEST_ARR_LEN);
+	for(int64_t i = 0; i < TEST_ARR_LEN; i++) {
+		rarr[i] = zfgetc(rfp);
+	}
+
+	/* EOF */
+	assert(zfgetc(rfp) == EOF, "%d", zfgetc(rfp));
+	assert(zfeof(rfp) != 0, "%d", zfeof(rfp));
+
+	zfclose(rfp);
+
+	/* compare */
+	assert(memcmp(arr, rarr, TEST_ARR_LEN) == 0);
+
+	/* cleanup */
+	free(rarr);
+	remove("tmp.txt");
+}
+
+/* peek */
+unittest(with(100000))
+{
+	omajinai();
+
+	/* write */
+	zf_t *wfp = zfopen("tmp.txt", "w");
+	zfwrite(wfp, arr, 100000);
+	zfclose(wfp);
+
+	/* read */
+	zf_t *rfp = zfopen("tmp.txt", "r");
+
+	char *rarr1 = (char *)malloc(TEST_ARR_LEN);
+	char *rarr2 = (char *)malloc(TEST_ARR_LEN);
+	
+	/* read the former half */
+	size_t read1 = zfpeek(rfp, rarr1, 50000);
+	assert(zfeof(rfp) == 0, "%d", zfeof(rfp));
+	assert(read1 == 50000, "%llu", read1);
+
+
+	size_t read2 = zfread(rfp, rarr2, 50000);
+	assert(zfeof(rfp) == 0, "%d", zfeof(rfp));
+	assert(read2 == 50000, "%llu", read2);
+
+	assert(memcmp(arr, rarr1, 50000) == 0);
+	assert(memcmp(arr, rarr2, 50000) == 0);
+
+	/* read the latter half */
+	read1 = zfpeek(rfp, rarr1, 50000);
+	assert(read1 == 50000, "%llu", read1);
+
+	read2 = zfread(rfp, rarr2, 50000);
+	assert(read2 == 50000, "%llu", read2);
+
+	assert(memcmp(&arr[50000], rarr1, 50000) == 0);
+	assert(memcmp(&arr[50000], rarr2, 50000) == 0);
+
+	/* EOF */
+	assert(zfgetc(rfp) == EOF, "%d", zfgetc(rfp));
+	assert(zfeof(rfp) != 0, "%d", zfeof(rfp));
+
+	zfclose(rfp);
+
+	/* cleanup */
+	free(rarr1);
+	free(rarr2);
+	remove("tmp.txt");
+}
+
+/* ungetc */
+unittest(with(TEST_ARR_LEN))
+{
+	omajinai();
+
+	/* write */
+	zf_t *wfp = zfopen("tmp.txt", "w");
+	zfwrite(wfp, arr, TEST_ARR_LEN);
+	zfclose(wfp);
+
+	/* push pop */
+	zf_t *rfp = zfopen("tmp.txt", "r");
+	int save = 'a';
+	for(int64_t i = 0; i < TEST_ARR_LEN; i++) {
+		zfungetc(rfp, save);
+		int c = zfgetc(rfp);
+		assert(c == save);
+		save = zfgetc(rfp);
+	}
+
+	save = zfgetc(rfp);
+	assert(save == EOF, "%d", save);
+
+	zfclose(rfp);
+	remove("tmp.txt");
+}
+
+/* small and large writes mixed with putc, kept in order */
+unittest(with(TEST_ARR_LEN))
+{
+	omajinai();
+
+	zf_t *wfp = zfopen("tmp.txt", "w");
+	int64_t const lens[4] = { 1, 1000, ZF_BUF_SIZE - 1, ZF_BUF_SIZE + 1 };
+	int64_t pos = 0;
+	for(int64_t i = 0; pos < TEST_ARR_LEN; i++) {
+		int64_t len = lens[i % 4];
+		len = (pos + len < TEST_ARR_LEN) ? len : TEST_ARR_LEN - pos;
+		assert(zfwrite(wfp, &arr[pos], len) == (size_t)len);
+		pos += len;
+		if(pos < TEST_ARR_LEN) { zfputc(wfp, arr[pos++]); }
+	}
+	assert(zftell(wfp) == TEST_ARR_LEN, "%lld", zftell(wfp));
+	zfclose(wfp);
+
+	zf_t *rfp = zfopen("<cat tmp.txt", "r");
+	char *rarr = (char *)malloc(TEST_ARR_LEN);
+	assert(zfread(rfp, rarr, TEST_ARR_LEN) == TEST_ARR_LEN);
+	assert(zfgetc(rfp) == EOF);
+	assert(memcmp(arr, rarr, TEST_ARR_LEN) == 0);
+	zfclose(rfp);
+
+	free(rarr);
+	remove("tmp.txt");
+}
+
+/* peek and ungetc longer than the buffer, across the wrap point of the ring */
+unittest(with(TEST_ARR_LEN))
+{
+	omajinai();
+
+	int64_t const len = 3 * TEST_ARR_LEN;
+	zf_t *wfp = zfopen("tmp.txt", "w");
+	for(int64_t i = 0; i < 3; i++) {
+		zfwrite(wfp, (void *)arr, TEST_ARR_LEN);
+	}
+	zfclose(wfp);
+
+	int64_t const lens[4] = { 10, ZF_BUF_SIZE - 1, ZF_BUF_SIZE + 100, 2 * ZF_BUF_SIZE + 3 };
+	char const *paths[2] = { "tmp.txt", "<cat tmp.txt" };
+	char *buf = (char *)malloc(len);
+	for(int64_t i = 0; i < 2; i++) {
+		zf_t *rfp = zfopen(paths[i], "r");
+		assert(rfp != NULL, "%p", rfp);
+		assert(((struct zf_intl_s *)rfp)->mem.mirror == 0);		/* plain buffer until a long peek */
+
+		int64_t pos = 0;
+		for(int64_t j = 0; pos < len; j++) {
+			/* peek */
+			int64_t plen = lens[j % 4];
+			int64_t expected = (pos + plen < len) ? plen : len - pos;
+			assert(zfpeek(rfp, buf, plen) == (size_t)expected, "%s, %lld, %lld", paths[i], pos, plen);
+			for(int64_t k = 0; k < expected; k++) {
+				assert(buf[k] == arr[(pos + k) % TEST_ARR_LEN], "%lld, %lld", pos, k);
+			}
+
+			/* ungetc the last bytes back, then read them again */
+			int64_t back = (pos < 1000) ? pos : rand() % 1000;
+			for(int64_t k = 1; k <= back; k++) {
+				assert(zfungetc(rfp, arr[(pos - k) % TEST_ARR_LEN]) == (uint8_t)arr[(pos - k) % TEST_ARR_LEN]);
+			}
+			assert(zftell(rfp) == pos - back, "%lld, %lld", zftell(rfp), pos - back);
+			for(int64_t k = back; k > 0; k--) {
+				assert(zfgetc(rfp) == (uint8_t)arr[(pos - k) % TEST_ARR_LEN]);
+			}
+
+			/* advance */
+			int64_t skip = 1 + rand() % 300000;
+			for(int64_t k = 0; k < skip && pos < len; k++, pos++) {
+				assert(zfgetc(rfp) == (uint8_t)arr[pos % TEST_ARR_LEN], "%lld", pos);
+			}
+		}
+		assert(zfgetc(rfp) == EOF);
+		#ifdef __linux__
+		assert(((struct zf_intl_s *)rfp)->mem.mirror != 0);
+		#endif
+
+		/* pushback beyond the buffer */
+		int64_t const back = ZF_BUF_SIZE + 1000;
+		for(int64_t k = 1; k <= back; k++) {
+			assert(zfungetc(rfp, arr[TEST_ARR_LEN - k]) == (uint8_t)arr[TEST_ARR_LEN - k]);
+		}
+		assert(!zfeof(rfp));
+		assert(zfread(rfp, buf, len) == back);
+		assert(memcmp(buf, &arr[TEST_ARR_LEN - back], back) == 0);
+		zfclose(rfp);
+	}
+
+	free(buf);
+	remove("tmp.txt");
+}
+
+/* seek back within the bytes held in the ring */
+unittest(with(TEST_ARR_LEN))
+{
+	omajinai();
+
+	int64_t const len = 4 * TEST_ARR_LEN;
+	zf_t *wfp = zfopen("tmp.txt", "w");
+	for(int64_t i = 0; i < 4; i++) {
+		zfwrite(wfp, (void *)arr, TEST_ARR_LEN);
+	}
+	zfclose(wfp);
+
+	zf_t *rfp = zfopen("tmp.txt", "r");
+	struct zf_intl_s *fio = (struct zf_intl_s *)rfp;
+	char buf[128];
+	char *large = (char *)malloc(ZF_BUF_SIZE + 100);
+	assert(zfpeek(rfp, large, ZF_BUF_SIZE + 100) == ZF_BUF_SIZE + 100);
+	free(large);
+	for(int64_t i = 0; i < 4; i++) {
+		/* advance across a few refills of the ring */
+		uint8_t const *p;
+		size_t avail;
+		while(zftell(rfp) < (i + 3) * TEST_ARR_LEN / 2 + 12345 && (avail = zfreadbuf(rfp, &p, 1)) > 0) {
+			zfconsume(rfp, (avail < 100000) ? avail : 100000);
+		}
+
+		/* the oldest byte held, one before it, and the one the padding aliases */
+		int64_t oldest = fio->pos - (fio->end - fio->valid);
+		int64_t const targets[3] = { oldest, oldest - 1, fio->pos - fio->size + 8 };
+		for(int64_t j = 0; j < 3; j++) {
+			int64_t pos = targets[j];
+			assert(zfseek(rfp, pos, SEEK_SET) == 0, "%lld", pos);
+			assert(zfpeek(rfp, buf, 128) == 128);
+			for(int64_t k = 0; k < 128; k++) {
+				assert(buf[k] == arr[(pos + k) % TEST_ARR_LEN], "%lld, %lld, %lld", j, pos, k);
+			}
+		}
+	}
+	assert(zfseek(rfp, len - 1, SEEK_SET) == 0);
+	assert(zfgetc(rfp) == (uint8_t)arr[TEST_ARR_LEN - 1]);
+	zfclose(rfp);
+	remove("tmp.txt");
+}
+
+/* seek back after pushbacks that enlarge the buffer or move the bytes left to its tail */
+unittest(with(TEST_ARR_LEN))
+{
+	omajinai();
+
+	int64_t const len = 4 * TEST_ARR_LEN;
+	zf_t *wfp = zfopen("tmp.txt", "w");
+	for(int64_t i = 0; i < 4; i++) {
+		zfwrite(wfp, (void *)arr, TEST_ARR_LEN);
+	}
+	zfclose(wfp);
+
+	/* a full buffer, and one near the end of the file */
+	int64_t const heads[2] = { 2 * TEST_ARR_LEN, len - 1000 };
+	for(int64_t i = 0; i < 2; i++) {
+		for(int64_t same = 0; same < 2; same++) {
+			zf_t *rfp = zfopen("tmp.txt", "r");
+			int64_t p0 = heads[i];
+			assert(zfseek(rfp, p0, SEEK_SET) == 0);
+			assert(zfgetc(rfp) == (uint8_t)arr[p0 % TEST_ARR_LEN]);
+
+			/* the bytes read or others */
+			for(int64_t k = 0; k < 41; k++) {
+				int c = (same != 0) ? (uint8_t)arr[(p0 - k) % TEST_ARR_LEN] : 'x';
+				assert(zfungetc(rfp, c) == c);
+			}
+			for(int64_t k = 0; k < 41; k++) {
+				assert(zfgetc(rfp) == ((same != 0) ? (uint8_t)arr[(p0 - 40 + k) % TEST_ARR_LEN] : 'x'));
+			}
+
+			int64_t const targets[3] = { p0 - 300040, p0 - 20, p0 + 1 };
+			for(int64_t j = 0; j < 3; j++) {
+				assert(zfseek(rfp, targets[j], SEEK_SET) == 0, "%lld", targets[j]);
+				assert(zftell(rfp) == targets[j]);
+				int c = zfgetc(rfp);
+				assert(c == (uint8_t)arr[targets[j] % TEST_ARR_LEN], "%lld, %lld, %lld, %d", i, same, targets[j], c);
+			}
+			zfclose(rfp);
+		}
+	}
+	remove("tmp.txt");
+}
+
+/* buffer size, alignment, and hugepages */
+unittest(with(TEST_ARR_LEN))
+{
+	omajinai();
+
+	char const *wmodes[4] = { "w@buf=64K", "w@buf=1K", "w@buf=16M,huge", "w@align=4K" };
+	char const *rmodes[4] = { "r@buf=64K", "r@buf=1K", "r@buf=16M,huge", "r@align=4K" };
+	int64_t const sizes[4] = { 64 * 1024, 64 * 1024, 16 * 1024 * 1024, ZF_BUF_SIZE };
+	uint64_t const aligns[4] = { 64, 64, 64, 4096 };
+	char *rarr = (char *)malloc(TEST_ARR_LEN);
+	for(int64_t i = 0; i < 4; i++) {
+		zf_t *wfp = zfopen("tmp.txt", wmodes[i]);
+		assert(wfp != NULL, "%s", wmodes[i]);
+		struct zf_intl_s *w = (struct zf_intl_s *)wfp;
+		assert(w->size >= sizes[i], "%s, %lld", wmodes[i], w->size);
+		assert(((uintptr_t)w->buf & (aligns[i] - 1)) == 0, "%s, %p", wmodes[i], w->buf);
+		for(int64_t j = 0; j < TEST_ARR_LEN; j++) {
+			zfputc(wfp, arr[j]);
+		}
+		assert(zfclose(wfp) == 0);
+
+		zf_t *rfp = zfopen("tmp.txt", rmodes[i]);
+		assert(rfp != NULL, "%s", rmodes[i]);
+		struct zf_intl_s *r = (struct zf_intl_s *)rfp;
+		assert(r->size >= sizes[i] && r->size < 2 * sizes[i] + ZF_HUGEPAGE_SIZE, "%s, %lld", rmodes[i], r->size);
+		assert(((uintptr_t)r->buf & (aligns[i] - 1)) == 0, "%s, %p", rmodes[i], r->buf);
+
+		int64_t pos = 0;
+		while(pos < TEST_ARR_LEN) {
+			int c = zfgetc(rfp);
+			assert(c == (uint8_t)arr[pos], "%s, %lld", rmodes[i], pos);
+			pos++;
+			size_t read = zfread(rfp, &rarr[pos], rand() % 10000);
+			assert(memcmp(&rarr[pos], &arr[pos], read) == 0, "%s, %lld", rmodes[i], pos);
+			pos += read;
+		}
+		assert(zfgetc(rfp) == EOF);
+		zfclose(rfp);
+	}
+
+	/* read-ahead and write-behind slots follow the handle's buffer */
+	zf_t *wfp = zfopen("tmp.txt", "w@buf=64K,align=4K,wb=1M");
+	assert(wfp != NULL);
+	struct zf_wb_s *wb = ((struct zf_intl_s *)wfp)->wb;
+	assert(wb != NULL && wb->nslots == 16, "%llu", wb->nslots);
+	for(uint64_t i = 0; i < wb->nslots; i++) {
+		assert(wb->bufs[i].size == 64 * 1024, "%lld", wb->bufs[i].size);
+		assert(((uintptr_t)wb->bufs[i].ptr & 4095) == 0, "%p", wb->bufs[i].ptr);
+	}
+	uint8_t *first = wb->bufs[0].ptr;
+	for(int64_t j = 0; j < TEST_ARR_LEN; j++) {
+		zfputc(wfp, arr[j]);
+		if(j == 64 * 1024 - 1) {
+			assert(((struct zf_intl_s *)wfp)->buf == first);		/* the full buffer is queued without copying */
+		}
+	}
+	assert(zfclose(wfp) == 0);
+
+	zf_t *rfp = zfopen("tmp.txt", "r@buf=64K,align=4K,ra=3");
+	assert(rfp != NULL);
+	struct zf_ra_s *ra = ((struct zf_intl_s *)rfp)->ra;
+	assert(ra != NULL && ra->nslots == 3, "%llu", ra->nslots);
+	for(uint64_t i = 0; i < ra->nslots; i++) {
+		assert(ra->bufs[i].size == 64 * 1024, "%lld", ra->bufs[i].size);
+		assert(((uintptr_t)ra->bufs[i].ptr & 4095) == 0, "%p", ra->bufs[i].ptr);
+	}
+	first = ra->bufs[0].ptr;
+	for(int64_t j = 0; j < TEST_ARR_LEN; j++) {
+		assert(zfgetc(rfp) == (uint8_t)arr[j], "%lld", j);
+		if(j == 0) {
+			assert(((struct zf_intl_s *)rfp)->buf == first);		/* the slot is taken over without copying */
+		}
+	}
+	assert(zfgetc(rfp) == EOF);
+	zfclose(rfp);
+
+	free(rarr);
+	remove("tmp.txt");
+}
+
+/* read-ahead */
+unittest(with(TEST_ARR_LEN))
+{
+	omajinai();
+
+	zf_t *wfp = zfopen("tmp.txt", "w");
+	zfwrite(wfp, arr, TEST_ARR_LEN);
+	zfclose(wfp);
+
+	char const *modes[3] = { "r@ra", "r@ra=2", "r@ra=16" };
+	char const *paths[2] = { "tmp.txt", "<cat tmp.txt" };
+	char *rarr = (char *)malloc(TEST_ARR_LEN);
+	for(int64_t i = 0; i < 3; i++) {
+		for(int64_t j = 0; j < 2; j++) {
+			zf_t *rfp = zfopen(paths[j], modes[i]);
+			assert(rfp != NULL, "%p", rfp);
+			assert(((struct zf_intl_s *)rfp)->ra != NULL);
+
+			/* getc, peek, and read mixed */
+			char buf[1024];
+			int64_t pos = 0;
+			while(pos < TEST_ARR_LEN) {
+				int c = zfgetc(rfp);
+				assert(c == (uint8_t)arr[pos], "%d, %d", c, arr[pos]);
+				pos++;
+				size_t peek = zfpeek(rfp, buf, 1024);
+				assert(memcmp(buf, &arr[pos], peek) == 0);
+				pos += zfread(rfp, &rarr[pos], 100000);
+				assert(memcmp(&rarr[pos - 10], &arr[pos - 10], 10) == 0);
+			}
+			assert(zfgetc(rfp) == EOF);
+
+			/* backward */
+			if(j == 0) {
+				pos = TEST_ARR_LEN / 3;
+				assert(zfseek(rfp, pos, SEEK_SET) == 0);
+				assert(zfread(rfp, rarr, TEST_ARR_LEN) == TEST_ARR_LEN - pos);
+				assert(memcmp(rarr, &arr[pos], TEST_ARR_LEN - pos) == 0);
+			}
+			zfclose(rfp);
+		}
+	}
+
+	free(rarr);
+	remove("tmp.txt");
+}
+
+/* plain files read by blocks on worker threads */
+unittest(with(TEST_ARR_LEN))
+{
+	omajinai();
+
+	/* several blocks with a partial one at the tail */
+	int64_t const len = 3 * TEST_ARR_LEN + TEST_ARR_LEN / 2;
+	char *warr = (char *)malloc(len);
+	for(int64_t i = 0; i < len; i++) {
+		warr[i] = arr[i % TEST_ARR_LEN];
+	}
+	zf_t *wfp = zfopen("tmp.txt", "w");
+	zfwrite(wfp, warr, len);
+	zfclose(wfp);
+
+	char const *modes[3] = { "r@1", "r@4", "r@2,ra" };
+	char *rarr = (char *)malloc(len);
+	for(int64_t i = 0; i < 3; i++) {
+		zf_t *rfp = zfopen("tmp.txt", modes[i]);
+		assert(rfp != NULL, "%p", rfp);
+		assert(((struct zf_raw_s *)((struct zf_intl_s *)rfp)->fp)->mt != NULL);
+		assert(zfread(rfp, rarr, len) == len);
+		assert(zfgetc(rfp) == EOF);
+		assert(memcmp(warr, rarr, len) == 0, "%s", modes[i]);
+
+		char buf[1024];
+		for(int64_t j = 0; j < 10; j++) {
+			int64_t pos = rand() % (len - 1024);
+			assert(zfseek(rfp, pos, SEEK_SET) == 0, "%lld", pos);
+			assert(zfread(rfp, buf, 1024) == 1024);
+			assert(memcmp(buf, &warr[pos], 1024) == 0, "%lld", pos);
+		}
+		zfclose(rfp);
+	}
+
+	free(warr);
+	free(rarr);
+	remove("tmp.txt");
+}
+
+/* plain files mapped with "mmap" */
+unittest(with(TEST_ARR_LEN))
+{
+	omajinai();
+
+	zf_t *wfp = zfopen("tmp.txt", "w");
+	zfwrite(wfp, (void *)arr, TEST_ARR_LEN);
+	zfclose(wfp);
+
+	char const *modes[3] = { "r@mmap", "r@mmap,ra", "r@4,mmap" };
+	char *rarr = (char *)malloc(TEST_ARR_LEN);
+	for(int64_t i = 0; i < 3; i++) {
+		zf_t *rfp = zfopen("tmp.txt", modes[i]);
+		assert(rfp != NULL, "%p", rfp);
+		assert(((struct zf_raw_s *)((struct zf_intl_s *)rfp)->fp)->map != NULL, "%s", modes[i]);
+
+		/* getc / ungetc / peek / read */
+		int c = zfgetc(rfp);
+		assert(c == (uint8_t)arr[0], "%d, %d", c, arr[0]);
+		assert(zfungetc(rfp, c) == c);
+		assert(zfungetc(rfp, 'y') == 'y');		/* in front of the file */
+		assert(zfgetc(rfp) == 'y');
+		assert(zfgetc(rfp) == c);
+		char buf[1024];
+		assert(zfpeek(rfp, buf, 1024) == 1024);
+		assert(memcmp(buf, &arr[1], 1024) == 0);
+		assert(zfread(rfp, &rarr[1], TEST_ARR_LEN) == TEST_ARR_LEN - 1);
+		assert(memcmp(&rarr[1], &arr[1], TEST_ARR_LEN - 1) == 0, "%s", modes[i]);
+		assert(zfpeek(rfp, buf, 1024) == 0);
+		assert(zfgetc(rfp) == EOF);
+		assert(zfeof(rfp));
+
+		/* seek back after EOF, and past the end */
+		int64_t pos = rand() % (TEST_ARR_LEN - 1024);
+		assert(zfseek(rfp, pos, SEEK_SET) == 0, "%lld", pos);
+		assert(zftell(rfp) == pos);
+		assert(zfread(rfp, buf, 1024) == 1024);
+		assert(memcmp(buf, &arr[pos], 1024) == 0, "%lld", pos);
+		assert(zfseek(rfp, TEST_ARR_LEN + 1, SEEK_SET) != 0);
+		assert(zfseek(rfp, 0, SEEK_SET) == 0);
+		assert(zfgetc(rfp) == (uint8_t)arr[0]);
+		zfclose(rfp);
+	}
+
+	/* the file is left untouched by zfungetc */
+	zf_t *rfp = zfopen("tmp.txt", "r");
+	assert(zfread(rfp, rarr, TEST_ARR_LEN) == TEST_ARR_LEN);
+	assert(memcmp(rarr, arr, TEST_ARR_LEN) == 0);
+	zfclose(rfp);
+
+	free(rarr);
+	remove("tmp.txt");
+}
+
+/* borrowed buffer */
+unittest(with(TEST_ARR_LEN))
+{
+	omajinai();
+
+	zf_t *wfp = zfopen("tmp.txt", "w");
+	zfwrite(wfp, (void *)arr, TEST_ARR_LEN);
+	zfclose(wfp);
+
+	char const *paths[6] = { "tmp.txt", "tmp.txt", "tmp.txt", "<cat tmp.txt", "tmp.txt", "tmp.txt" };
+	char const *modes[6] = { "r", "r@mmap", "r@ra", "r", "r@buf=64K", "r@huge,align=4K" };
+	for(int64_t i = 0; i < 6; i++) {
+		zf_t *rfp = zfopen(paths[i], modes[i]);
+		assert(rfp != NULL, "%p", rfp);
+
+		int64_t pos = 0;
+		uint8_t const *p = NULL;
+		size_t len;
+		while((len = zfreadbuf(rfp, &p, rand() % 4096)) > 0) {
+			assert(pos + len <= TEST_ARR_LEN, "%s, %lld, %llu", modes[i], pos, len);
+			assert(memcmp(p, &arr[pos], len) == 0, "%s, %lld", modes[i], pos);
+
+			/* aligned buffer, zeroed padding after the end */
+			struct zf_intl_s *fio = (struct zf_intl_s *)rfp;
+			assert(((uintptr_t)fio->buf & 63) == 0, "%p", fio->buf);
+			for(int64_t k = 0; k < ZF_BUF_PADDING; k++) {
+				assert(p[len + k] == 0, "%s, %lld, %lld", modes[i], pos, k);
+			}
+
+			/* a part of the bytes are used, or getc / read from the rest */
+			size_t skip = rand() % (len + 1);
+			assert(zfconsume(rfp, skip) == skip);
+			pos += skip;
+			if(pos < TEST_ARR_LEN && (pos & 7) == 0) {
+				assert(zfgetc(rfp) == (uint8_t)arr[pos], "%lld", pos);
+				pos++;
+			}
+			if(pos > 0 && (pos & 7) == 1) {
+				assert(zfungetc(rfp, arr[pos - 1]) == (uint8_t)arr[pos - 1]);
+				pos--;
+			}
+			assert(zftell(rfp) == pos, "%lld, %lld", zftell(rfp), pos);
+		}
+		assert(pos == TEST_ARR_LEN, "%s, %lld", modes[i], pos);
+		assert(zfeof(rfp));
+		assert(zfgetc(rfp) == EOF);
+		assert(zfconsume(rfp, 1) == 0);
+		zfclose(rfp);
+	}
+	remove("tmp.txt");
+}
+
+/* write-behind, errors reported on close */
+unittest(with(TEST_ARR_LEN))
+{
+	omajinai();
+
+	char const *modes[3] = { "w@wb", "w@wb=1M", "w@wb=64M" };
+	char *rarr = (char *)malloc(TEST_ARR_LEN);
+	for(int64_t i = 0; i < 3; i++) {
+		zf_t *wfp = zfopen("tmp.txt", modes[i]);
+		assert(wfp != NULL, "%p", wfp);
+		assert(((struct zf_intl_s *)wfp)->wb != NULL);
+
+		/* putc, printf, and write mixed */
+		int64_t pos = 0;
+		while(pos < TEST_ARR_LEN) {
+			zfputc(wfp, arr[pos++]);
+			if(pos + 2 <= TEST_ARR_LEN) {
+				zfprintf(wfp, "%c%c", arr[pos], arr[pos + 1]);
+				pos += 2;
+			}
+			int64_t len = (pos + 300000 < TEST_ARR_LEN) ? 300000 : TEST_ARR_LEN - pos;
+			zfwrite(wfp, &arr[pos], len);
+			pos += len;
+		}
+		assert(zfclose(wfp) == 0);
+
+		zf_t *rfp = zfopen("tmp.txt", "r");
+		assert(zfread(rfp, rarr, TEST_ARR_LEN) == TEST_ARR_LEN);
+		assert(memcmp(arr, rarr, TEST_ARR_LEN) == 0, "%s", modes[i]);
+		zfclose(rfp);
+	}
+
+	/* no space left */
+	char const *fmodes[2] = { "w", "w@wb" };
+	for(int64_t i = 0; i < 2; i++) {
+		zf_t *wfp = zfopen("/dev/full", fmodes[i]);
+		assert(wfp != NULL, "%p", wfp);
+		zfwrite(wfp, arr, TEST_ARR_LEN);
+		assert(zfclose(wfp) != 0, "%s", fmodes[i]);
+	}
+
+	free(rarr);
+	remove("tmp.txt");
+}
+
+/* seek / tell */
+unittest(with(TEST_ARR_LEN))
+{
+	omajinai();
+
+	zf_t *wfp = zfopen("tmp.txt", "w");
+	zfwrite(wfp, arr, TEST_ARR_LEN / 2);
+	assert(zftell(wfp) == TEST_ARR_LEN / 2, "%lld", zftell(wfp));
+	for(int64_t i = TEST_ARR_LEN / 2; i < TEST_ARR_LEN; i++) {
+		zfputc(wfp, arr[i]);
+	}
+	assert(zftell(wfp) == TEST_ARR_LEN, "%lld", zftell(wfp));
+	assert(zfseek(wfp, 0, SEEK_SET) != 0);
+	zfclose(wfp);
+
+	zf_t *rfp = zfopen("tmp.txt", "r");
+	char buf[1024];
+
+	/* in the buffer */
+	assert(zfpeek(rfp, buf, 1024) == 1024);
+	assert(zfseek(rfp, 100, SEEK_CUR) == 0);
+	assert(zftell(rfp) == 100, "%lld", zftell(rfp));
+	assert(zfgetc(rfp) == arr[100]);
+	assert(zfseek(rfp, -1, SEEK_CUR) == 0);
+	assert(zfgetc(rfp) == arr[100]);
+
+	/* random */
+	for(int64_t i = 0; i < 100; i++) {
+		int64_t pos = rand() % (TEST_ARR_LEN - 1024);
+		assert(zfseek(rfp, pos, SEEK_SET) == 0, "%lld", pos);
+		assert(zftell(rfp) == pos, "%lld, %lld", zftell(rfp), pos);
+		assert(zfread(rfp, buf, 1024) == 1024);
+		assert(memcmp(buf, &arr[pos], 1024) == 0, "%lld", pos);
+		assert(zftell(rfp) == pos + 1024, "%lld, %lld", zftell(rfp), pos);
+	}
+
+	/* end */
+	assert(zfseek(rfp, TEST_ARR_LEN - 1, SEEK_SET) == 0);
+	assert(zfgetc(rfp) == arr[TEST_ARR_LEN - 1]);
+	assert(zfgetc(rfp) == EOF);
+	assert(zfseek(rfp, TEST_ARR_LEN + 1, SEEK_SET) != 0);
+
+	zfclose(rfp);
+	remove("tmp.txt");
+}
+
+#ifdef HAVE_IO_URING
+/* io_uring on plain files */
+unittest(with(TEST_ARR_LEN))
+{
+	omajinai();
+
+	/* the ring is not set up where io_uring is disabled */
+	struct zf_uring_s *probe = zf_uring_init(2);
+	int avail = (probe != NULL);
+	zf_uring_destroy(probe);
+
+	/* 3.5 times the array, written by blocks of odd lengths */
+	int64_t const len = 3 * TEST_ARR_LEN + TEST_ARR_LEN / 2;
+	char const *wmodes[2] = { "w@uring=2", "w@uring,buf=1K" };
+	char *rarr = (char *)malloc(len);
+	for(int64_t i = 0; i < 2; i++) {
+		zf_t *wfp = zfopen("tmp.txt", wmodes[i]);
+		assert(wfp != NULL, "%p", wfp);
+		assert((((struct zf_raw_s *)((struct zf_intl_s *)wfp)->fp)->ring != NULL) == avail, "%s", wmodes[i]);
+		for(int64_t pos = 0; pos < len; pos += 12345) {
+			int64_t l = (pos + 12345 < len) ? 12345 : len - pos;
+			assert(zfwrite(wfp, &arr[(pos + 12345 < TEST_ARR_LEN) ? pos : pos % (TEST_ARR_LEN - 12345)], l) == (size_t)l);
+		}
+		assert(zfclose(wfp) == 0, "%s", wmodes[i]);
+
+		zf_t *rfp = zfopen("tmp.txt", "r@uring=3");
+		assert(rfp != NULL, "%p", rfp);
+		assert((((struct zf_raw_s *)((struct zf_intl_s *)rfp)->fp)->ring != NULL) == avail);
+		assert(zfread(rfp, rarr, len) == (size_t)len);
+		assert(zfgetc(rfp) == EOF);
+		for(int64_t pos = 0; pos < len; pos += 12345) {
+			int64_t l = (pos + 12345 < len) ? 12345 : len - pos;
+			assert(memcmp(&rarr[pos], &arr[(pos + 12345 < TEST_ARR_LEN) ? pos : pos % (TEST_ARR_LEN - 12345)], l) == 0, "%lld", pos);
+		}
+
+		/* seek back and forth */
+		for(int64_t j = 0; j < 20; j++) {
+			int64_t pos = rand() % len;
+			assert(zfseek(rfp, pos, SEEK_SET) == 0, "%lld", pos);
+			assert(zfgetc(rfp) == (uint8_t)rarr[pos], "%lld", pos);
+		}
+		assert(zfclose(rfp) == 0);
+	}
+
+	/* appending is left to write(2) */
+	zf_t *afp = zfopen("tmp.txt", "a@uring");
+	assert(afp != NULL, "%p", afp);
+	assert(((struct zf_raw_s *)((struct zf_intl_s *)afp)->fp)->ring == NULL);
+	zfputc(afp, 'a');
+	assert(zfclose(afp) == 0);
+
+	/* truncated while read */
+	zf_t *rfp = zfopen("tmp.txt", "r@uring=3");
+	assert(truncate("tmp.txt", TEST_ARR_LEN) == 0);
+	size_t read = zfread(rfp, rarr, len);
+	assert(read < (size_t)len, "%zu", read);
+	zfclose(rfp);
+
+	free(rarr);
+	remove("tmp.txt");
+}
+#endif /* HAVE_IO_URING */
+
+/* zfread_async / zfwrite_async */
+unittest(with(TEST_ARR_LEN))
+{
+	omajinai();
+
+	char const *wmodes[2] = { "w", "w@wb" };
+	char const *rmodes[2] = { "r", "r@ra" };
+	char *rarr = (char *)malloc(TEST_ARR_LEN);
+	for(int64_t i = 0; i < 2; i++) {
+		zf_t *wfp = zfopen("tmp.txt", wmodes[i]);
+		assert(wfp != NULL, "%p", wfp);
+		assert(zfread_async(wfp, rarr, 1) == -1);
+
+		/* queued in order, collected out of order */
+		int64_t tokens[10];
+		for(int64_t j = 0; j < 10; j++) {
+			tokens[j] = zfwrite_async(wfp, &arr[j * (TEST_ARR_LEN / 10)], TEST_ARR_LEN / 10);
+			assert(tokens[j] > 0, "%lld", tokens[j]);
+		}
+		for(int64_t j = 9; j >= 0; j--) {
+			size_t len = 0;
+			assert(zfwait(wfp, tokens[j], &len) == 0);
+			assert(len == TEST_ARR_LEN / 10, "%zu", len);
+			assert(zfpoll(wfp, tokens[j], &len) == -1);
+		}
+		assert(zfpoll(wfp, tokens[9] + 1, NULL) == -1);
+		assert(zfclose(wfp) == 0);
+
+		/* completions counted on the eventfd */
+		zf_t *rfp = zfopen("tmp.txt", rmodes[i]);
+		assert(rfp != NULL, "%p", rfp);
+		assert(zfwrite_async(rfp, rarr, 1) == -1);
+		int efd = zfeventfd(rfp);
+		for(int64_t j = 0; j < 10; j++) {
+			tokens[j] = zfread_async(rfp, &rarr[j * (TEST_ARR_LEN / 10)], TEST_ARR_LEN / 10);
+		}
+		uint64_t cnt = 0;
+		while(efd >= 0 && cnt < 10) {
+			uint64_t c;
+			if(read(efd, &c, sizeof(uint64_t)) == sizeof(uint64_t)) { cnt += c; }
+		}
+		for(int64_t j = 0; j < 10; j++) {
+			size_t len = 0;
+			int ret;
+			while((ret = zfpoll(rfp, tokens[j], &len)) == 0) {}
+			assert(ret == 1 && len == TEST_ARR_LEN / 10, "%d, %zu", ret, len);
+		}
+		assert(memcmp(arr, rarr, TEST_ARR_LEN) == 0);
+
+		/* past the end, then closed with requests pending */
+		size_t len = 1;
+		assert(zfwait(rfp, zfread_async(rfp, rarr, 1), &len) == 0 && len == 0);
+		zfread_async(rfp, rarr, 1);
+		zfread_async(rfp, rarr, 1);
+		zfclose(rfp);
+	}
+	free(rarr);
+	remove("tmp.txt");
+}
+
+/* zlib-dependent tests */
+#ifdef HAVE_Z
+/* seek backward with the read-ahead, the codec reopened on the head */
+unittest(with(TEST_ARR_LEN))
+{
+	omajinai();
+
+	char const *wmodes[] = {
+		"w.bgz@4",
+#ifdef HAVE_BZ2
+		"w.bz2",
+#endif
+#ifdef HAVE_LZMA
+		"w.xz",
+#endif
+	};
+	char const *rmodes[2] = { "r@ra", "r@4,ra" };
+	char buf[1024];
+	for(uint64_t i = 0; i < sizeof(wmodes) / sizeof(wmodes[0]); i++) {
+		zf_t *wfp = zfopen("tmp.bin", wmodes[i]);
+		assert(wfp != NULL, "%s", wmodes[i]);
+		for(int64_t j = 0; j < 4; j++) {
+			zfwrite(wfp, arr, TEST_ARR_LEN);
+		}
+		assert(zfclose(wfp) == 0);
+
+		for(int64_t j = 0; j < 2; j++) {
+			zf_t *rfp = zfopen("tmp.bin", rmodes[j]);
+			assert(rfp != NULL, "%s, %s", wmodes[i], rmodes[j]);
+			for(int64_t k = 0; k < 8; k++) {
+				/* forward far enough to leave the buffer, then back */
+				int64_t fwd = 1024 * 1024 + rand() % (2 * TEST_ARR_LEN);
+				assert(zfseek(rfp, fwd, SEEK_SET) == 0, "%s, %s, %lld", wmodes[i], rmodes[j], fwd);
+				assert(zfgetc(rfp) == (uint8_t)arr[fwd % TEST_ARR_LEN]);
+				int64_t pos = rand() % (TEST_ARR_LEN / 2);
+				assert(zfseek(rfp, pos, SEEK_SET) == 0, "%s, %s, %lld", wmodes[i], rmodes[j], pos);
+				assert(zfread(rfp, buf, 1024) == 1024);
+				assert(memcmp(buf, &arr[pos], 1024) == 0, "%s, %s, %lld", wmodes[i], rmodes[j], pos);
+			}
+			assert(zfclose(rfp) == 0, "%s, %s", wmodes[i], rmodes[j]);
+		}
+	}
+	remove("tmp.bin");
+}
+
+unittest(with(TEST_ARR_LEN))
+{
+	omajinai();
+
+	/* write */
+	zf_t *wfp = zfopen("tmp.txt.gz", "w");
+	assert(wfp != NULL, "%p", wfp);
+
+	size_t written = zfwrite(wfp, arr, TEST_ARR_LEN);
+	assert(written == TEST_ARR_LEN, "%llu", written);
+
+	zfclose(wfp);
 
-	remove(filename);
-	zf_t *zf = zfopen(filename, "r");
-	assert(zf == NULL);
-}
+	/* read */
+	zf_t *rfp = zfopen("tmp.txt.gz", "r");
+	assert(rfp != NULL, "%p", rfp);
+	assert(strcmp(rfp->path, "tmp.txt") == 0, "%s", rfp->path);
 
-/* redirect to stdout */
-unittest()
-{
-	zf_t *zf = zfopen("-", "w");
-	assert(zf != NULL);
-	zfclose(zf);
+	char *rarr = (char *)malloc(TEST_ARR_LEN);
+	size_t read = zfread(rfp, rarr, TEST_ARR_LEN);
+	assert(read == TEST_ARR_LEN, "%llu", read);
+
+	/* EOF */
+	assert(zfgetc(rfp) == EOF, "%d", zfgetc(rfp));
+	assert(zfeof(rfp) != 0, "%d", zfeof(rfp));
+
+	zfclose(rfp);
+
+	/* compare */
+	assert(memcmp(arr, rarr, TEST_ARR_LEN) == 0);
+
+	/* cleanup */
+	free(rarr);
+	remove("tmp.txt.gz");
 }
 
-/* test zfopen / zfclose with len 100M */
-#define TEST_ARR_LEN 		1000000
+/* specify compression format with mode flag */
 unittest(with(TEST_ARR_LEN))
 {
 	omajinai();
 
 	/* write */
-	zf_t *wfp = zfopen("tmp.txt", "w");
+	zf_t *wfp = zfopen("tmpfile", "w.gz");
 	assert(wfp != NULL, "%p", wfp);
+	assert(strcmp(wfp->mode, "w") == 0, "%s", wfp->mode);
 
 	size_t written = zfwrite(wfp, arr, TEST_ARR_LEN);
 	assert(written == TEST_ARR_LEN, "%llu", written);
@@ -664,9 +9334,10 @@ unittest(with(TEST_ARR_LEN))
 	zfclose(wfp);
 
 	/* read */
-	zf_t *rfp = zfopen("tmp.txt", "r");
+	zf_t *rfp = zfopen("tmpfile", "r.gz");
 	assert(rfp != NULL, "%p", rfp);
-	assert(strcmp(rfp->path, "tmp.txt") == 0, "%s", rfp->path);
+	assert(strcmp(rfp->path, "tmpfile") == 0, "%s", rfp->path);
+	assert(strcmp(rfp->mode, "r") == 0, "%s", rfp->mode);
 
 	char *rarr = (char *)malloc(TEST_ARR_LEN);
 	size_t read = zfread(rfp, rarr, TEST_ARR_LEN);
@@ -681,85 +9352,730 @@ unittest(with(TEST_ARR_LEN))
 	/* compare */
 	assert(memcmp(arr, rarr, TEST_ARR_LEN) == 0);
 
+	/* cleanup */
+	free(rarr);
+	remove("tmpfile");
+}
+
+/* levels out of the range of deflate are clamped */
+unittest(with(TEST_ARR_LEN))
+{
+	omajinai();
+
+	char const *modes[5] = { "w19.gz", "w99.gz@2", "w10.bgz@2", "w00.gz", "w0.gz@2" };
+	char *rarr = (char *)malloc(TEST_ARR_LEN);
+	for(int64_t i = 0; i < 5; i++) {
+		zf_t *wfp = zfopen("tmp.txt", modes[i]);
+		assert(wfp != NULL, "%s", modes[i]);
+		size_t written = zfwrite(wfp, arr, TEST_ARR_LEN);
+		assert(written == TEST_ARR_LEN, "%s, %llu", modes[i], written);
+		assert(zfclose(wfp) == 0, "%s", modes[i]);
+
+		zf_t *rfp = zfopen("tmp.txt", "r");
+		assert(rfp != NULL, "%s", modes[i]);
+		size_t read = zfread(rfp, rarr, TEST_ARR_LEN);
+		assert(read == TEST_ARR_LEN, "%s, %llu", modes[i], read);
+		assert(memcmp(arr, rarr, TEST_ARR_LEN) == 0, "%s", modes[i]);
+		zfclose(rfp);
+	}
+
+	/* up to 12 for BGZF on libdeflate */
+	#ifdef HAVE_LIBDEFLATE
+	zf_t *wfp = zfopen("tmp.txt", "w12.bgz@2,eng=libdeflate");
+	assert(((struct zf_bgzfw_s *)((struct zf_intl_s *)wfp)->fp)->level == 12);
+	zfwrite(wfp, arr, TEST_ARR_LEN);
+	assert(zfclose(wfp) == 0);
+	zf_t *rfp = zfopen("tmp.txt", "r");
+	assert(zfread(rfp, rarr, TEST_ARR_LEN) == TEST_ARR_LEN);
+	assert(memcmp(arr, rarr, TEST_ARR_LEN) == 0);
+	zfclose(rfp);
+	#endif
+	zf_t *zfp = zfopen("tmp.txt", "w12.bgz@2,eng=zlib");
+	assert(((struct zf_bgzfw_s *)((struct zf_intl_s *)zfp)->fp)->level == 9);
+	zfclose(zfp);
+
 	/* cleanup */
 	free(rarr);
 	remove("tmp.txt");
 }
 
-/* getc / putc */
+/* parallel compression, output must not depend on the number of threads */
 unittest(with(TEST_ARR_LEN))
 {
 	omajinai();
 
-	/* write with zfputc */
-	zf_t *wfp = zfopen("tmp.txt", "w");
+	char const *modes[3] = { "w.gz@1", "w.gz@4", "w.gz@" };
+	char *warr[3] = { NULL };
+	size_t wlen[3] = { 0 };
+	for(int64_t i = 0; i < 3; i++) {
+		zf_t *wfp = zfopen("tmpfile", modes[i]);
+		assert(wfp != NULL, "%p", wfp);
+		assert(strcmp(wfp->mode, "w") == 0, "%s", wfp->mode);
+
+		size_t written = zfwrite(wfp, arr, TEST_ARR_LEN / 2);
+		assert(written == TEST_ARR_LEN / 2, "%llu", written);
+		for(int64_t j = TEST_ARR_LEN / 2; j < TEST_ARR_LEN; j++) {
+			zfputc(wfp, arr[j]);
+		}
+		zfclose(wfp);
 
-	for(int64_t i = 0; i < TEST_ARR_LEN; i++) {
-		zfputc(wfp, arr[i]);
+		/* load compressed image */
+		FILE *fp = fopen("tmpfile", "rb");
+		warr[i] = (char *)malloc(2 * TEST_ARR_LEN);
+		wlen[i] = fread(warr[i], 1, 2 * TEST_ARR_LEN, fp);
+		fclose(fp);
 	}
+	assert(wlen[0] == wlen[1] && memcmp(warr[0], warr[1], wlen[0]) == 0);
+	assert(wlen[0] == wlen[2] && memcmp(warr[0], warr[2], wlen[0]) == 0);
 
-	zfclose(wfp);
+	/* read with zlib */
+	zf_t *rfp = zfopen("tmpfile", "r.gz");
+	assert(rfp != NULL, "%p", rfp);
 
-	/* read with zfgetc */
-	zf_t *rfp = zfopen("tmp.txt", "r");
+	char *rarr = (char *)malloc(TEST_ARR_LEN);
+	size_t read = zfread(rfp, rarr, TEST_ARR_LEN);
+	assert(read == TEST_ARR_LEN, "%llu", read);
+	assert(zfgetc(rfp) == EOF, "%d", zfgetc(rfp));
+	zfclose(rfp);
+
+	assert(memcmp(arr, rarr, TEST_ARR_LEN) == 0);
+
+	/* cleanup */
+	for(int64_t i = 0; i < 3; i++) { free(warr[i]); }
+	free(rarr);
+	remove("tmpfile");
+}
+
+/**
+ * @fn make_bgzf
+ * @brief write BGZF file with zlib
+ */
+static
+void make_bgzf(
+	char const *path,
+	char const *arr,
+	size_t len)
+{
+	FILE *fp = fopen(path, "wb");
+	uint8_t *out = (uint8_t *)malloc(ZF_BGZF_BLOCK_SIZE);
+	for(size_t pos = 0; pos <= len; pos += 0xff00) {
+		size_t size = (len - pos < 0xff00) ? len - pos : 0xff00;
+
+		z_stream zs = { 0 };
+		deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+		zs.next_in = (uint8_t *)&arr[pos];
+		zs.avail_in = size;
+		zs.next_out = out + 18;
+		zs.avail_out = ZF_BGZF_BLOCK_SIZE - 26;
+		deflate(&zs, Z_FINISH);
+		size_t bsize = 18 + zs.total_out + 8 - 1;
+		deflateEnd(&zs);
+
+		uint32_t crc = crc32(0, (uint8_t const *)&arr[pos], size);
+		uint8_t const head[18] = {
+			0x1f, 0x8b, 0x08, 0x04, 0, 0, 0, 0, 0, 0xff, 6, 0, 'B', 'C', 2, 0, bsize, bsize>>8
+		};
+		uint8_t const tail[8] = { crc, crc>>8, crc>>16, crc>>24, size, size>>8, size>>16, size>>24 };
+		memcpy(out, head, 18);
+		memcpy(out + bsize + 1 - 8, tail, 8);
+		fwrite(out, 1, bsize + 1, fp);
+	}
+	free(out);
+	fclose(fp);
+}
+
+/* parallel BGZF decompression */
+unittest(with(TEST_ARR_LEN))
+{
+	omajinai();
+	make_bgzf("tmp.txt.gz", arr, TEST_ARR_LEN);
+
+	/* read with zfread */
+	zf_t *rfp = zfopen("tmp.txt.gz", "r@4");
+	assert(rfp != NULL, "%p", rfp);
+	assert(strcmp(rfp->path, "tmp.txt") == 0, "%s", rfp->path);
 
 	char *rarr = (char *)malloc(TEST_ARR_LEN);
+	size_t read = zfread(rfp, rarr, TEST_ARR_LEN);
+	assert(read == TEST_ARR_LEN, "%llu", read);
+	assert(zfgetc(rfp) == EOF, "%d", zfgetc(rfp));
+	assert(zfeof(rfp) != 0, "%d", zfeof(rfp));
+	zfclose(rfp);
+	assert(memcmp(arr, rarr, TEST_ARR_LEN) == 0);
+
+	/* read with zfgetc */
+	memset(rarr, 0, TEST_ARR_LEN);
+	rfp = zfopen("tmp.txt.gz", "r@2");
 	for(int64_t i = 0; i < TEST_ARR_LEN; i++) {
 		rarr[i] = zfgetc(rfp);
 	}
-
-	/* EOF */
 	assert(zfgetc(rfp) == EOF, "%d", zfgetc(rfp));
-	assert(zfeof(rfp) != 0, "%d", zfeof(rfp));
+	zfclose(rfp);
+	assert(memcmp(arr, rarr, TEST_ARR_LEN) == 0);
+
+	/* close before reaching the end */
+	rfp = zfopen("tmp.txt.gz", "r@4");
+	assert(zfgetc(rfp) == arr[0]);
+	assert(zfclose(rfp) == 0);
+
+	/* broken crc in the second block is reported on close */
+	FILE *fp = fopen("tmp.txt.gz", "r+b");
+	uint8_t head[18];
+	assert(fread(head, 1, 18, fp) == 18);
+	int64_t second = (head[16] | (head[17]<<8)) + 1;
+	assert(fseek(fp, second, SEEK_SET) == 0 && fread(head, 1, 18, fp) == 18);
+	int64_t crc = second + (head[16] | (head[17]<<8)) + 1 - 8;
+	assert(fseek(fp, crc, SEEK_SET) == 0 && fread(head, 1, 1, fp) == 1);
+	head[0] ^= 0xff;
+	assert(fseek(fp, crc, SEEK_SET) == 0 && fwrite(head, 1, 1, fp) == 1);
+	fclose(fp);
+
+	char const *modes[3] = { "r", "r@1", "r@4" };
+	for(int64_t i = 0; i < 3; i++) {
+		rfp = zfopen("tmp.txt.gz", modes[i]);
+		assert(rfp != NULL, "%s", modes[i]);
+		read = zfread(rfp, rarr, TEST_ARR_LEN);
+		assert(read < TEST_ARR_LEN, "%s, %llu", modes[i], read);
+		assert(zfclose(rfp) != 0, "%s", modes[i]);
+	}
+
+	/* kept over the codec reopened by a seek back, which does not reach the broken last block again */
+	make_bgzf("tmp.txt.gz", arr, TEST_ARR_LEN);
+	fp = fopen("tmp.txt.gz", "r+b");
+	int64_t last = 0;
+	while(fseek(fp, last, SEEK_SET) == 0 && fread(head, 1, 18, fp) == 18) {
+		crc = last + (head[16] | (head[17]<<8)) + 1 - 8;
+		last += (head[16] | (head[17]<<8)) + 1;
+	}
+	assert(fseek(fp, crc, SEEK_SET) == 0 && fread(head, 1, 1, fp) == 1);
+	head[0] ^= 0xff;
+	assert(fseek(fp, crc, SEEK_SET) == 0 && fwrite(head, 1, 1, fp) == 1);
+	fclose(fp);
+	for(int64_t i = 0; i < 3; i++) {
+		rfp = zfopen("tmp.txt.gz", modes[i]);
+		zfread(rfp, rarr, TEST_ARR_LEN);
+		assert(zfgetc(rfp) == EOF);
+		assert(zfseek(rfp, 0, SEEK_SET) == 0, "%s", modes[i]);
+		assert(zfgetc(rfp) == arr[0]);
+		assert(zfclose(rfp) != 0, "%s", modes[i]);
+	}
+
+	/* plain gzip with two members falls back to the single-threaded path */
+	zf_t *wfp = zfopen("tmp.txt.gz", "w");
+	zfwrite(wfp, arr, TEST_ARR_LEN / 2);
+	zfclose(wfp);
+	wfp = zfopen("tmp.txt.gz", "a");
+	zfwrite(wfp, &arr[TEST_ARR_LEN / 2], TEST_ARR_LEN / 2);
+	zfclose(wfp);
 
+	memset(rarr, 0, TEST_ARR_LEN);
+	rfp = zfopen("tmp.txt.gz", "r@4");
+	read = zfread(rfp, rarr, TEST_ARR_LEN);
+	assert(read == TEST_ARR_LEN, "%llu", read);
+	assert(zfgetc(rfp) == EOF, "%d", zfgetc(rfp));
 	zfclose(rfp);
+	assert(memcmp(arr, rarr, TEST_ARR_LEN) == 0);
 
-	/* compare */
+	/* cleanup */
+	free(rarr);
+	remove("tmp.txt.gz");
+}
+
+/* BGZF compression with index */
+unittest(with(TEST_ARR_LEN))
+{
+	omajinai();
+
+	/* incompressible in the latter half */
+	for(int64_t i = TEST_ARR_LEN / 2; i < TEST_ARR_LEN; i++) {
+		arr[i] = rand();
+	}
+
+	zf_t *wfp = zfopen("tmp.txt.bgz", "w@3,gzi");
+	assert(wfp != NULL, "%p", wfp);
+	size_t written = zfwrite(wfp, arr, TEST_ARR_LEN);
+	assert(written == TEST_ARR_LEN, "%llu", written);
+	zfclose(wfp);
+
+	/* read with both of zlib and the parallel decompressor */
+	char const *modes[2] = { "r", "r@2" };
+	char *rarr = (char *)malloc(TEST_ARR_LEN);
+	for(int64_t i = 0; i < 2; i++) {
+		zf_t *rfp = zfopen("tmp.txt.bgz", modes[i]);
+		assert(rfp != NULL, "%p", rfp);
+		assert(strcmp(rfp->path, "tmp.txt") == 0, "%s", rfp->path);
+
+		memset(rarr, 0, TEST_ARR_LEN);
+		size_t read = zfread(rfp, rarr, TEST_ARR_LEN);
+		assert(read == TEST_ARR_LEN, "%llu", read);
+		assert(zfgetc(rfp) == EOF, "%d", zfgetc(rfp));
+		zfclose(rfp);
+		assert(memcmp(arr, rarr, TEST_ARR_LEN) == 0);
+	}
+
+	/* index: (compressed, uncompressed) offsets of the block heads except for the first */
+	FILE *fp = fopen("tmp.txt.bgz", "rb");
+	uint8_t *img = (uint8_t *)malloc(2 * TEST_ARR_LEN);
+	size_t img_len = fread(img, 1, 2 * TEST_ARR_LEN, fp);
+	fclose(fp);
+
+	fp = fopen("tmp.txt.bgz.gzi", "rb");
+	assert(fp != NULL, "%p", fp);
+	uint64_t cnt = 0, coffset = 0, uoffset = 0;
+	assert(fread(&cnt, 8, 1, fp) == 1);
+	assert(cnt == (TEST_ARR_LEN + 0xfeff) / 0xff00, "%llu", cnt);
+	for(uint64_t i = 0; i < cnt; i++) {
+		assert(fread(&coffset, 8, 1, fp) == 1);
+		assert(fread(&uoffset, 8, 1, fp) == 1);
+		assert(coffset + 28 <= img_len, "%llu, %llu", coffset, img_len);
+		assert(img[coffset] == 0x1f && img[coffset + 1] == 0x8b, "%llu", i);
+		assert(uoffset == ((i + 1) * 0xff00 < TEST_ARR_LEN ? (i + 1) * 0xff00 : TEST_ARR_LEN), "%llu", uoffset);
+	}
+	assert(coffset + 28 == img_len, "%llu, %llu", coffset, img_len);
+	fclose(fp);
+
+	/* cleanup */
+	free(img);
+	free(rarr);
+	remove("tmp.txt.bgz");
+	remove("tmp.txt.bgz.gzi");
+}
+
+/* deflate engines, unknown or unavailable ones fail the open */
+unittest(with(TEST_ARR_LEN))
+{
+	omajinai();
+
+	/* incompressible in the latter half, for the stored blocks */
+	char *warr = (char *)malloc(TEST_ARR_LEN);
+	memcpy(warr, arr, TEST_ARR_LEN / 2);
+	for(int64_t i = TEST_ARR_LEN / 2; i < TEST_ARR_LEN; i++) {
+		warr[i] = rand();
+	}
+
+	/* BGZF on the workers, and plain gzip in two members on the serial reader and writer */
+	char const *names[ZF_GZENG_CNT] = { "auto", "zlib", "libdeflate", "isal", "zlib-ng" };
+	char const *fmts[2][3] = {
+		{ "tmp.txt.bgz", "w9@2,eng=%s", "r@2,eng=%s" },
+		{ "tmp.txt.gz", "w@eng=%s", "r@1,eng=%s" }
+	};
+	char *rarr = (char *)malloc(TEST_ARR_LEN);
+	for(int64_t e = 0; e < ZF_GZENG_CNT; e++) {
+		for(int64_t f = 0; f < 2; f++) {
+			char wmode[32], rmode[32];
+			snprintf(wmode, 32, fmts[f][1], names[e]);
+			snprintf(rmode, 32, fmts[f][2], names[e]);
+			if(zf_gzeng_avail(e) == 0) {
+				assert(zfopen(fmts[f][0], wmode) == NULL, "%s", wmode);
+				assert(zfopen(fmts[f][0], rmode) == NULL, "%s", rmode);
+				continue;
+			}
+
+			zf_t *wfp = zfopen(fmts[f][0], wmode);
+			assert(wfp != NULL, "%s", wmode);
+			zfwrite(wfp, warr, (f == 0) ? TEST_ARR_LEN : TEST_ARR_LEN / 2);
+			assert(zfclose(wfp) == 0);
+			if(f == 1) {
+				wmode[0] = 'a';
+				wfp = zfopen(fmts[f][0], wmode);
+				zfwrite(wfp, &warr[TEST_ARR_LEN / 2], TEST_ARR_LEN / 2);
+				assert(zfclose(wfp) == 0);
+			}
+
+			/* by the same engine and by zlib */
+			char const *rmodes[2] = { rmode, (f == 0) ? "r@2,eng=zlib" : "r@1,eng=zlib" };
+			for(int64_t j = 0; j < 2; j++) {
+				zf_t *rfp = zfopen(fmts[f][0], rmodes[j]);
+				assert(rfp != NULL, "%s", rmodes[j]);
+				if(f == 1) {
+					struct zf_gzr_s *gz = (struct zf_gzr_s *)((struct zf_intl_s *)rfp)->fp;
+					assert(gz->kind == ZF_GZR_SERIAL, "%d", gz->kind);
+					assert((gz->dctx != NULL) == (j == 0 && zf_gzeng_get_stream(e) != NULL), "%s", rmodes[j]);
+				}
+				memset(rarr, 0, TEST_ARR_LEN);
+				size_t read = zfread(rfp, rarr, TEST_ARR_LEN);
+				assert(read == TEST_ARR_LEN, "%zu", read);
+				assert(zfgetc(rfp) == EOF, "%d", zfgetc(rfp));
+				assert(memcmp(warr, rarr, TEST_ARR_LEN) == 0, "%s, %s", wmode, rmodes[j]);
+				if(f == 1) {
+					assert(zfseek(rfp, TEST_ARR_LEN / 3, SEEK_SET) == 0);
+					assert(zfgetc(rfp) == (uint8_t)warr[TEST_ARR_LEN / 3]);
+				}
+				assert(zfclose(rfp) == 0);
+			}
+		}
+
+		/* broken crc of the second member */
+		if(zf_gzeng_avail(e) == 0) { continue; }
+		FILE *fp = fopen("tmp.txt.gz", "r+b");
+		fseek(fp, -8, SEEK_END);
+		int c = fgetc(fp);
+		fseek(fp, -8, SEEK_END);
+		fputc(c ^ 0xff, fp);
+		fclose(fp);
+
+		char rmode[32];
+		snprintf(rmode, 32, fmts[1][2], names[e]);
+		zf_t *rfp = zfopen("tmp.txt.gz", rmode);
+		zfread(rfp, rarr, TEST_ARR_LEN);
+		assert(zfclose(rfp) != 0, "%s", rmode);
+	}
+
+	/* environment variable, overridden by the mode string */
+	setenv("ZF_GZ_ENGINE", "zlib", 1);
+	struct zf_params_s params = zf_parse_params(NULL);
+	assert(params.eng == ZF_GZENG_ZLIB, "%d", params.eng);
+	params = zf_parse_params("@4,eng=zlib-ng");
+	assert(params.eng == ZF_GZENG_ZLIBNG, "%d", params.eng);
+	setenv("ZF_GZ_ENGINE", "unknown", 1);
+	assert(zfopen("tmp.txt.gz", "r") == NULL);
+	unsetenv("ZF_GZ_ENGINE");
+	params = zf_parse_params("@eng=unknown");
+	assert(params.eng == -1, "%d", params.eng);
+	assert(zfopen("tmp.txt.gz", "r@eng=unknown") == NULL);
+	assert(zf_gzeng_get(ZF_GZENG_AUTO)->inflate != NULL);
+
+	/* cleanup */
+	free(warr);
+	free(rarr);
+	remove("tmp.txt.bgz");
+	remove("tmp.txt.gz");
+}
+
+/* random access with / without index, on two members */
+unittest(with(TEST_ARR_LEN))
+{
+	omajinai();
+
+	zf_t *wfp = zfopen("tmp.txt.gz", "w");
+	zfwrite(wfp, arr, TEST_ARR_LEN / 2);
+	zfclose(wfp);
+	wfp = zfopen("tmp.txt.gz", "a");
+	zfwrite(wfp, &arr[TEST_ARR_LEN / 2], TEST_ARR_LEN / 2);
+	zfclose(wfp);
+	remove("tmp.txt.gz.zfi");
+
+	/* build index with the first sequential read */
+	char *rarr = (char *)malloc(TEST_ARR_LEN);
+	zf_t *rfp = zfopen("tmp.txt.gz", "r@idx=64K");
+	assert(rfp != NULL, "%p", rfp);
+	assert(zfread(rfp, rarr, TEST_ARR_LEN) == TEST_ARR_LEN);
+	assert(zfgetc(rfp) == EOF);
+	zfclose(rfp);
 	assert(memcmp(arr, rarr, TEST_ARR_LEN) == 0);
 
+	char const *modes[2] = { "r@idx=64K", "r" };
+	for(int64_t i = 0; i < 2; i++) {
+		rfp = zfopen("tmp.txt.gz", modes[i]);
+		assert(rfp != NULL, "%p", rfp);
+		if(i == 0) {
+			struct zf_gzr_s *gz = (struct zf_gzr_s *)((struct zf_intl_s *)rfp)->fp;
+			assert(gz->idx != NULL && gz->idx->loaded != 0 && gz->idx->cnt > 8);
+		}
+
+		char buf[1024];
+		for(int64_t j = 0; j < 50; j++) {
+			int64_t pos = (j == 0) ? 0 : rand() % (TEST_ARR_LEN - 1024);
+			assert(zfseek(rfp, pos, SEEK_SET) == 0, "%lld", pos);
+			assert(zftell(rfp) == pos, "%lld, %lld", zftell(rfp), pos);
+			assert(zfread(rfp, buf, 1024) == 1024);
+			assert(memcmp(buf, &arr[pos], 1024) == 0, "%lld", pos);
+		}
+		assert(zfseek(rfp, TEST_ARR_LEN - 1, SEEK_SET) == 0);
+		assert(zfgetc(rfp) == arr[TEST_ARR_LEN - 1]);
+		assert(zfgetc(rfp) == EOF);
+		assert(zfclose(rfp) == 0);
+	}
+
+	/* the index is not taken for a modified file of the same size: mtime changed, then the head changed with mtime kept */
+	struct stat st;
+	assert(stat("tmp.txt.gz", &st) == 0);
+	for(int64_t i = 0; i < 2; i++) {
+		struct utimbuf t = { st.st_atime, st.st_mtime + 10 * (1 - i) };
+		if(i == 1) {
+			FILE *fp = fopen("tmp.txt.gz", "r+b");
+			fseek(fp, 4, SEEK_SET);		/* MTIME in the gzip header */
+			fputc(0x5a, fp);
+			fclose(fp);
+		}
+		assert(utime("tmp.txt.gz", &t) == 0);
+
+		rfp = zfopen("tmp.txt.gz", "r@idx=64K");
+		struct zf_gzr_s *gz = (struct zf_gzr_s *)((struct zf_intl_s *)rfp)->fp;
+		assert(gz->idx != NULL && gz->idx->loaded == 0, "%lld", i);
+		zfclose(rfp);			/* not read to the end, the stale index is left as is */
+	}
+
 	/* cleanup */
 	free(rarr);
-	remove("tmp.txt");
+	remove("tmp.txt.gz");
+	remove("tmp.txt.gz.zfi");
 }
 
-/* peek */
-unittest(with(100000))
+/* small files inflated at once, falling back to the streaming reader if broken */
+unittest(with(TEST_ARR_LEN))
 {
 	omajinai();
 
-	/* write */
-	zf_t *wfp = zfopen("tmp.txt", "w");
-	zfwrite(wfp, arr, 100000);
+	/* two members and trailing garbage */
+	zf_t *wfp = zfopen("tmp.txt.gz", "w");
+	zfwrite(wfp, arr, TEST_ARR_LEN / 2);
+	zfclose(wfp);
+	wfp = zfopen("tmp.txt.gz", "a");
+	zfwrite(wfp, &arr[TEST_ARR_LEN / 2], TEST_ARR_LEN / 2);
 	zfclose(wfp);
+	FILE *fp = fopen("tmp.txt.gz", "ab");
+	fputs("garbage", fp);
+	fclose(fp);
 
-	/* read */
-	zf_t *rfp = zfopen("tmp.txt", "r");
+	char *rarr = (char *)malloc(TEST_ARR_LEN);
+	char const *modes[3] = { "r", "r@eng=zlib", "r@1" };
+	for(int64_t i = 0; i < 3; i++) {
+		zf_t *rfp = zfopen("tmp.txt.gz", modes[i]);
+		assert(rfp != NULL, "%p", rfp);
+		struct zf_gzr_s *gz = (struct zf_gzr_s *)((struct zf_intl_s *)rfp)->fp;
+		assert(gz->kind == ((i < 2) ? ZF_GZR_WHOLE : ZF_GZR_SERIAL), "%d", gz->kind);
+		assert(gz->whole_size <= ZF_UNGETC_MARGIN_SIZE + TEST_ARR_LEN + ZF_BUF_PADDING, "%zu", gz->whole_size);	/* not sized from the garbage */
+
+		/* served out of the inflated content, without the own buffer */
+		struct zf_intl_s *fio = (struct zf_intl_s *)rfp;
+		if(i < 2) {
+			assert(fio->buf == &gz->whole[ZF_UNGETC_MARGIN_SIZE] && fio->mem.ptr == NULL);
+			assert(fio->end == TEST_ARR_LEN && fio->buf[fio->end] == 0);
+			assert(zfungetc(rfp, 'y') == 'y');		/* in front of the content */
+			assert(zfgetc(rfp) == 'y');
+		}
 
-	char *rarr1 = (char *)malloc(TEST_ARR_LEN);
-	char *rarr2 = (char *)malloc(TEST_ARR_LEN);
-	
-	/* read the former half */
-	size_t read1 = zfpeek(rfp, rarr1, 50000);
-	assert(zfeof(rfp) == 0, "%d", zfeof(rfp));
-	assert(read1 == 50000, "%llu", read1);
+		memset(rarr, 0, TEST_ARR_LEN);
+		for(int64_t j = 0; j < TEST_ARR_LEN; j++) {
+			rarr[j] = zfgetc(rfp);
+		}
+		assert(zfgetc(rfp) == EOF, "%d", zfgetc(rfp));
+		assert(memcmp(arr, rarr, TEST_ARR_LEN) == 0);
+
+		assert(zfseek(rfp, TEST_ARR_LEN / 3, SEEK_SET) == 0);
+		assert(zfgetc(rfp) == arr[TEST_ARR_LEN / 3]);
+		uint8_t const *p;
+		size_t avail = zfreadbuf(rfp, &p, 1);
+		assert(avail == TEST_ARR_LEN - TEST_ARR_LEN / 3 - 1 || i == 2, "%zu", avail);	/* the rest at once if mapped */
+		assert(memcmp(p, &arr[TEST_ARR_LEN / 3 + 1], avail) == 0);
+		assert(zfclose(rfp) == 0);
+	}
+
+	/* broken crc of the second member */
+	fp = fopen("tmp.txt.gz", "r+b");
+	fseek(fp, -(8 + 7), SEEK_END);
+	fputc(fgetc(fp) ^ 0xff, fp);
+	fclose(fp);
+
+	zf_t *rfp = zfopen("tmp.txt.gz", "r");
+	assert(rfp != NULL, "%p", rfp);
+	struct zf_gzr_s *gz = (struct zf_gzr_s *)((struct zf_intl_s *)rfp)->fp;
+	assert(gz->kind == ZF_GZR_SERIAL, "%d", gz->kind);
+	size_t read = zfread(rfp, rarr, TEST_ARR_LEN);
+	assert(memcmp(arr, rarr, read) == 0);
+	zfclose(rfp);
+
+	/* small but expanding beyond ZF_GZR_WHOLE_OUT_SIZE */
+	size_t const zlen = 1024 * 1024, nz = ZF_GZR_WHOLE_OUT_SIZE / zlen + 1;
+	char *zarr = (char *)calloc(zlen, 1);
+	wfp = zfopen("tmp.txt.gz", "w");
+	for(size_t i = 0; i < nz; i++) { zfwrite(wfp, zarr, zlen); }
+	zfclose(wfp);
+
+	rfp = zfopen("tmp.txt.gz", "r");
+	assert(rfp != NULL, "%p", rfp);
+	gz = (struct zf_gzr_s *)((struct zf_intl_s *)rfp)->fp;
+	assert(gz->kind == ZF_GZR_SERIAL, "%d", gz->kind);
+	assert(gz->whole == NULL, "%p", gz->whole);
+	size_t total = 0;
+	while((read = zfread(rfp, zarr, zlen)) > 0) {
+		assert(zarr[read - 1] == 0, "%d", zarr[read - 1]);
+		total += read;
+	}
+	assert(total == nz * zlen, "%zu", total);
+	assert(zfclose(rfp) == 0);
+
+	/* cleanup */
+	free(zarr);
+	free(rarr);
+	remove("tmp.txt.gz");
+}
+
+/* speculative parallel decompression of plain gzip */
+unittest()
+{
+	/* random letters, so that the compressed size spans several chunks */
+	int64_t const len = 4 * ZF_GZSP_CHUNK_SIZE;
+	char *warr = (char *)malloc(len);
+	for(int64_t i = 0; i < len; i++) {
+		warr[i] = 'a' + rand() % 26;
+	}
+	zf_t *wfp = zfopen("tmp.txt.gz", "w");
+	zfwrite(wfp, warr, len);
+	zfclose(wfp);
+
+	char *rarr = (char *)malloc(len);
+	char const *modes[2] = { "r@2", "r@4" };
+	for(int64_t i = 0; i < 2; i++) {
+		zf_t *rfp = zfopen("tmp.txt.gz", modes[i]);
+		assert(rfp != NULL, "%p", rfp);
+		struct zf_gzr_s *gz = (struct zf_gzr_s *)((struct zf_intl_s *)rfp)->fp;
+		assert(gz->kind == ZF_GZR_SPEC, "%d", gz->kind);
+
+		memset(rarr, 0, len);
+		size_t read = zfread(rfp, rarr, len);
+		assert(read == len, "%llu", read);
+		assert(zfgetc(rfp) == EOF, "%d", zfgetc(rfp));
+		assert(memcmp(warr, rarr, len) == 0);
+		assert(gz->spec_next > 1 && gz->spec_redo == 0, "%llu, %llu", gz->spec_next, gz->spec_redo);	/* taken as decoded by the workers */
+
+		/* backward and forward */
+		char buf[1024];
+		for(int64_t j = 0; j < 5; j++) {
+			int64_t pos = rand() % (len - 1024);
+			assert(zfseek(rfp, pos, SEEK_SET) == 0, "%lld", pos);
+			assert(zfread(rfp, buf, 1024) == 1024);
+			assert(memcmp(buf, &warr[pos], 1024) == 0, "%lld", pos);
+		}
+		zfclose(rfp);
+	}
+
+	/* second member, then broken trailer */
+	wfp = zfopen("tmp.txt.gz", "a");
+	zfwrite(wfp, warr, len / 2);
+	zfclose(wfp);
+
+	zf_t *rfp = zfopen("tmp.txt.gz", "r@3");
+	assert(zfread(rfp, rarr, len) == len);
+	assert(memcmp(warr, rarr, len) == 0);
+	assert(zfread(rfp, rarr, len) == len / 2);
+	assert(memcmp(warr, rarr, len / 2) == 0);
+	assert(zfclose(rfp) == 0);
+
+	/* single worker falls back to the serial reader */
+	rfp = zfopen("tmp.txt.gz", "r@1");
+	assert(((struct zf_gzr_s *)((struct zf_intl_s *)rfp)->fp)->kind == ZF_GZR_SERIAL);
+	assert(zfread(rfp, rarr, len) == len);
+	assert(memcmp(warr, rarr, len) == 0);
+	zfclose(rfp);
+
+	/* broken trailer of the second member, and broken data in the first; reported on close */
+	int64_t const offsets[2] = { -8, ZF_GZSP_CHUNK_SIZE + 12345 };
+	for(int64_t i = 0; i < 2; i++) {
+		for(int64_t j = 0; j < 2; j++) {
+			/* flip, then restore */
+			FILE *fp = fopen("tmp.txt.gz", "r+b");
+			fseek(fp, offsets[i], (offsets[i] < 0) ? SEEK_END : SEEK_SET);
+			int c = fgetc(fp);
+			fseek(fp, offsets[i], (offsets[i] < 0) ? SEEK_END : SEEK_SET);
+			fputc(c ^ 0xff, fp);
+			fclose(fp);
+			if(j == 1) { break; }
+
+			rfp = zfopen("tmp.txt.gz", "r@3");
+			assert(((struct zf_gzr_s *)((struct zf_intl_s *)rfp)->fp)->kind == ZF_GZR_SPEC);
+			size_t read = zfread(rfp, rarr, len);
+			read += zfread(rfp, rarr, len);
+			assert(read <= len + len / 2, "%llu", read);
+			assert(zfclose(rfp) != 0, "%lld", i);
+		}
+	}
+
+	/* cleanup */
+	free(warr);
+	free(rarr);
+	remove("tmp.txt.gz");
+}
+
+/* many small members decoded in parallel */
+unittest()
+{
+	int64_t const len = 4 * ZF_GZSP_CHUNK_SIZE, mlen = 8192;
+	char *warr = (char *)malloc(len);
+	for(int64_t i = 0; i < len; i++) {
+		warr[i] = 'a' + rand() % 26;
+	}
+	remove("tmp.txt.gz");
+	for(int64_t i = 0; i < len; i += mlen) {
+		zf_t *wfp = zfopen("tmp.txt.gz", "a");
+		zfwrite(wfp, &warr[i], mlen);
+		zfclose(wfp);
+	}
+
+	char *rarr = (char *)malloc(len);
+	zf_t *rfp = zfopen("tmp.txt.gz", "r@4");
+	assert(rfp != NULL, "%p", rfp);
+	struct zf_gzr_s *gz = (struct zf_gzr_s *)((struct zf_intl_s *)rfp)->fp;
+	assert(gz->kind == ZF_GZR_SPEC, "%d", gz->kind);
+	assert(zfread(rfp, rarr, len) == len);
+	assert(zfgetc(rfp) == EOF, "%d", zfgetc(rfp));
+	assert(gz->err == 0, "%d", gz->err);
+	assert(memcmp(warr, rarr, len) == 0);
+
+	char buf[1024];
+	for(int64_t j = 0; j < 5; j++) {
+		int64_t pos = rand() % (len - 1024);
+		assert(zfseek(rfp, pos, SEEK_SET) == 0, "%lld", pos);
+		assert(zfread(rfp, buf, 1024) == 1024);
+		assert(memcmp(buf, &warr[pos], 1024) == 0, "%lld", pos);
+	}
+	assert(zfclose(rfp) == 0);
+
+	/* broken crc of a member in the middle */
+	FILE *fp = fopen("tmp.txt.gz", "r+b");
+	fseek(fp, 0, SEEK_END);
+	fseek(fp, ftell(fp) / 2, SEEK_SET);
+	uint8_t b[64 * 1024];
+	size_t n = fread(b, 1, sizeof(b), fp);
+	for(size_t k = 8; k + 10 < n; k++) {
+		if(b[k] != 0x1f || b[k + 1] != 0x8b || b[k + 2] != 0x08) { continue; }
+		fseek(fp, (long)k - (long)n - 8, SEEK_CUR);
+		fputc(~b[k - 8] & 0xff, fp);
+		break;
+	}
+	fclose(fp);
+	char const *modes[2] = { "r", "r@4" };
+	for(int64_t i = 0; i < 2; i++) {
+		rfp = zfopen("tmp.txt.gz", modes[i]);
+		assert(zfread(rfp, rarr, len) < len, "%s", modes[i]);
+		assert(zfclose(rfp) != 0, "%s", modes[i]);
+
+		/* kept after rewinding to the intact head */
+		rfp = zfopen("tmp.txt.gz", modes[i]);
+		zfread(rfp, rarr, len);
+		assert(zfseek(rfp, 0, SEEK_SET) == 0, "%s", modes[i]);
+		assert(zfread(rfp, buf, 1024) == 1024 && memcmp(buf, warr, 1024) == 0, "%s", modes[i]);
+		assert(zfclose(rfp) != 0, "%s", modes[i]);
+	}
 
+	/* cleanup */
+	free(warr);
+	free(rarr);
+	remove("tmp.txt.gz");
+}
 
-	size_t read2 = zfread(rfp, rarr2, 50000);
-	assert(zfeof(rfp) == 0, "%d", zfeof(rfp));
-	assert(read2 == 50000, "%llu", read2);
+/* getc / putc */
+unittest(with(TEST_ARR_LEN))
+{
+	omajinai();
 
-	assert(memcmp(arr, rarr1, 50000) == 0);
-	assert(memcmp(arr, rarr2, 50000) == 0);
+	/* write with zfputc */
+	zf_t *wfp = zfopen("tmp.txt.gz", "w");
 
-	/* read the latter half */
-	read1 = zfpeek(rfp, rarr1, 50000);
-	assert(read1 == 50000, "%llu", read1);
+	for(int64_t i = 0; i < TEST_ARR_LEN; i++) {
+		zfputc(wfp, arr[i]);
+	}
 
-	read2 = zfread(rfp, rarr2, 50000);
-	assert(read2 == 50000, "%llu", read2);
+	zfclose(wfp);
 
-	assert(memcmp(&arr[50000], rarr1, 50000) == 0);
-	assert(memcmp(&arr[50000], rarr2, 50000) == 0);
+	/* read with zfgetc */
+	zf_t *rfp = zfopen("tmp.txt.gz", "r");
+
+	char *rarr = (char *)malloc(TEST_ARR_LEN);
+	for(int64_t i = 0; i < TEST_ARR_LEN; i++) {
+		rarr[i] = zfgetc(rfp);
+	}
 
 	/* EOF */
 	assert(zfgetc(rfp) == EOF, "%d", zfgetc(rfp));
@@ -767,47 +10083,134 @@ unittest(with(100000))
 
 	zfclose(rfp);
 
+	/* compare */
+	assert(memcmp(arr, rarr, TEST_ARR_LEN) == 0);
+
 	/* cleanup */
-	free(rarr1);
-	free(rarr2);
-	remove("tmp.txt");
+	free(rarr);
+	remove("tmp.txt.gz");
 }
 
-/* ungetc */
+/* format determined from the magic bytes regardless of the name, also from pipes */
 unittest(with(TEST_ARR_LEN))
 {
 	omajinai();
 
-	/* write */
-	zf_t *wfp = zfopen("tmp.txt", "w");
-	zfwrite(wfp, arr, TEST_ARR_LEN);
-	zfclose(wfp);
-
-	/* push pop */
-	zf_t *rfp = zfopen("tmp.txt", "r");
-	int save = 'a';
-	for(int64_t i = 0; i < TEST_ARR_LEN; i++) {
-		zfungetc(rfp, save);
-		int c = zfgetc(rfp);
-		assert(c == save);
-		save = zfgetc(rfp);
+	char const *exts[] = {
+		"", ".gz", ".bgz",
+#ifdef HAVE_BZ2
+		".bz2",
+#endif
+#ifdef HAVE_LZMA
+		".xz", ".lzma",
+#endif
+#ifdef HAVE_ZSTD
+		".zst",
+#endif
+#ifdef HAVE_LZ4
+		".lz4",
+#endif
+	};
+	char const *paths[3] = { "tmp.bin", "<cat tmp.bin", "<cat tmp.bin | cat" };
+	char const *modes[2] = { "r", "r@2" };
+	char *rarr = (char *)malloc(TEST_ARR_LEN);
+	for(uint64_t i = 0; i < sizeof(exts) / sizeof(exts[0]); i++) {
+		char wmode[16] = "w";
+		strcat(wmode, exts[i]);
+		zf_t *wfp = zfopen("tmp.bin", wmode);
+		assert(wfp != NULL, "%s", exts[i]);
+		zfwrite(wfp, arr, TEST_ARR_LEN);
+		zfclose(wfp);
+
+		for(int64_t j = 0; j < 3; j++) {
+			for(int64_t k = 0; k < 2; k++) {
+				zf_t *rfp = zfopen(paths[j], modes[k]);
+				assert(rfp != NULL, "%s, %s", exts[i], paths[j]);
+
+				memset(rarr, 0, TEST_ARR_LEN);
+				size_t read = zfread(rfp, rarr, TEST_ARR_LEN);
+				assert(read == TEST_ARR_LEN, "%s, %s, %llu", exts[i], paths[j], read);
+				assert(zfgetc(rfp) == EOF, "%d", zfgetc(rfp));
+				assert(memcmp(arr, rarr, TEST_ARR_LEN) == 0, "%s, %s", exts[i], paths[j]);
+				zfclose(rfp);
+			}
+		}
 	}
 
-	save = zfgetc(rfp);
-	assert(save == EOF, "%d", save);
+	/* text beginning with the default .lzma properties byte, but not a valid header */
+	uint8_t const text[16] = { 0x5d, 0x00, 0x00, 't', 'e', 'x', 't', '\n', 't', 'e', 'x', 't', '\n', 'e', 'n', 'd' };
+	FILE *fp = fopen("tmp.bin", "wb");
+	fwrite(text, 1, 16, fp);
+	fclose(fp);
+	zf_t *rfp = zfopen("tmp.bin", "r");
+	assert(rfp != NULL, "%p", rfp);
+	assert(zfread(rfp, rarr, TEST_ARR_LEN) == 16);
+	assert(memcmp(text, rarr, 16) == 0);
+	zfclose(rfp);
 
+	/* misnamed with an extension that has no reader */
+	char const *names[] = {
+		"tmp.lz", "tmp.z",
+#ifndef HAVE_ZSTD
+		"tmp.zst",
+#endif
+	};
+	for(uint64_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+		zf_t *wfp = zfopen("tmp.bin", "w.gz");
+		zfwrite(wfp, arr, TEST_ARR_LEN);
+		zfclose(wfp);
+		assert(rename("tmp.bin", names[i]) == 0);
+		rfp = zfopen(names[i], "r");
+		assert(rfp != NULL, "%s", names[i]);
+		assert(strcmp(rfp->path, names[i]) == 0, "%s", rfp->path);
+		assert(zfread(rfp, rarr, TEST_ARR_LEN) == TEST_ARR_LEN, "%s", names[i]);
+		assert(memcmp(arr, rarr, TEST_ARR_LEN) == 0, "%s", names[i]);
+		assert(zfclose(rfp) == 0);
+
+		/* or read as is */
+		fp = fopen(names[i], "wb");
+		fwrite(text, 1, 16, fp);
+		fclose(fp);
+		rfp = zfopen(names[i], "r");
+		assert(rfp != NULL, "%s", names[i]);
+		assert(zfread(rfp, rarr, TEST_ARR_LEN) == 16);
+		assert(memcmp(text, rarr, 16) == 0);
+		zfclose(rfp);
+		remove(names[i]);
+	}
+	assert(zfopen("tmp.lz", "w") == NULL);
+
+	/* bytes already in a pipe are examined without waiting for the writer to fill the sniffing size */
+	int pfd[2], stdin_fd = dup(STDIN_FILENO);
+	assert(pipe(pfd) == 0);
+	assert(write(pfd[1], "abc", 3) == 3);
+	dup2(pfd[0], STDIN_FILENO);
+	close(pfd[0]);
+	alarm(10);				/* killed if blocked */
+	rfp = zfopen("-", "r");
+	alarm(0);
+	assert(rfp != NULL, "%p", rfp);
+	close(pfd[1]);
+	assert(zfread(rfp, rarr, TEST_ARR_LEN) == 3);
+	assert(memcmp("abc", rarr, 3) == 0);
 	zfclose(rfp);
-	remove("tmp.txt");
+	dup2(stdin_fd, STDIN_FILENO);
+	close(stdin_fd);
+
+	/* cleanup */
+	free(rarr);
+	remove("tmp.bin");
 }
+#endif /* HAVE_Z */
 
-/* zlib-dependent tests */
-#ifdef HAVE_Z
+/* bzip2-dependent tests */
+#ifdef HAVE_BZ2
 unittest(with(TEST_ARR_LEN))
 {
 	omajinai();
 
 	/* write */
-	zf_t *wfp = zfopen("tmp.txt.gz", "w");
+	zf_t *wfp = zfopen("tmp.txt.bz2", "w");
 	assert(wfp != NULL, "%p", wfp);
 
 	size_t written = zfwrite(wfp, arr, TEST_ARR_LEN);
@@ -816,7 +10219,7 @@ unittest(with(TEST_ARR_LEN))
 	zfclose(wfp);
 
 	/* read */
-	zf_t *rfp = zfopen("tmp.txt.gz", "r");
+	zf_t *rfp = zfopen("tmp.txt.bz2", "r");
 	assert(rfp != NULL, "%p", rfp);
 	assert(strcmp(rfp->path, "tmp.txt") == 0, "%s", rfp->path);
 
@@ -835,7 +10238,7 @@ unittest(with(TEST_ARR_LEN))
 
 	/* cleanup */
 	free(rarr);
-	remove("tmp.txt.gz");
+	remove("tmp.txt.bz2");
 }
 
 /* specify compression format with mode flag */
@@ -844,7 +10247,7 @@ unittest(with(TEST_ARR_LEN))
 	omajinai();
 
 	/* write */
-	zf_t *wfp = zfopen("tmpfile", "w.gz");
+	zf_t *wfp = zfopen("tmpfile", "w.bz2");
 	assert(wfp != NULL, "%p", wfp);
 	assert(strcmp(wfp->mode, "w") == 0, "%s", wfp->mode);
 
@@ -854,7 +10257,7 @@ unittest(with(TEST_ARR_LEN))
 	zfclose(wfp);
 
 	/* read */
-	zf_t *rfp = zfopen("tmpfile", "r.gz");
+	zf_t *rfp = zfopen("tmpfile", "r.bz2");
 	assert(rfp != NULL, "%p", rfp);
 	assert(strcmp(rfp->path, "tmpfile") == 0, "%s", rfp->path);
 	assert(strcmp(rfp->mode, "r") == 0, "%s", rfp->mode);
@@ -877,13 +10280,40 @@ unittest(with(TEST_ARR_LEN))
 	remove("tmpfile");
 }
 
+/* levels out of the range of bzip2 are clamped */
+unittest(with(TEST_ARR_LEN))
+{
+	omajinai();
+
+	char const *modes[3] = { "w19", "w0", "w0@2" };
+	char *rarr = (char *)malloc(TEST_ARR_LEN);
+	for(int64_t i = 0; i < 3; i++) {
+		zf_t *wfp = zfopen("tmp.txt.bz2", modes[i]);
+		assert(wfp != NULL, "%s", modes[i]);
+		size_t written = zfwrite(wfp, arr, TEST_ARR_LEN);
+		assert(written == TEST_ARR_LEN, "%s, %llu", modes[i], written);
+		assert(zfclose(wfp) == 0, "%s", modes[i]);
+
+		zf_t *rfp = zfopen("tmp.txt.bz2", "r");
+		assert(rfp != NULL, "%s", modes[i]);
+		size_t read = zfread(rfp, rarr, TEST_ARR_LEN);
+		assert(read == TEST_ARR_LEN, "%s, %llu", modes[i], read);
+		assert(memcmp(arr, rarr, TEST_ARR_LEN) == 0, "%s", modes[i]);
+		zfclose(rfp);
+	}
+
+	/* cleanup */
+	free(rarr);
+	remove("tmp.txt.bz2");
+}
+
 /* getc / putc */
 unittest(with(TEST_ARR_LEN))
 {
 	omajinai();
 
 	/* write with zfputc */
-	zf_t *wfp = zfopen("tmp.txt.gz", "w");
+	zf_t *wfp = zfopen("tmp.txt.bz2", "w");
 
 	for(int64_t i = 0; i < TEST_ARR_LEN; i++) {
 		zfputc(wfp, arr[i]);
@@ -892,7 +10322,7 @@ unittest(with(TEST_ARR_LEN))
 	zfclose(wfp);
 
 	/* read with zfgetc */
-	zf_t *rfp = zfopen("tmp.txt.gz", "r");
+	zf_t *rfp = zfopen("tmp.txt.bz2", "r");
 
 	char *rarr = (char *)malloc(TEST_ARR_LEN);
 	for(int64_t i = 0; i < TEST_ARR_LEN; i++) {
@@ -910,123 +10340,417 @@ unittest(with(TEST_ARR_LEN))
 
 	/* cleanup */
 	free(rarr);
-	remove("tmp.txt.gz");
+	remove("tmp.txt.bz2");
 }
-#endif /* HAVE_Z */
-
-/* bzip2-dependent tests */
-#ifdef HAVE_BZ2
+/* parallel decompression, on multiple blocks and concatenated streams */
 unittest(with(TEST_ARR_LEN))
 {
 	omajinai();
 
-	/* write */
-	zf_t *wfp = zfopen("tmp.txt.bz2", "w");
-	assert(wfp != NULL, "%p", wfp);
-
-	size_t written = zfwrite(wfp, arr, TEST_ARR_LEN);
-	assert(written == TEST_ARR_LEN, "%llu", written);
-
+	/* two streams of 100k blocks, followed by garbage */
+	zf_t *wfp = zfopen("tmp1.txt.bz2", "w1");
+	zfwrite(wfp, arr, TEST_ARR_LEN / 2);
+	zfclose(wfp);
+	wfp = zfopen("tmp2.txt.bz2", "w1");
+	zfwrite(wfp, &arr[TEST_ARR_LEN / 2], TEST_ARR_LEN / 2);
 	zfclose(wfp);
 
-	/* read */
-	zf_t *rfp = zfopen("tmp.txt.bz2", "r");
-	assert(rfp != NULL, "%p", rfp);
-	assert(strcmp(rfp->path, "tmp.txt") == 0, "%s", rfp->path);
+	FILE *fp = fopen("tmp.txt.bz2", "wb");
+	char const *files[2] = { "tmp1.txt.bz2", "tmp2.txt.bz2" };
+	for(int64_t i = 0; i < 2; i++) {
+		char buf[1024];
+		FILE *in = fopen(files[i], "rb");
+		size_t len;
+		while((len = fread(buf, 1, 1024, in)) > 0) {
+			fwrite(buf, 1, len, fp);
+		}
+		fclose(in);
+		remove(files[i]);
+	}
+	fputs("garbage", fp);
+	fclose(fp);
 
+	/* read with zfread */
 	char *rarr = (char *)malloc(TEST_ARR_LEN);
-	size_t read = zfread(rfp, rarr, TEST_ARR_LEN);
-	assert(read == TEST_ARR_LEN, "%llu", read);
+	char const *modes[2] = { "r@4", "r@1" };
+	for(int64_t i = 0; i < 2; i++) {
+		zf_t *rfp = zfopen("tmp.txt.bz2", modes[i]);
+		assert(rfp != NULL, "%p", rfp);
+
+		memset(rarr, 0, TEST_ARR_LEN);
+		size_t read = zfread(rfp, rarr, TEST_ARR_LEN);
+		assert(read == TEST_ARR_LEN, "%llu", read);
+		assert(zfgetc(rfp) == EOF, "%d", zfgetc(rfp));
+		zfclose(rfp);
+		assert(memcmp(arr, rarr, TEST_ARR_LEN) == 0);
+	}
 
-	/* EOF */
+	/* read with zfgetc */
+	memset(rarr, 0, TEST_ARR_LEN);
+	zf_t *rfp = zfopen("tmp.txt.bz2", "r@3");
+	for(int64_t i = 0; i < TEST_ARR_LEN; i++) {
+		rarr[i] = zfgetc(rfp);
+	}
 	assert(zfgetc(rfp) == EOF, "%d", zfgetc(rfp));
-	assert(zfeof(rfp) != 0, "%d", zfeof(rfp));
+	zfclose(rfp);
+	assert(memcmp(arr, rarr, TEST_ARR_LEN) == 0);
 
+	/* close before reaching the end */
+	rfp = zfopen("tmp.txt.bz2", "r@4");
+	assert(zfgetc(rfp) == arr[0]);
 	zfclose(rfp);
 
-	/* compare */
-	assert(memcmp(arr, rarr, TEST_ARR_LEN) == 0);
+	/* truncated */
+	assert(truncate("tmp.txt.bz2", TEST_ARR_LEN / 4) == 0);
+	rfp = zfopen("tmp.txt.bz2", "r@2");
+	size_t read = zfread(rfp, rarr, TEST_ARR_LEN);
+	assert(read < TEST_ARR_LEN / 2, "%llu", read);
+	assert(memcmp(arr, rarr, read) == 0);
+	zfclose(rfp);
 
 	/* cleanup */
 	free(rarr);
 	remove("tmp.txt.bz2");
 }
 
-/* specify compression format with mode flag */
+/* parallel compression into concatenated streams */
 unittest(with(TEST_ARR_LEN))
 {
 	omajinai();
 
-	/* write */
-	zf_t *wfp = zfopen("tmpfile", "w.bz2");
-	assert(wfp != NULL, "%p", wfp);
-	assert(strcmp(wfp->mode, "w") == 0, "%s", wfp->mode);
+	/* output must not depend on the number of threads */
+	char const *files[2] = { "tmp1.txt.bz2", "tmp2.txt.bz2" };
+	char const *wmodes[2] = { "w1@1", "w1@3" };
+	for(int64_t i = 0; i < 2; i++) {
+		zf_t *wfp = zfopen(files[i], wmodes[i]);
+		assert(wfp != NULL, "%p", wfp);
+		for(int64_t j = 0; j < TEST_ARR_LEN; j += 1000) {
+			size_t written = zfwrite(wfp, &arr[j], 1000);
+			assert(written == 1000, "%llu", written);
+		}
+		zfclose(wfp);
+	}
 
-	size_t written = zfwrite(wfp, arr, TEST_ARR_LEN);
-	assert(written == TEST_ARR_LEN, "%llu", written);
+	uint8_t *img[2];
+	size_t img_len[2];
+	for(int64_t i = 0; i < 2; i++) {
+		FILE *fp = fopen(files[i], "rb");
+		img[i] = (uint8_t *)malloc(2 * TEST_ARR_LEN);
+		img_len[i] = fread(img[i], 1, 2 * TEST_ARR_LEN, fp);
+		fclose(fp);
+	}
+	assert(img_len[0] == img_len[1], "%llu, %llu", img_len[0], img_len[1]);
+	assert(memcmp(img[0], img[1], img_len[0]) == 0);
+	free(img[0]);
+	free(img[1]);
 
-	zfclose(wfp);
+	/* read with both of the serial and parallel decompressors */
+	char const *rmodes[2] = { "r", "r@2" };
+	char *rarr = (char *)malloc(TEST_ARR_LEN);
+	for(int64_t i = 0; i < 2; i++) {
+		zf_t *rfp = zfopen(files[1], rmodes[i]);
+		assert(rfp != NULL, "%p", rfp);
+
+		memset(rarr, 0, TEST_ARR_LEN);
+		size_t read = zfread(rfp, rarr, TEST_ARR_LEN);
+		assert(read == TEST_ARR_LEN, "%llu", read);
+		assert(zfgetc(rfp) == EOF, "%d", zfgetc(rfp));
+		zfclose(rfp);
+		assert(memcmp(arr, rarr, TEST_ARR_LEN) == 0);
+	}
 
-	/* read */
-	zf_t *rfp = zfopen("tmpfile", "r.bz2");
-	assert(rfp != NULL, "%p", rfp);
-	assert(strcmp(rfp->path, "tmpfile") == 0, "%s", rfp->path);
-	assert(strcmp(rfp->mode, "r") == 0, "%s", rfp->mode);
+	/* cleanup */
+	free(rarr);
+	remove(files[0]);
+	remove(files[1]);
+}
 
-	char *rarr = (char *)malloc(TEST_ARR_LEN);
-	size_t read = zfread(rfp, rarr, TEST_ARR_LEN);
-	assert(read == TEST_ARR_LEN, "%llu", read);
+/* seek by rewinding and skipping */
+unittest(with(TEST_ARR_LEN))
+{
+	omajinai();
 
-	/* EOF */
-	assert(zfgetc(rfp) == EOF, "%d", zfgetc(rfp));
-	assert(zfeof(rfp) != 0, "%d", zfeof(rfp));
+	zf_t *wfp = zfopen("tmp.txt.bz2", "w");
+	zfwrite(wfp, arr, TEST_ARR_LEN);
+	zfclose(wfp);
 
+	zf_t *rfp = zfopen("tmp.txt.bz2", "r");
+	char buf[1024];
+	int64_t pos[4] = { TEST_ARR_LEN / 2, 1024, TEST_ARR_LEN - 1024, 0 };
+	for(int64_t i = 0; i < 4; i++) {
+		assert(zfseek(rfp, pos[i], SEEK_SET) == 0, "%lld", pos[i]);
+		assert(zftell(rfp) == pos[i], "%lld, %lld", zftell(rfp), pos[i]);
+		assert(zfread(rfp, buf, 1024) == 1024);
+		assert(memcmp(buf, &arr[pos[i]], 1024) == 0, "%lld", pos[i]);
+	}
 	zfclose(rfp);
+	remove("tmp.txt.bz2");
+}
+#endif /* HAVE_BZ2 */
 
-	/* compare */
+/* liblzma-dependent tests */
+#ifdef HAVE_LZMA
+unittest(with(TEST_ARR_LEN))
+{
+	omajinai();
+
+	/* xz with the serial and parallel codecs, then lzma_alone */
+	char const *files[4] = { "tmp.txt.xz", "tmp.txt.xz", "tmp.txt.xz", "tmp.txt.lzma" };
+	char const *wmodes[4] = { "w", "w1@2", "w1@2", "w1" };
+	char const *rmodes[4] = { "r", "r@2", "r", "r@2" };
+	char *rarr = (char *)malloc(TEST_ARR_LEN);
+	for(int64_t i = 0; i < 4; i++) {
+		zf_t *wfp = zfopen(files[i], wmodes[i]);
+		assert(wfp != NULL, "%p", wfp);
+		size_t written = zfwrite(wfp, arr, TEST_ARR_LEN);
+		assert(written == TEST_ARR_LEN, "%llu", written);
+		zfclose(wfp);
+
+		zf_t *rfp = zfopen(files[i], rmodes[i]);
+		assert(rfp != NULL, "%p", rfp);
+		assert(strcmp(rfp->path, "tmp.txt") == 0, "%s", rfp->path);
+
+		memset(rarr, 0, TEST_ARR_LEN);
+		size_t read = zfread(rfp, rarr, TEST_ARR_LEN);
+		assert(read == TEST_ARR_LEN, "%llu", read);
+		assert(zfgetc(rfp) == EOF, "%d", zfgetc(rfp));
+		zfclose(rfp);
+		assert(memcmp(arr, rarr, TEST_ARR_LEN) == 0);
+		remove(files[i]);
+	}
+
+	/* concatenated xz streams */
+	zf_t *wfp = zfopen("tmp1.txt", "w.xz");
+	zfwrite(wfp, arr, TEST_ARR_LEN / 2);
+	zfclose(wfp);
+	wfp = zfopen("tmp1.txt", "a.xz@2");
+	zfwrite(wfp, &arr[TEST_ARR_LEN / 2], TEST_ARR_LEN / 2);
+	zfclose(wfp);
+
+	zf_t *rfp = zfopen("tmp1.txt", "r.xz@2");
+	memset(rarr, 0, TEST_ARR_LEN);
+	for(int64_t i = 0; i < TEST_ARR_LEN; i++) {
+		rarr[i] = zfgetc(rfp);
+	}
+	assert(zfgetc(rfp) == EOF, "%d", zfgetc(rfp));
+	assert(zfclose(rfp) == 0);
 	assert(memcmp(arr, rarr, TEST_ARR_LEN) == 0);
 
+	/* truncated, reported on close */
+	struct stat st;
+	assert(stat("tmp1.txt", &st) == 0 && truncate("tmp1.txt", st.st_size - 100) == 0);
+	char const *modes[2] = { "r.xz", "r.xz@2" };
+	for(int64_t i = 0; i < 2; i++) {
+		rfp = zfopen("tmp1.txt", modes[i]);
+		assert(rfp != NULL, "%s", modes[i]);
+		assert(zfread(rfp, rarr, TEST_ARR_LEN) < TEST_ARR_LEN, "%s", modes[i]);
+		assert(zfclose(rfp) != 0, "%s", modes[i]);
+	}
+
 	/* cleanup */
 	free(rarr);
-	remove("tmpfile");
+	remove("tmp1.txt");
 }
+#endif /* HAVE_LZMA */
 
-/* getc / putc */
+/* zstd-dependent tests */
+#ifdef HAVE_ZSTD
 unittest(with(TEST_ARR_LEN))
 {
 	omajinai();
 
-	/* write with zfputc */
-	zf_t *wfp = zfopen("tmp.txt.bz2", "w");
+	/* levels out of the range of zstd are clamped */
+	assert(zf_parse_level("w99", ZSTD_CLEVEL_DEFAULT, 1, ZSTD_maxCLevel()) == ZSTD_maxCLevel());
+	assert(zf_parse_level("w0", ZSTD_CLEVEL_DEFAULT, 1, ZSTD_maxCLevel()) == 1);
+	assert(zf_parse_level("w", ZSTD_CLEVEL_DEFAULT, 1, ZSTD_maxCLevel()) == ZSTD_CLEVEL_DEFAULT);
 
-	for(int64_t i = 0; i < TEST_ARR_LEN; i++) {
-		zfputc(wfp, arr[i]);
+	/* level, threads, and long distance matching in the mode string */
+	char const *wmodes[4] = { "w", "w19@2", "w1@2,long=24", "w99" };
+	char const *rmodes[4] = { "r", "r@2", "r@long=24", "r" };
+	char *rarr = (char *)malloc(TEST_ARR_LEN);
+	for(int64_t i = 0; i < 4; i++) {
+		zf_t *wfp = zfopen("tmp.txt.zst", wmodes[i]);
+		assert(wfp != NULL, "%p", wfp);
+		size_t written = zfwrite(wfp, arr, TEST_ARR_LEN);
+		assert(written == TEST_ARR_LEN, "%llu", written);
+		assert(zfclose(wfp) == 0, "%s", wmodes[i]);
+
+		zf_t *rfp = zfopen("tmp.txt.zst", rmodes[i]);
+		assert(rfp != NULL, "%p", rfp);
+		assert(strcmp(rfp->path, "tmp.txt") == 0, "%s", rfp->path);
+
+		memset(rarr, 0, TEST_ARR_LEN);
+		size_t read = zfread(rfp, rarr, TEST_ARR_LEN);
+		assert(read == TEST_ARR_LEN, "%llu", read);
+		assert(zfgetc(rfp) == EOF, "%d", zfgetc(rfp));
+		assert(zfeof(rfp) != 0, "%d", zfeof(rfp));
+		zfclose(rfp);
+		assert(memcmp(arr, rarr, TEST_ARR_LEN) == 0);
 	}
 
+	/* not zstd */
+	zf_t *wfp = zfopen("tmp.txt", "w");
+	zfwrite(wfp, arr, 1000);
 	zfclose(wfp);
+	assert(zfopen("tmp.txt", "r.zst") == NULL);
+	remove("tmp.txt");
 
-	/* read with zfgetc */
-	zf_t *rfp = zfopen("tmp.txt.bz2", "r");
+	/* cleanup */
+	free(rarr);
+	remove("tmp.txt.zst");
+}
+
+/* frames decoded in parallel, skippable frames are ignored */
+unittest(with(TEST_ARR_LEN))
+{
+	omajinai();
+
+	/* frames in separate files, then concatenated */
+	FILE *fp = fopen("tmp.txt.zst", "wb");
+	uint8_t const skippable[12] = { 0x50, 0x2a, 0x4d, 0x18, 0x04, 0x00, 0x00, 0x00, 'z', 'f', 'z', 'f' };
+	for(int64_t i = 0; i < 4; i++) {
+		zf_t *wfp = zfopen("tmp1.txt.zst", "w");
+		zfwrite(wfp, &arr[i * TEST_ARR_LEN / 4], TEST_ARR_LEN / 4);
+		zfclose(wfp);
+
+		char buf[1024];
+		FILE *in = fopen("tmp1.txt.zst", "rb");
+		size_t len;
+		fwrite(skippable, 1, 12, fp);
+		while((len = fread(buf, 1, 1024, in)) > 0) {
+			fwrite(buf, 1, len, fp);
+		}
+		fclose(in);
+	}
+	fclose(fp);
+	remove("tmp1.txt.zst");
 
+	char const *modes[3] = { "r", "r@2", "r@4" };
 	char *rarr = (char *)malloc(TEST_ARR_LEN);
-	for(int64_t i = 0; i < TEST_ARR_LEN; i++) {
-		rarr[i] = zfgetc(rfp);
+	for(int64_t i = 0; i < 3; i++) {
+		zf_t *rfp = zfopen("tmp.txt.zst", modes[i]);
+		assert(rfp != NULL, "%p", rfp);
+
+		memset(rarr, 0, TEST_ARR_LEN);
+		for(int64_t j = 0; j < TEST_ARR_LEN; j++) {
+			rarr[j] = zfgetc(rfp);
+		}
+		assert(zfgetc(rfp) == EOF, "%d", zfgetc(rfp));
+		zfclose(rfp);
+		assert(memcmp(arr, rarr, TEST_ARR_LEN) == 0);
 	}
 
-	/* EOF */
-	assert(zfgetc(rfp) == EOF, "%d", zfgetc(rfp));
-	assert(zfeof(rfp) != 0, "%d", zfeof(rfp));
+	/* truncated */
+	assert(truncate("tmp.txt.zst", TEST_ARR_LEN / 2) == 0);
+	for(int64_t i = 0; i < 3; i++) {
+		zf_t *rfp = zfopen("tmp.txt.zst", modes[i]);
+		size_t read = zfread(rfp, rarr, TEST_ARR_LEN);
+		assert(read < TEST_ARR_LEN, "%llu", read);
+		assert(memcmp(arr, rarr, read) == 0);
+		zfclose(rfp);
+	}
 
-	zfclose(rfp);
+	/* cleanup */
+	free(rarr);
+	remove("tmp.txt.zst");
+}
 
-	/* compare */
-	assert(memcmp(arr, rarr, TEST_ARR_LEN) == 0);
+/* seekable format */
+unittest(with(TEST_ARR_LEN))
+{
+	omajinai();
+
+	char const *wmodes[2] = { "w@idx=64K", "w@2,idx=100000" };
+	char const *rmodes[2] = { "r", "r@2" };
+	char *rarr = (char *)malloc(TEST_ARR_LEN);
+	for(int64_t i = 0; i < 2; i++) {
+		zf_t *wfp = zfopen("tmp.txt.zst", wmodes[i]);
+		assert(wfp != NULL, "%p", wfp);
+		for(int64_t j = 0; j < TEST_ARR_LEN; j += 1000) {
+			zfwrite(wfp, &arr[j], 1000);
+		}
+		zfclose(wfp);
+
+		/* sequential */
+		zf_t *rfp = zfopen("tmp.txt.zst", rmodes[i]);
+		assert(rfp != NULL, "%p", rfp);
+		struct zf_zstr_s *zst = (struct zf_zstr_s *)((struct zf_intl_s *)rfp)->fp;
+		assert(zst->nfr == ((i == 0) ? 16 : 10), "%llu", zst->nfr);
+		assert(zst->uoff[zst->nfr] == TEST_ARR_LEN, "%llu", zst->uoff[zst->nfr]);
+
+		memset(rarr, 0, TEST_ARR_LEN);
+		size_t read = zfread(rfp, rarr, TEST_ARR_LEN);
+		assert(read == TEST_ARR_LEN, "%llu", read);
+		assert(zfgetc(rfp) == EOF, "%d", zfgetc(rfp));
+		assert(memcmp(arr, rarr, TEST_ARR_LEN) == 0);
+
+		/* random */
+		char buf[1024];
+		for(int64_t j = 0; j < 50; j++) {
+			int64_t pos = rand() % (TEST_ARR_LEN - 1024);
+			assert(zfseek(rfp, pos, SEEK_SET) == 0, "%lld", pos);
+			assert(zftell(rfp) == pos, "%lld, %lld", zftell(rfp), pos);
+			assert(zfread(rfp, buf, 1024) == 1024);
+			assert(memcmp(buf, &arr[pos], 1024) == 0, "%lld", pos);
+		}
+		assert(zfseek(rfp, TEST_ARR_LEN - 1, SEEK_SET) == 0);
+		assert(zfgetc(rfp) == arr[TEST_ARR_LEN - 1]);
+		assert(zfgetc(rfp) == EOF);
+		zfclose(rfp);
+	}
 
 	/* cleanup */
 	free(rarr);
-	remove("tmp.txt.bz2");
+	remove("tmp.txt.zst");
 }
-#endif /* HAVE_BZ2 */
+#endif /* HAVE_ZSTD */
+
+/* lz4-dependent tests */
+#ifdef HAVE_LZ4
+unittest(with(TEST_ARR_LEN))
+{
+	omajinai();
+
+	/* written serially / in parallel, read in both ways */
+	char const *wmodes[4] = { "w", "w9", "w@2", "w9@2" };
+	char const *rmodes[2] = { "r", "r@2" };
+	char *rarr = (char *)malloc(TEST_ARR_LEN);
+	for(int64_t i = 0; i < 4; i++) {
+		zf_t *wfp = zfopen("tmp.txt.lz4", wmodes[i]);
+		assert(wfp != NULL, "%p", wfp);
+		for(int64_t j = 0; j < TEST_ARR_LEN; j += 1000) {
+			zfwrite(wfp, &arr[j], 1000);
+		}
+		assert(zfclose(wfp) == 0);
+
+		for(int64_t j = 0; j < 2; j++) {
+			zf_t *rfp = zfopen("tmp.txt.lz4", rmodes[j]);
+			assert(rfp != NULL, "%p", rfp);
+			assert(strcmp(rfp->path, "tmp.txt") == 0, "%s", rfp->path);
+
+			memset(rarr, 0, TEST_ARR_LEN);
+			size_t read = zfread(rfp, rarr, TEST_ARR_LEN);
+			assert(read == TEST_ARR_LEN, "%llu", read);
+			assert(zfgetc(rfp) == EOF, "%d", zfgetc(rfp));
+			zfclose(rfp);
+			assert(memcmp(arr, rarr, TEST_ARR_LEN) == 0, "%s, %s", wmodes[i], rmodes[j]);
+		}
+	}
+
+	/* truncated */
+	assert(truncate("tmp.txt.lz4", TEST_ARR_LEN / 4) == 0);
+	for(int64_t j = 0; j < 2; j++) {
+		zf_t *rfp = zfopen("tmp.txt.lz4", rmodes[j]);
+		size_t read = zfread(rfp, rarr, TEST_ARR_LEN);
+		assert(read < TEST_ARR_LEN, "%llu", read);
+		zfclose(rfp);
+	}
+
+	/* cleanup */
+	free(rarr);
+	remove("tmp.txt.lz4");
+}
+#endif /* HAVE_LZ4 */
 
 /**
  * end of zf.c
@@ -17,9 +17,9 @@
 struct zf_s {
 	char const *path;
 	char const *mode;
-	int reserved1[2];
-	void *reserved2[10];
-	int64_t reserved3[3];
+	int reserved1[3];
+	void *reserved2[31];
+	int64_t reserved3[6];
 
 };
 typedef struct zf_s zf_t;
@@ -52,13 +52,33 @@ size_t zfread(
 
 /**
  * @fn zfpeek
- * @brief read len (< 512k) without advancing pointer
+ * @brief read len without advancing pointer
  */
 size_t zfpeek(
 	zf_t *zf,
 	void *ptr,
 	size_t len);
 
+/**
+ * @fn zfreadbuf
+ * @brief make at least min_len bytes available in the internal buffer unless the file ends,
+ * then set *ptr to the head of them without advancing pointer; returns the number of bytes available.
+ * the bytes are valid until the next call to the other functions, and followed by 64 zeroed bytes readable
+ * (e.g. for unaligned SIMD loads). the internal buffer is aligned to 64 bytes.
+ */
+size_t zfreadbuf(
+	zf_t *zf,
+	uint8_t const **ptr,
+	size_t min_len);
+
+/**
+ * @fn zfconsume
+ * @brief advance pointer by len (bounded by the bytes zfreadbuf returned)
+ */
+size_t zfconsume(
+	zf_t *zf,
+	size_t len);
+
 /**
  * @fn zfwrite
  * @brief write to file, similar to gzwrite
@@ -68,6 +88,23 @@ size_t zfwrite(
 	void *ptr,
 	size_t len);
 
+/**
+ * @fn zfseek
+ * @brief set position in the uncompressed stream (read mode only), whence is SEEK_SET or SEEK_CUR.
+ * returns 0 on success, -1 otherwise.
+ */
+int zfseek(
+	zf_t *zf,
+	int64_t offset,
+	int whence);
+
+/**
+ * @fn zftell
+ * @brief position in the uncompressed stream
+ */
+int64_t zftell(
+	zf_t *zf);
+
 /**
  * @fn zfgetc
  */
@@ -109,6 +146,47 @@ int zfprintf(
 	char const *format,
 	...);
 
+/**
+ * @fn zfread_async, zfwrite_async
+ * @brief queue zfread / zfwrite to the background thread of the handle and return a token (-1 if failed).
+ * The requests run in order; ptr must be left untouched until the request completes, and the handle must
+ * not be used with the other functions but zfpoll, zfwait, zfeventfd and zfclose while any is pending.
+ */
+int64_t zfread_async(
+	zf_t *zf,
+	void *ptr,
+	size_t len);
+
+int64_t zfwrite_async(
+	zf_t *zf,
+	void *ptr,
+	size_t len);
+
+/**
+ * @fn zfpoll
+ * @brief 1 if completed (the transferred length to *len), 0 if pending, -1 if unknown or already collected
+ */
+int zfpoll(
+	zf_t *zf,
+	int64_t token,
+	size_t *len);
+
+/**
+ * @fn zfwait
+ * @brief block until completed; 0 (the transferred length to *len), or -1 if unknown or already collected
+ */
+int zfwait(
+	zf_t *zf,
+	int64_t token,
+	size_t *len);
+
+/**
+ * @fn zfeventfd
+ * @brief eventfd counting the completions of the asynchronous requests, for poll / epoll; -1 if not available
+ */
+int zfeventfd(
+	zf_t *zf);
+
 #endif /* _ZF_H_INCLUDED */
 /**
  * end of zf.h